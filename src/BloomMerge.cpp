@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <string>
+#include "../utils/Bloom.h"
+#include "../utils/Kmer.h"
+
+using namespace std;
+
+/*
+faucet-bloom-merge combines the bloom filters of lanes loaded separately, e.g. on different cores or machines, into the
+filter the lanes would have given if they had been loaded together.  Build it with make faucet-bloom-merge.
+
+Each lane is loaded with faucet --just_load_bloom --lane_dump and its own -file_prefix, with the same -size_kmer,
+-estimated_kmers, -singletons, -fp and filter options for every lane.  Then type ./faucet-bloom-merge followed by:
+-size_kmer k
+-file_prefix <>, prefix of the merged filters
+-t <>, number of threads merging the filters, default 1
+and the -file_prefix of every lane.
+
+A lane loaded with the pair of filters has its solid kmers in prefix.bloom and the kmers it saw once in prefix.bloom1.
+A kmer is solid in the merged filter if it was solid in a lane, or seen once in each of two lanes.  This is worked out
+bit by bit, so a bit set for different kmers in two lanes is solid too, and the merged filter has a few more bits set
+than a joint load would.  The merge writes file_prefix.bloom, which faucet takes with -bloom_file, and
+file_prefix.bloom1, so merged lanes can be merged again.
+A lane loaded with --counting_bloom has its counters in prefix.bloom, and the merge adds them up.  The counters are
+updated conservatively during a load, so the sums are at least the counts of a joint load.
+*/
+
+int num_threads = 1;
+string file_prefix;
+vector<string> lanes;
+
+void argumentError(){
+    fprintf(stderr, "Usage: ./faucet-bloom-merge -size_kmer <k> -file_prefix <prefix> [-t <threads>] <lane_prefix> <lane_prefix> ...\n");
+}
+
+int handle_arguments(int argc, char *argv[]){
+    bool k_val_flag = false;
+    for(int i = 1; i < argc; i++){
+        if(0 == strcmp(argv[i], "-size_kmer") && i + 1 < argc)
+                setSizeKmer(atoi(argv[i+1])), i++, k_val_flag = true;
+        else if(0 == strcmp(argv[i], "-file_prefix") && i + 1 < argc)
+                file_prefix = string(argv[i+1]), i++;
+        else if(0 == strcmp(argv[i], "-t") && i + 1 < argc){
+                num_threads = atoi(argv[i+1]), i++;
+                if(num_threads < 1) num_threads = 1;
+        }
+        else if(0 == strcmp(argv[i], "--help") || 0 == strcmp(argv[i], "-h")){
+            argumentError();
+            return 1;
+        }
+        else if(argv[i][0] == '-'){
+            fprintf(stderr, "Cannot parse tag %s\n", argv[i]);
+            argumentError();
+            return 1;
+        }
+        else
+                lanes.push_back(string(argv[i]));
+    }
+    if(!k_val_flag || file_prefix.empty() || lanes.size() < 2){
+        fprintf(stderr, "Some required argument is missing: -size_kmer, -file_prefix and at least two lanes are needed.\n");
+        argumentError();
+        return 1;
+    }
+    return 0;
+}
+
+//Maps a dump written by faucet, exiting if there is none
+Bloom* openLaneFilter(string filename){
+    Bloom* bloom = Bloom::open_dump(filename.c_str());
+    if(!bloom){
+        fprintf(stderr, "%s was dumped without a header by an older version, so it can't be merged\n", filename.c_str());
+        exit(1);
+    }
+    return bloom;
+}
+
+int main(int argc, char *argv[]){
+    if(handle_arguments(argc, argv) == 1){
+        return 1;
+    }
+    time_t start, stop;
+    time(&start);
+    printf("Merging %d lanes into %s with %d threads\n", (int)lanes.size(), file_prefix.c_str(), num_threads);
+
+    vector<Bloom*> solid, seen;
+    for(string lane : lanes){
+        solid.push_back(openLaneFilter(lane + ".bloom"));
+    }
+    if(solid[0]->getLayout() == BLOOM_COUNTING){
+        Bloom* merged = Bloom::merge_counting_filters(solid, num_threads);
+        printf("Weight of the merged counting filter: %f\n", merged->weight());
+        merged->dump(&(file_prefix + ".bloom")[0]);
+        delete merged;
+    }
+    else{
+        for(string lane : lanes){
+            seen.push_back(openLaneFilter(lane + ".bloom1"));
+        }
+        Bloom* merged1;
+        Bloom* merged2;
+        Bloom::merge_two_filters(seen, solid, merged1, merged2, num_threads);
+        printf("Weights of the merged filters: %f, %f\n", merged1->weight(), merged2->weight());
+        merged2->dump(&(file_prefix + ".bloom")[0]);
+        merged1->dump(&(file_prefix + ".bloom1")[0]);
+        delete merged1;
+        delete merged2;
+    }
+    for(Bloom* bloom : solid) delete bloom;
+    for(Bloom* bloom : seen) delete bloom;
+
+    time(&stop);
+    printf("Time to merge: %f \n", difftime(stop,start));
+    return 0;
+}
@@ -17,26 +17,84 @@
 
 using namespace std;
 
-#define NNKS 4 // default minimal abundance for solidity
 #define MIN_CONTIG_SIZE (2*sizeKmer+1)
 
 /*
 To run Faucet, first type make in the directory to compile.
 
 Then, type ./faucet, followed by the following arguments:
--read_load_file <>, name of reads file  to load bloom filter from (current format is each line has a string of characters representing the read)
--read_scan_file <>, name of reads file  for read scan (current format is each line has a string of characters representing the read)
+-read_load_file <>, name of reads file  to load bloom filter from (fasta, possibly multi-line, or fastq with --fastq)
+-read_scan_file <>, name of reads file  for read scan (fasta, possibly multi-line, or fastq with --fastq)
 -size_kmer k
 -max_read_length <>, upper bound on the size of a read
 -estimated_kmers <>, number of number of distinct kmers.  This will be directly used to size the bloom filter so try to have a good estimate.
+-singletons <>, number of distinct kmers seen only once.
+-kmer_db <>, build the bloom filter from a kmer database of counted kmers (see utils/KmerDB.h, and faucet-kmer-db to
+    convert the output of a kmer counter) instead of loading it from the reads: the kmers counted at least -min_abundance
+    times are added, on the -t threads, to a single filter sized for them.  -read_load_file is then not needed, and
+    -estimated_kmers and -singletons default to the number of kmers in the database.  Not with --mercy, --counting_bloom,
+    --single_pass, --estimate_kmers, --lane_dump or -bucket_dir.
+--estimate_kmers, estimate -estimated_kmers and -singletons, whichever isn't given, with a sampling pass over the load
+    file before the bloom load.  With --single_pass that pass writes the spool, and the load replays it.
 -fp <>, false positive rate, default .01
 -file_prefix <>, used for junctions file and contigs file and graph file
 --two_hash, if this option is selected a bigger bloom filter with only two hash functions is used
--bloom_file <>, used to shortcut loading the filter if you already have it on file
+-bloom_file <>, used to shortcut loading the filter if you already have it on file.
+    The filter settings are read from the file, which is memory mapped.  Files from older versions have no settings,
+    so the filter is sized from the other arguments and read in.
 -junctions_file <>, used to shortcut the readscan if you have access to a junctions file
 --just_load_bloom, if this option is selected the bloom will be loaded and dumped, then the program will terminate
+--lane_dump, also dump the filter of kmers seen once to file_prefix.bloom1, so faucet-bloom-merge can combine the filters
+    of lanes loaded separately.  Not with --scalable_bloom or -target_fpr.
 --fastq, use fastq files
 --paired_ends, file is given as interleaved paired end data.  Beginning of each read corresponds to end of overall fragment.
+-t <>, number of worker threads for the bloom load and the read scan, default 1
+--single_pass, read the input only once: the load spools the reads to file_prefix.spool and the read scan replays them.
+    This scans the reads of -read_load_file, so -read_scan_file is not needed, and can't name another file.
+--blocked_bloom, use cache-line blocked bloom filters: every lookup touches one 64 byte block, at the cost of a slightly
+    bigger filter for the same false positive rate.  A filter dumped this way must be reloaded with --blocked_bloom too.
+--minimizer_bloom, use blocked bloom filters whose blocks are grouped in 4 KB partitions, with the partition of a kmer
+    picked by its minimizer.  Consecutive kmers of a read mostly share a minimizer, so the load, the read scan and the
+    j-check touch one page for a run of kmers.  Not with --counting_bloom.
+-minimizer_size <>, length of the minimizers of --minimizer_bloom, at most k and 32, default 15
+--pow2_bloom, round the bloom filters up to a power of two bits instead of using the size asked for.
+    Needed to reload filters dumped by older versions with -bloom_file.
+--counting_bloom, load one blocked filter of 2 bit counters instead of a pair of bloom filters, so each kmer touches one cache line.
+    A kmer is solid if it was counted at least -min_abundance times.  Not available with --mercy.
+-min_abundance <>, times a kmer must be seen to be solid with --counting_bloom, from 1 to 3, or with -kmer_db or an
+    exact kmer set, default 2
+-min_qual <>, with --fastq, read the bases under this Phred quality as N, so the kmers overlapping them are neither
+    loaded nor scanned: fewer error kmers in the bloom filters and fewer junctions from errors.  With --single_pass the
+    spool holds the masked reads.  Default 0, every base is kept.
+-qual_offset <>, quality character of Phred quality 0 in the fastq files, 33 (default) or 64
+-jcheck_engine <>, how the j-check looks for a path of j extensions: bfs (default) finds every extension of a level
+    before searching the next one, dfs searches depth first and stops at the first path j long, probing the four
+    extensions of a kmer together.  Both give the same junctions.
+-jcheck_cache <>, memory in MB for a cache of j-check results by kmer, shared by the -t threads, so the read scan and
+    the contig walks of the graph build don't repeat the j-check of a branch.  Hit rates are printed after each.
+    Default 0, no cache.
+-exact_budget <>, memory in MB for an exact kmer set in place of the bloom filters: when the -estimated_kmers fit in it
+    (16 bytes per kmer, rounded up to a power of two), the kmers go into a hash table with their counts, which has no
+    false positives, so no false junctions or j-check branches.  Bloom filters otherwise, and with k over 31, --mercy,
+    --scalable_bloom, --lane_dump or -bucket_dir.  The pair filters stay bloom filters.  Default 0, no exact set.
+-target_fpr <>, after the load, fold the bloom filter in half as long as its estimated false positive rate stays under
+    this, to give back the memory of a filter sized for more kmers than it got.  The dump records the folds.
+--scalable_bloom, when a bloom or pair filter has taken the items it was sized for, add a larger sub-filter instead of
+    letting it saturate, so a low -estimated_kmers costs some speed rather than false junctions.  Not with --counting_bloom
+    or --pow2_bloom.
+--rolling_hash, hash kmers with a canonical rolling hash (ntHash), rolled along each read in constant time per base
+    instead of hashing every kmer from scratch.  A dump records which hash it was built with.
+--freeze_pairs, collect the junction pairs added to the pair filters during the read scan, then freeze them into static
+    xor filters (about 9 bits per pair, three byte reads per query) for the cleaning.
+-bucket_dir <>, load the bloom filters out of core, for filters much bigger than the cache: the kmer hashes of the reads
+    are first written to bucket files in this directory, one per slice of the filters, and then each bucket is loaded
+    into its slice with sequential reads, on the -t threads.  Needs --blocked_bloom or --minimizer_bloom, and about 16
+    bytes of disk per kmer of the reads.  Not with --mercy, --counting_bloom or --scalable_bloom.
+-buckets <>, number of bucket files for -bucket_dir, at most 512.  By default each bucket covers 4 MB of each filter.
+-huge_pages <>, pages for the bloom and pair filters: none (default), thp for transparent huge pages, or explicit for
+    pages from the hugetlb pool, which falls back to thp when the pool is empty.
+-numa <>, placement of the filters on a NUMA machine: none (default, pages go where they are first zeroed by the -t
+    threads), interleave to spread the pages over all nodes, or partition for one contiguous part per node.
 
 Note: cannot use junctions_file option without also using bloom_file option
 
@@ -50,7 +108,7 @@ file_prefix.contigs, file_prefix.graph.
 void argumentError(){
     fprintf (stderr,"Usage:\n");
     fprintf (stderr,"./faucet -read_load_file <filename> -read_scan_file <filename> -size_kmer <k> -max_read_length <length> -estimated_kmers <num_kmers> -singletons <num_kmers> -file_prefix <prefix>");
-    fprintf(stderr, "\nOptional arguments: --fastq --mercy --high_cov -max_spacer_dist <dist> -fp rate <rate> -j <int> --two_hash -bloom_file <filename> -junctions_file <filename> --paired_ends --no_cleaning\n");
+    fprintf(stderr, "\nOptional arguments: --fastq --mercy --high_cov -max_spacer_dist <dist> -fp rate <rate> -j <int> --two_hash -bloom_file <filename> -junctions_file <filename> --paired_ends --no_cleaning -t <threads> --single_pass --estimate_kmers -kmer_db <filename> --blocked_bloom --minimizer_bloom -minimizer_size <m> --pow2_bloom --counting_bloom -min_abundance <count> -min_qual <phred> -qual_offset <33|64> -jcheck_engine <bfs|dfs> -jcheck_cache <MB> -exact_budget <MB> -target_fpr <rate> --scalable_bloom --rolling_hash --freeze_pairs --lane_dump -bucket_dir <dir> -buckets <count> -huge_pages <none|thp|explicit> -numa <none|interleave|partition>\n");
 }
 
 
@@ -74,6 +132,8 @@ int handle_arguments(int argc, char *argv[]){
                 singletons = atoll(argv[i+1]), i++, est_sing_flag=true;    
         else if(0 == strcmp(argv[i] , "-fp")) //false posiive rate
                 fpRate = atof(argv[i+1]), i++;
+        else if(0 == strcmp(argv[i] , "-target_fpr")) //false positive rate to fold the loaded filter down to
+                target_fpr = atof(argv[i+1]), i++;
         else if(0 == strcmp(argv[i] , "-j")) //value of j for jchecking
                 j = atoi(argv[i+1]), i++;
         else if(0 == strcmp(argv[i] , "-file_prefix")) //file prefix used for output files
@@ -82,6 +142,8 @@ int handle_arguments(int argc, char *argv[]){
                 two_hash = true; 
         else if(0 == strcmp(argv[i] , "--just_load_bloom")) //stop after loading bloom
                 just_load = true;
+        else if(0 == strcmp(argv[i] , "--lane_dump")) //dump bloo1 too, for merging lanes
+                lane_dump = true;
         else if(0 == strcmp(argv[i] , "--no_cleaning")) //stop after building contigmap
                 no_cleaning = true;            
         else if(0 == strcmp(argv[i] , "--fastq")) //input is fastq file
@@ -94,10 +156,79 @@ int handle_arguments(int argc, char *argv[]){
                 node_graph = true; 
         else if(0 == strcmp(argv[i], "--paired_ends")) //assume interleaved paired end reads
                 paired_ends = true;
+        else if(0 == strcmp(argv[i], "--single_pass")) //read the input once, spooling it for the scan
+                single_pass = true;
+        else if(0 == strcmp(argv[i], "--estimate_kmers")) //estimate kmer counts with a pass over the reads
+                estimate_kmers = true;
+        else if(0 == strcmp(argv[i], "--blocked_bloom")) //all probes of a kmer in one cache line
+                bloom_layout = BLOOM_BLOCKED;
+        else if(0 == strcmp(argv[i], "--minimizer_bloom")) //blocks grouped in partitions picked by minimizers
+                bloom_layout = BLOOM_MINIMIZER;
+        else if(0 == strcmp(argv[i] , "-minimizer_size")) //minimizer length for --minimizer_bloom
+                minimizer_size = atoi(argv[i+1]), i++, minimizer_size_flag = true;
+        else if(0 == strcmp(argv[i], "--pow2_bloom")) //power of two sized filters, as in older dumps
+                pow2_bloom = true;
+        else if(0 == strcmp(argv[i], "--counting_bloom")) //one counting filter instead of bloo1/bloo2
+                counting_bloom = true;
+        else if(0 == strcmp(argv[i], "--scalable_bloom")) //grow the filters with sub-filters as they fill up
+                scalable_bloom = true;
+        else if(0 == strcmp(argv[i], "--freeze_pairs")) //static xor pair filters after the scan
+                freeze_pairs = true;
+        else if(0 == strcmp(argv[i], "--rolling_hash")) //ntHash instead of the old hash
+                hash_mode = BLOOM_HASH_ROLLING;
+        else if(0 == strcmp(argv[i] , "-min_abundance")) //solidity threshold of the counting filter
+                min_abundance = atoi(argv[i+1]), i++, min_abundance_flag = true;
+        else if(0 == strcmp(argv[i] , "-kmer_db")) //counted kmers to load instead of the reads
+                kmer_db_file = string(argv[i+1]), i++;
+        else if(0 == strcmp(argv[i] , "-min_qual")) //mask the bases under this quality
+                min_qual = atoi(argv[i+1]), i++;
+        else if(0 == strcmp(argv[i] , "-qual_offset")) //quality encoding of the fastq files
+                qual_offset = atoi(argv[i+1]), i++, qual_offset_flag = true;
+        else if(0 == strcmp(argv[i] , "-jcheck_engine")){ //breadth or depth first j-check
+                if(0 == strcmp(argv[i+1], "bfs")) jcheck_engine = JCHECK_BFS;
+                else if(0 == strcmp(argv[i+1], "dfs")) jcheck_engine = JCHECK_DFS;
+                else{
+                    fprintf(stderr, "-jcheck_engine must be bfs or dfs.\n");
+                    return 1;
+                }
+                i++;
+        }
+        else if(0 == strcmp(argv[i] , "-jcheck_cache")) //memory for cached j-check results
+                jcheck_cache = atoi(argv[i+1]), i++;
+        else if(0 == strcmp(argv[i] , "-exact_budget")) //memory for an exact kmer set instead of bloom filters
+                exact_budget = atoi(argv[i+1]), i++;
+        else if(0 == strcmp(argv[i] , "-bucket_dir")) //out of core load through bucket files
+                bucket_dir = string(argv[i+1]), i++;
+        else if(0 == strcmp(argv[i] , "-buckets")) //number of bucket files
+                buckets = atoi(argv[i+1]), i++, buckets_flag = true;
+        else if(0 == strcmp(argv[i] , "-huge_pages")){ //page policy of the filters
+                if(0 == strcmp(argv[i+1], "none")) bloom_pages = BLOOM_PAGES_SMALL;
+                else if(0 == strcmp(argv[i+1], "thp")) bloom_pages = BLOOM_PAGES_THP;
+                else if(0 == strcmp(argv[i+1], "explicit")) bloom_pages = BLOOM_PAGES_HUGETLB;
+                else{
+                    fprintf(stderr, "-huge_pages must be none, thp or explicit.\n");
+                    return 1;
+                }
+                i++;
+        }
+        else if(0 == strcmp(argv[i] , "-numa")){ //NUMA placement of the filters
+                if(0 == strcmp(argv[i+1], "none")) bloom_numa = BLOOM_NUMA_NONE;
+                else if(0 == strcmp(argv[i+1], "interleave")) bloom_numa = BLOOM_NUMA_INTERLEAVE;
+                else if(0 == strcmp(argv[i+1], "partition")) bloom_numa = BLOOM_NUMA_PARTITION;
+                else{
+                    fprintf(stderr, "-numa must be none, interleave or partition.\n");
+                    return 1;
+                }
+                i++;
+        }
         else if(0 == strcmp(argv[i] , "-bloom_file")){
                 bloom_input_file = string(argv[i+1]);
                 from_bloom = true, i++;
         }  
+        else if(0 == strcmp(argv[i] , "-t")){ //number of worker threads
+                num_threads = atoi(argv[i+1]), i++;
+                if(num_threads < 1) num_threads = 1;
+        }
         else if(0 == strcmp(argv[i] , "-max_spacer_dist")){
                 maxSpacerDist = atoi(argv[i+1]), i++;
         }  
@@ -122,11 +253,101 @@ int handle_arguments(int argc, char *argv[]){
         }
         
     }
-    if (! (load_file_flag && scan_file_flag && k_val_flag && max_len_flag && est_kmers_flag && est_sing_flag && pref_flag)){
+    if(single_pass && scan_file_flag && read_scan_file != read_load_file){
+        fprintf(stderr, "--single_pass scans the reads of -read_load_file, so it can't be used with a different -read_scan_file.\n");
+        return 1;
+    }
+    if(single_pass && !scan_file_flag){
+        read_scan_file = read_load_file, scan_file_flag = true;
+    }
+    if(estimate_kmers && est_kmers_flag && est_sing_flag){
+        fprintf(stderr, "Warning: -estimated_kmers and -singletons are both given, so --estimate_kmers is not needed.\n");
+        estimate_kmers = false;
+    }
+    if(!kmer_db_file.empty()){
+        if(mercy || counting_bloom || single_pass || estimate_kmers || lane_dump || !bucket_dir.empty()){
+            fprintf(stderr, "-kmer_db can't be used with --mercy, --counting_bloom, --single_pass, --estimate_kmers, --lane_dump or -bucket_dir.\n");
+            return 1;
+        }
+        //the reads aren't loaded, and the kmer counts come from the database
+        load_file_flag = true;
+        if(!est_kmers_flag || !est_sing_flag){
+            KmerDB db(kmer_db_file);
+            if(!est_kmers_flag) estimated_kmers = db.size();
+            if(!est_sing_flag) singletons = db.size();
+            est_kmers_flag = est_sing_flag = true;
+        }
+    }
+    if (! (load_file_flag && scan_file_flag && k_val_flag && max_len_flag && ((est_kmers_flag && est_sing_flag) || estimate_kmers) && pref_flag)){
         fprintf (stderr, "Some required argument is missing.\n");
         argumentError();
         return 1; 
     }
+    if(min_abundance < 1 || (counting_bloom && min_abundance > BLOOM_MAX_COUNT)){
+        fprintf(stderr, "-min_abundance must be between 1 and %d.\n", BLOOM_MAX_COUNT);
+        return 1;
+    }
+    if(min_abundance_flag && !counting_bloom && kmer_db_file.empty() && exact_budget == 0){
+        fprintf(stderr, "Warning: -min_abundance is only used with --counting_bloom, -kmer_db and -exact_budget.\n");
+    }
+    if(qual_offset != 33 && qual_offset != 64){
+        fprintf(stderr, "-qual_offset must be 33 or 64.\n");
+        return 1;
+    }
+    if(min_qual < 0 || qual_offset + min_qual > '~'){
+        fprintf(stderr, "-min_qual must be between 0 and %d.\n", '~' - qual_offset);
+        return 1;
+    }
+    if((min_qual > 0 || qual_offset_flag) && !fastq){
+        fprintf(stderr, "Warning: -min_qual and -qual_offset are only used with --fastq.\n");
+    }
+    if(jcheck_cache < 0){
+        fprintf(stderr, "-jcheck_cache must be at least 0.\n");
+        return 1;
+    }
+    if(exact_budget < 0){
+        fprintf(stderr, "-exact_budget must be at least 0.\n");
+        return 1;
+    }
+    if(exact_budget > 0 && (from_bloom || !kmer_db_file.empty())){
+        fprintf(stderr, "Warning: -exact_budget is only used when the kmers are loaded from the reads.\n");
+    }
+    if(counting_bloom && mercy){
+        fprintf(stderr, "--mercy needs the pair of bloom filters, it can't be used with --counting_bloom.\n");
+        return 1;
+    }
+    if(bloom_layout == BLOOM_MINIMIZER && counting_bloom){
+        fprintf(stderr, "--minimizer_bloom can't be used with --counting_bloom.\n");
+        return 1;
+    }
+    if(minimizer_size < 1){
+        fprintf(stderr, "-minimizer_size must be at least 1.\n");
+        return 1;
+    }
+    if(minimizer_size_flag && bloom_layout != BLOOM_MINIMIZER){
+        fprintf(stderr, "Warning: -minimizer_size is only used with --minimizer_bloom.\n");
+    }
+    if(scalable_bloom && (counting_bloom || pow2_bloom)){
+        fprintf(stderr, "--scalable_bloom needs exact size bloom filters, it can't be used with --counting_bloom or --pow2_bloom.\n");
+        return 1;
+    }
+    if(!bucket_dir.empty()){
+        if(bloom_layout != BLOOM_BLOCKED && bloom_layout != BLOOM_MINIMIZER){
+            fprintf(stderr, "-bucket_dir needs --blocked_bloom or --minimizer_bloom, so each kmer is loaded into one block.\n");
+            return 1;
+        }
+        if(mercy || counting_bloom || scalable_bloom){
+            fprintf(stderr, "-bucket_dir can't be used with --mercy, --counting_bloom or --scalable_bloom.\n");
+            return 1;
+        }
+    }
+    if(lane_dump && (scalable_bloom || target_fpr > 0)){
+        fprintf(stderr, "--lane_dump needs filters that can be merged, it can't be used with --scalable_bloom or -target_fpr.\n");
+        return 1;
+    }
+    if(buckets_flag && bucket_dir.empty()){
+        fprintf(stderr, "Warning: -buckets is only used with -bucket_dir.\n");
+    }
     if(from_junctions && !from_bloom){
         fprintf(stderr, "Cannot start from junctions without a bloom file.\n");
         argumentError();
@@ -148,7 +369,10 @@ int handle_arguments(int argc, char *argv[]){
     else 
         printf("Using contig graph.\n");
 
-    std::cout << "Read load file name: " << read_load_file << "\n";
+    if(!kmer_db_file.empty())
+        printf("Bloom filter from the kmer database %s, kmers counted at least %d times.\n", kmer_db_file.c_str(), min_abundance);
+    else
+        std::cout << "Read load file name: " << read_load_file << "\n";
 
     std::cout << "Read scan file name: " << read_scan_file << "\n";
 
@@ -156,7 +380,12 @@ int handle_arguments(int argc, char *argv[]){
 
     printf("Maximal read length: %d\n", read_length);
 
-    printf("Estimated number of distinct kmers, for sizing bloom filter: %lli.\n", estimated_kmers);
+    if(estimate_kmers){
+        printf("Kmer counts for sizing the bloom filter will be estimated from the reads.\n");
+    }
+    else{
+        printf("Estimated number of distinct kmers, for sizing bloom filter: %llu.\n", (unsigned long long)estimated_kmers);
+    }
 
     printf("False positive rate: %f\n", fpRate);
 
@@ -165,6 +394,25 @@ int handle_arguments(int argc, char *argv[]){
     printf("File prefix: %s\n", &file_prefix[0]);
 
     printf("Max spacer dist: %d\n", maxSpacerDist);
+
+    printf("Threads: %d\n", num_threads);
+
+    if(min_qual > 0 && fastq){
+        printf("Masking bases under quality %d, quality offset %d.\n", min_qual, qual_offset);
+        SeqReader::setQualityMask(min_qual, qual_offset);
+    }
+
+    Bloom::setAllocationPolicy(bloom_pages, bloom_numa, num_threads);
+    if(target_fpr > 0){
+        Bloom::setFoldable(BLOOM_MAX_FOLDS);
+    }
+    printf("Bloom filter memory: %s\n", Bloom::describeAllocationPolicy().c_str());
+
+    if(single_pass && !from_bloom && !just_load){
+        spool_file = file_prefix + ".spool";
+        read_scan_file = spool_file;
+        printf("Single pass: the read scan replays the reads spooled to %s\n", spool_file.c_str());
+    }
     
     if(two_hash){
         printf("Using 2 hash functions.\n");
@@ -172,6 +420,36 @@ int handle_arguments(int argc, char *argv[]){
     else{
         printf("Using space-optimal hash settings.\n");
     }
+    if(bloom_layout == BLOOM_BLOCKED){
+        printf("Using blocked bloom filters.\n");
+    }
+    if(bloom_layout == BLOOM_MINIMIZER){
+        printf("Using minimizer-partitioned bloom filters, minimizer size %d.\n", std::min(minimizer_size, std::min(sizeKmer, 32)));
+    }
+    if(pow2_bloom){
+        printf("Using power of two sized bloom filters.\n");
+    }
+    if(hash_mode == BLOOM_HASH_ROLLING){
+        printf("Using the rolling kmer hash.\n");
+    }
+    if(counting_bloom){
+        printf("Using a counting bloom filter, minimal abundance %d.\n", min_abundance);
+    }
+    if(exact_budget > 0 && !from_bloom && kmer_db_file.empty()){
+        printf("Using an exact kmer set if it fits in %d MB.\n", exact_budget);
+    }
+    if(scalable_bloom){
+        printf("Using scalable bloom filters.\n");
+    }
+    if(!bucket_dir.empty() && !from_bloom){
+        printf("Loading the bloom filters through bucket files in %s.\n", bucket_dir.c_str());
+    }
+    if(jcheck_engine == JCHECK_DFS){
+        printf("Using the depth first j-check.\n");
+    }
+    if(target_fpr > 0){
+        printf("Folding the bloom filter down to a false positive rate of %f.\n", target_fpr);
+    }
 
     std::cout <<  "Paired ends: " << paired_ends << "\n";
     printf("Size of junction: %d\n", sizeof(Junction));
@@ -179,19 +457,44 @@ int handle_arguments(int argc, char *argv[]){
     printf("Size of contig: %d\n", sizeof(Contig));
     printf("Size of int: %d\n", sizeof(int));
     printf("Size of long: %d\n", sizeof(long));
+    return 0;
 }
  
 //create and load bloom filter
 Bloom* getBloomFilterFromFile(){
-    Bloom* bloom;
-        if(two_hash){
-            bloom = bloom->create_bloom_filter_2_hash(estimated_kmers, fpRate);
+    //a dump with a header describes its own filter, and is mapped rather than read
+    Bloom* bloom = Bloom::open_dump(bloom_input_file.c_str());
+    if(bloom){
+        if(bloom->getLayout() == BLOOM_COUNTING && min_abundance_flag){
+            bloom->setThreshold(min_abundance);
         }
-        else{
-            bloom = bloom->create_bloom_filter_optimal(estimated_kmers, fpRate);
-        }
-        bloom->load(&bloom_input_file[0]);
         return bloom;
+    }
+    //an older dump without a header is read into a filter sized from the arguments
+    if(counting_bloom){
+        bloom = Bloom::create_counting_filter(estimated_kmers, singletons, fpRate, min_abundance, !pow2_bloom);
+    }
+    else if(two_hash){
+        bloom = Bloom::create_bloom_filter_2_hash(estimated_kmers, fpRate, bloom_layout, !pow2_bloom);
+    }
+    else{
+        bloom = Bloom::create_bloom_filter_optimal(estimated_kmers, fpRate, bloom_layout, !pow2_bloom);
+    }
+    bloom->setHashMode(hash_mode);
+    bloom->setMinimizerSize(minimizer_size);
+    bloom->load(&bloom_input_file[0]);
+    return bloom;
+}
+
+//A pair filter dumped with a header (possibly frozen) is mapped from the file, an older one is read into filter
+Bloom* getPairFilterFromFile(Bloom* filter, string filename){
+    Bloom* mapped = Bloom::open_dump(filename.c_str());
+    if(mapped){
+        delete filter;
+        return mapped;
+    }
+    filter->load(&filename[0]);
+    return filter;
 }
 
 double my_func(double p1) { 
@@ -201,10 +504,39 @@ double my_func(double p1) {
 }
      
 
+//Whether the kmers are loaded into an exact kmer set rather than bloom filters: when it fits in -exact_budget
+bool useExactSet(){
+    if(exact_budget == 0){
+        return false;
+    }
+    if(sizeKmer > BLOOM_EXACT_MAX_K || mercy || scalable_bloom || lane_dump || !bucket_dir.empty() || min_abundance > BLOOM_MAX_COUNT){
+        printf("An exact kmer set can't be used with these options, using bloom filters.\n");
+        return false;
+    }
+    uint64_t bytes = Bloom::exact_set_bytes(estimated_kmers);
+    if(bytes > (uint64_t)exact_budget*1024*1024){
+        printf("An exact kmer set would take %.2f MB, more than -exact_budget, using bloom filters.\n", bytes/(1024.0*1024.0));
+        return false;
+    }
+    return true;
+}
+
 Bloom* getBloomFilterFromReads(){ //handles loading from reads
     Bloom* bloo1;
     Bloom* bloo2;
 
+    if(useExactSet()){
+        bloo1 = Bloom::create_exact_set(estimated_kmers, min_abundance);
+        load_counting_filter(bloo1, read_load_file, fastq, num_threads, spool_written ? "" : spool_file);
+        return bloo1;
+    }
+    if(counting_bloom){
+        bloo1 = bloo1->create_counting_filter(estimated_kmers, singletons, fpRate, min_abundance, !pow2_bloom);
+        bloo1->setHashMode(hash_mode);
+        load_counting_filter(bloo1, read_load_file, fastq, num_threads, spool_written ? "" : spool_file);
+        return bloo1;
+    }
+
     std::function<double (double)> f = my_func;
     double p1 = brents_fun(f, fpRate, 0.50, 0.0001, 1000);
     cout << "p2 is " << fpRate << " p1 estimated as " << p1 << endl;
@@ -214,35 +546,112 @@ Bloom* getBloomFilterFromReads(){ //handles loading from reads
     //     bloo2 = bloo2->create_bloom_filter_2_hash(estimated_kmers, fpRate);
     // }
     // else{
-    bloo1 = bloo1->create_bloom_filter_optimal(estimated_kmers, p1);
-    bloo2 = bloo2->create_bloom_filter_optimal(estimated_kmers, p1);
+    bloo1 = bloo1->create_bloom_filter_optimal(estimated_kmers, p1, bloom_layout, !pow2_bloom);
+    bloo2 = bloo2->create_bloom_filter_optimal(estimated_kmers, p1, bloom_layout, !pow2_bloom);
     // }
-    load_two_filters(bloo1, bloo2, read_load_file, fastq, mercy);
+    bloo1->setHashMode(hash_mode);
+    bloo2->setHashMode(hash_mode);
+    bloo1->setMinimizerSize(minimizer_size);
+    bloo2->setMinimizerSize(minimizer_size);
+    if(scalable_bloom){
+        bloo1->makeScalable();
+        bloo2->makeScalable();
+    }
+    if(!bucket_dir.empty()){
+        load_two_filters_bucketed(bloo1, bloo2, read_load_file, fastq, bucket_dir, buckets, num_threads, spool_written ? "" : spool_file);
+    }
+    else{
+        load_two_filters(bloo1, bloo2, read_load_file, fastq, mercy, num_threads, spool_written ? "" : spool_file);
+    }
+    if(lane_dump){
+        bloo1->dump(&(file_prefix + ".bloom1")[0]);
+    }
     delete(bloo1);
     return bloo2;
 }
 
 
+//A single filter holding the solid kmers of the kmer database
+Bloom* getBloomFilterFromKmerDB(){
+    uint64_t solid;
+    {
+        KmerDB db(kmer_db_file);
+        solid = db.countSolid(min_abundance);
+    }
+    printf("Solid kmers in the database, for sizing the bloom filter: %llu\n", (unsigned long long)solid);
+    Bloom* bloom;
+    if(two_hash){
+        bloom = Bloom::create_bloom_filter_2_hash(std::max(solid, (uint64_t)1), fpRate, bloom_layout, !pow2_bloom);
+    }
+    else{
+        bloom = Bloom::create_bloom_filter_optimal(std::max(solid, (uint64_t)1), fpRate, bloom_layout, !pow2_bloom);
+    }
+    bloom->setHashMode(hash_mode);
+    bloom->setMinimizerSize(minimizer_size);
+    if(scalable_bloom) bloom->makeScalable();
+    load_kmer_db(bloom, kmer_db_file, min_abundance, num_threads);
+    return bloom;
+}
+
 Bloom* getBloomFilterFromReadsSingle(){ //handles loading from reads
     Bloom* bloo1;
 
     if(two_hash){
-        bloo1 = bloo1->create_bloom_filter_2_hash(estimated_kmers, fpRate);
+        bloo1 = bloo1->create_bloom_filter_2_hash(estimated_kmers, fpRate, bloom_layout, !pow2_bloom);
     }
     else{
-        bloo1 = bloo1->create_bloom_filter_optimal(estimated_kmers, fpRate);
+        bloo1 = bloo1->create_bloom_filter_optimal(estimated_kmers, fpRate, bloom_layout, !pow2_bloom);
     }
-    load_single_filter(bloo1, read_load_file, fastq);
+    bloo1->setHashMode(hash_mode);
+    bloo1->setMinimizerSize(minimizer_size);
+    if(scalable_bloom) bloo1->makeScalable();
+    load_single_filter(bloo1, read_load_file, fastq, num_threads);
     return bloo1;
 }
 
+//Folds the loaded filter while its estimated false positive rate stays at most target_fpr, before the read scan
+void foldBloomFilter(Bloom* bloom){
+    if(!bloom->canFold()){
+        printf("This bloom filter can't be folded.\n");
+        return;
+    }
+    double before = bloom->estimatedFpRate();
+    uint64_t bytes = bloom->tai/8;
+    int folds = bloom->autoFold(target_fpr);
+    printf("Folded the bloom filter %d times: %.2f MB instead of %.2f MB, estimated false positive rate %f instead of %f\n",
+        folds, bloom->tai/8/(1024.0*1024.0), bytes/(1024.0*1024.0), bloom->estimatedFpRate(), before);
+    printf("Weight after folding: %f\n", bloom->weight());
+}
+
+//Fills in whichever of estimated_kmers and singletons wasn't given, with a pass over the load file.
+//In single pass mode that pass writes the spool, and the load replays it instead of reading the input again.
+void estimateKmerCounts(){
+    uint64_t distinct, ones;
+    estimate_kmer_counts(read_load_file, fastq, distinct, ones, num_threads, from_bloom ? "" : spool_file);
+    if(!spool_file.empty() && !from_bloom){
+        read_load_file = spool_file;
+        spool_written = true;
+    }
+    if(!est_kmers_flag){
+        estimated_kmers = std::max(distinct, (uint64_t)1);
+    }
+    if(!est_sing_flag){
+        singletons = std::min(ones, estimated_kmers);
+    }
+    printf("Estimated number of distinct kmers, for sizing bloom filter: %llu.\n", (unsigned long long)estimated_kmers);
+    printf("Singletons: %llu.\n", (unsigned long long)singletons);
+}
+
 //Builds the junction map from either a file or the readscan
 void buildJunctionMapFromReads(JunctionMap* junctionMap, Bloom* bloom, Bloom* short_pair_filter, Bloom* long_pair_filter, JChecker* jchecker, bool no_cleaning){
     ReadScanner* scanner = new ReadScanner(junctionMap, read_scan_file, bloom, short_pair_filter, long_pair_filter, jchecker, maxSpacerDist);
      
     //scan reads, print summary
-    scanner->scanReads(fastq, paired_ends, no_cleaning);
+    scanner->scanReads(fastq, paired_ends, no_cleaning, num_threads);
     scanner->printScanSummary();
+    if(!spool_file.empty()){
+        remove(spool_file.c_str());
+    }
 }
 
 int main(int argc, char *argv[])
@@ -252,47 +661,73 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    if(estimate_kmers){
+        estimateKmerCounts();
+    }
+
     //Build bloom filter from reads or file, and dump to file
     Bloom* bloom;
     if(from_bloom){
         bloom = getBloomFilterFromFile();
     }
     else{
-        bloom = getBloomFilterFromReads();
+        bloom = kmer_db_file.empty() ? getBloomFilterFromReads() : getBloomFilterFromKmerDB();
+        if(target_fpr > 0 && !bloom->isExact()) foldBloomFilter(bloom);
         bloom->dump(&(file_prefix + ".bloom")[0]);
     }
     
     Bloom* short_pair_filter;
     Bloom* long_pair_filter;
+    //pair filters hold pairs of kmers rather than kmers, so they have no minimizers to partition by
+    int pair_layout = (bloom_layout == BLOOM_MINIMIZER) ? BLOOM_BLOCKED : bloom_layout;
     if (!high_cov){
         if (mercy){ // mercy kmers leads to more junctions being formed --> double size of filters
-            short_pair_filter = short_pair_filter->create_bloom_filter_optimal(estimated_kmers/10, 0.01);
-            if (paired_ends) long_pair_filter = long_pair_filter->create_bloom_filter_optimal(estimated_kmers/5, 0.01);
+            short_pair_filter = short_pair_filter->create_bloom_filter_optimal(estimated_kmers/10, 0.01, pair_layout, !pow2_bloom);
+            if (paired_ends) long_pair_filter = long_pair_filter->create_bloom_filter_optimal(estimated_kmers/5, 0.01, pair_layout, !pow2_bloom);
             else long_pair_filter = nullptr;    
         }else{
-            short_pair_filter = short_pair_filter->create_bloom_filter_optimal(estimated_kmers/20, 0.01);
-            if (paired_ends) long_pair_filter = long_pair_filter->create_bloom_filter_optimal(estimated_kmers/10, 0.01);
+            short_pair_filter = short_pair_filter->create_bloom_filter_optimal(estimated_kmers/20, 0.01, pair_layout, !pow2_bloom);
+            if (paired_ends) long_pair_filter = long_pair_filter->create_bloom_filter_optimal(estimated_kmers/10, 0.01, pair_layout, !pow2_bloom);
             else long_pair_filter = nullptr;
         }
     }else {
-        short_pair_filter = short_pair_filter->create_bloom_filter_optimal(estimated_kmers/2, 0.01);
-        if (paired_ends) long_pair_filter = long_pair_filter->create_bloom_filter_optimal(estimated_kmers/2, 0.01);
+        short_pair_filter = short_pair_filter->create_bloom_filter_optimal(estimated_kmers/2, 0.01, pair_layout, !pow2_bloom);
+        if (paired_ends) long_pair_filter = long_pair_filter->create_bloom_filter_optimal(estimated_kmers/2, 0.01, pair_layout, !pow2_bloom);
         else long_pair_filter = nullptr;
     }
     if(just_load) return 0;
+    if(scalable_bloom && !from_junctions){
+        short_pair_filter->makeScalable();
+        if (paired_ends) long_pair_filter->makeScalable();
+    }
+    if(freeze_pairs && !from_junctions){
+        short_pair_filter->collectPairs();
+        if (paired_ends) long_pair_filter->collectPairs();
+    }
     
     //create JChecker
     JChecker* jchecker = new JChecker(j, bloom);
+    jchecker->setEngine(jcheck_engine);
+    JCheckCache* jcheckCache = nullptr;
+    if(jcheck_cache > 0){
+        jcheckCache = new JCheckCache((uint64_t)jcheck_cache*1024*1024);
+        jchecker->setCache(jcheckCache);
+        printf("J-check cache: %llu entries\n", (unsigned long long)jcheckCache->getEntries());
+    }
 
     //Build junction map from either reads or file
     JunctionMap* junctionMap = new JunctionMap(bloom, jchecker, read_length);
     if(from_junctions){
         junctionMap->buildFromFile(junctions_input_file);
-        short_pair_filter->load(&short_pair_filter_file[0]);
-        long_pair_filter->load(&long_pair_filter_file[0]);
+        short_pair_filter = getPairFilterFromFile(short_pair_filter, short_pair_filter_file);
+        if (paired_ends) long_pair_filter = getPairFilterFromFile(long_pair_filter, long_pair_filter_file);
     }
     else{
         buildJunctionMapFromReads(junctionMap, bloom, short_pair_filter, long_pair_filter, jchecker, no_cleaning);
+        if(freeze_pairs){
+            short_pair_filter->freezePairs();
+            if (paired_ends) long_pair_filter->freezePairs();
+        }
         junctionMap->writeToFile(file_prefix + ".junctions");
         if(!no_cleaning){
             short_pair_filter->dump(&(file_prefix + ".short_pair_filter")[0]);
@@ -301,12 +736,15 @@ int main(int argc, char *argv[])
     }
     //dump junctions to file
     
-    printf("Weight of short pair filter: %f\n", short_pair_filter->weight());
-    if (paired_ends) printf("Weight of long pair filter: %f\n", long_pair_filter->weight());
+    if(!short_pair_filter->isFrozen()){
+        printf("Weight of short pair filter: %f\n", short_pair_filter->weight());
+        if (paired_ends) printf("Weight of long pair filter: %f\n", long_pair_filter->weight());
+    }
     printf("Number of junctions: %d\n", junctionMap->junctionMap.size());
     ContigGraph* contigGraph = junctionMap->buildContigGraph();
     contigGraph->setReadLength(read_length);
     delete(bloom);
+    delete(jcheckCache);
 
 
     // contigGraph->checkGraph();
@@ -5,12 +5,15 @@
 #include "../utils/Kmer.h"
 #include "../utils/Junction.h"
 #include "../utils/JChecker.h"
+#include "../utils/KmerDB.h"
 #include "ReadScanner.h"
 #include "ContigNode.h"
 #include "Contig.h"
 #include "ReadScanner.h"
 #include "ContigGraph.h"
 
+#define NNKS 2 // default minimal abundance for solidity
+
 float fpRate = .04;
 int j = 1;
 
@@ -45,6 +48,35 @@ bool mercy = false;
 bool node_graph = false;
 bool paired_ends = false;
 bool no_cleaning = false;
+int num_threads = 1; // worker threads for loading the bloom filter and scanning reads
+bool single_pass = false; // read the input once, spooling it for the read scan
+string spool_file; // read spool written by the load and replayed by the scan in single pass mode
+bool spool_written = false; // the spool was written by the estimate pass, so the load replays it too
+bool estimate_kmers = false; // estimate whichever of estimated_kmers and singletons isn't given
+int bloom_layout = BLOOM_CLASSIC; // bit layout of the bloom filters, see Bloom.h
+int minimizer_size = BLOOM_DEFAULT_MINIMIZER; // length of the minimizers picking the partitions of BLOOM_MINIMIZER filters
+bool minimizer_size_flag = false;
+bool pow2_bloom = false; // round the bloom filters up to a power of two, as in older dumps
+bool counting_bloom = false; // load a single counting filter instead of the bloo1/bloo2 pair
+int min_abundance = NNKS; // times a kmer must be seen to be solid, with the counting filter
+bool min_abundance_flag = false;
+int hash_mode = BLOOM_HASH_OLD; // how the kmer filters hash kmers, see Bloom.h
+float target_fpr = 0; // fold the loaded bloom filter while its estimated false positive rate stays under this, 0 to keep it
+bool scalable_bloom = false; // add sub-filters to the filters as they fill up, see Bloom::makeScalable
+bool freeze_pairs = false; // freeze the pair filters into xor filters after the read scan
+bool lane_dump = false; // also dump bloo1, for faucet-bloom-merge
+string kmer_db_file; // kmer database to build the bloom filter from instead of the reads, see KmerDB.h
+int min_qual = 0; // bases of fastq reads under this Phred quality are read as N, 0 to keep every base
+int qual_offset = 33; // quality character of Phred quality 0
+bool qual_offset_flag = false;
+int jcheck_engine = JCHECK_BFS; // how the j-check searches the extensions, see JChecker::setEngine
+int jcheck_cache = 0; // MB for the cache of j-check results, 0 for no cache
+int exact_budget = 0; // MB an exact kmer set may take in place of the bloom filters, 0 to always use bloom filters
+string bucket_dir; // directory for the bucket files of a bucketed load, empty to load the filters directly
+int buckets = 0; // bucket files of a bucketed load, 0 to pick from the filter size
+bool buckets_flag = false;
+int bloom_pages = BLOOM_PAGES_SMALL; // page size policy for the filters' bit arrays, see Bloom::setAllocationPolicy
+int bloom_numa = BLOOM_NUMA_NONE; // NUMA placement of the filters' bit arrays
 int maxSpacerDist = 100; //max is 128, smaller --> more frequent spacers, bigger --> less frequent.  Measured in base pairs
 int64_t nb_reads;
 bool high_cov = false;
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include "../utils/Kmer.h"
+#include "../utils/KmerDB.h"
+
+using namespace std;
+
+/*
+faucet-kmer-db converts the text dump of a kmer counter to a kmer database (see utils/KmerDB.h), which faucet loads with
+-kmer_db instead of loading the bloom filter from the reads.  Build it with make faucet-kmer-db.
+
+Type ./faucet-kmer-db followed by:
+-size_kmer k
+-counts_file <>, the counted kmers, either one "kmer count" per line, separated by spaces or a tab (jellyfish dump -c,
+    kmc_dump), or in fasta form with the count as the header of each kmer (jellyfish dump)
+-kmer_db <>, the database to write
+-min_count <>, leave out the kmers counted fewer times, default 1
+
+The counts should come from a canonical count (e.g. jellyfish count -C), since both strands of a kmer are stored as one.
+Kmers of another length or with other characters than ACGT are skipped.
+*/
+
+string counts_file;
+string kmer_db_file;
+uint32_t min_count = 1;
+
+void argumentError(){
+    fprintf(stderr, "Usage: ./faucet-kmer-db -size_kmer <k> -counts_file <filename> -kmer_db <filename> [-min_count <count>]\n");
+}
+
+int handle_arguments(int argc, char *argv[]){
+    bool k_val_flag = false;
+    for(int i = 1; i < argc; i++){
+        if(0 == strcmp(argv[i], "-size_kmer") && i + 1 < argc)
+                setSizeKmer(atoi(argv[i+1])), i++, k_val_flag = true;
+        else if(0 == strcmp(argv[i], "-counts_file") && i + 1 < argc)
+                counts_file = string(argv[i+1]), i++;
+        else if(0 == strcmp(argv[i], "-kmer_db") && i + 1 < argc)
+                kmer_db_file = string(argv[i+1]), i++;
+        else if(0 == strcmp(argv[i], "-min_count") && i + 1 < argc)
+                min_count = atoi(argv[i+1]), i++;
+        else if(0 == strcmp(argv[i], "--help") || 0 == strcmp(argv[i], "-h")){
+            argumentError();
+            return 1;
+        }
+        else{
+            fprintf(stderr, "Cannot parse tag %s\n", argv[i]);
+            argumentError();
+            return 1;
+        }
+    }
+    if(!k_val_flag || counts_file.empty() || kmer_db_file.empty()){
+        fprintf(stderr, "Some required argument is missing.\n");
+        argumentError();
+        return 1;
+    }
+    return 0;
+}
+
+//Sets kmer to the packed canonical kmer of seq, returning false if seq isn't a kmer of valid nucleotides
+bool parseKmer(const string& seq, kmer_type& kmer){
+    if((int)seq.length() != sizeKmer){
+        return false;
+    }
+    kmer = 0;
+    for(char c : seq){
+        if(!strchr("ACGTacgt", c)){
+            return false;
+        }
+        kmer = (kmer << 2) + NT2int(c);
+    }
+    kmer = get_canon(kmer);
+    return true;
+}
+
+int main(int argc, char *argv[]){
+    if(handle_arguments(argc, argv) == 1){
+        return 1;
+    }
+    time_t start, stop;
+    time(&start);
+    ifstream counts(counts_file.c_str());
+    if(!counts){
+        fprintf(stderr, "Could not open %s\n", counts_file.c_str());
+        return 1;
+    }
+    KmerDBWriter db(kmer_db_file, sizeKmer);
+    if(!db.isOpen()){
+        return 1;
+    }
+
+    string line, seq;
+    uint64_t lines = 0, skipped = 0, low = 0;
+    uint32_t count;
+    bool fastaCount = false; //the last line was a count header
+    while(getline(counts, line)){
+        lines++;
+        if(line.empty()){
+            continue;
+        }
+        if(line[0] == '>'){
+            count = strtoul(line.c_str() + 1, nullptr, 10);
+            fastaCount = true;
+            continue;
+        }
+        size_t split = line.find_first_of(" \t");
+        if(split != string::npos){
+            seq = line.substr(0, split);
+            count = strtoul(line.c_str() + split + 1, nullptr, 10);
+        }
+        else if(fastaCount){
+            seq = line;
+        }
+        else{
+            skipped++;
+            continue;
+        }
+        fastaCount = false;
+        kmer_type kmer;
+        if(!parseKmer(seq, kmer)){
+            skipped++;
+            continue;
+        }
+        if(count < min_count){
+            low++;
+            continue;
+        }
+        db.write(kmer, count);
+    }
+    printf("Lines read: %llu\n", (unsigned long long)lines);
+    printf("Kmers written: %llu, counted fewer than %u times: %llu, skipped: %llu\n", (unsigned long long)db.getCount(),
+        min_count, (unsigned long long)low, (unsigned long long)skipped);
+    time(&stop);
+    printf("Time to convert: %f \n", difftime(stop,start));
+    return 0;
+}
@@ -3,6 +3,8 @@
 #include <fstream>
 #include <string>
 #include <time.h>
+#include <thread>
+#include <mutex>
 using namespace std;
 
 
@@ -20,12 +22,40 @@ void ReadScanner::printScanSummary(){
   printf("\nDistinct junctions: %lli \n", (uint64_t)junctionMap->getNumJunctions());
   //printf("Number of junction pairs that exist on reads: %d\n", juncPairSet.size());
   printf("Number of kmers that we j-checked: %lli \n", NbJCheckKmer);
+  jchecker->printCacheSummary("read scan");
   printf("Number of reads with no junctions: %lli \n",NbNoJuncs);
   printf("Number of processed kmers: %lli \n", NbProcessed);
   printf("Number of skipped kmers: %lli \n", NbSkipped);
   printf("Reads without errors: %lli\n", readsNoErrors);
 }
 
+void ReadScanner::resetCounters(){
+  NbCandKmer=0, NbRawCandKmer = 0, NbJCheckKmer = 0, NbNoJuncs = 0, 
+  NbSkipped = 0, NbProcessed = 0, readsProcessed = 0, NbSolidKmer =0, 
+  readsNoErrors = 0,  NbJuncPairs = 0, unambiguousReads = 0,
+  emptyCount = 0, notEmptyCount = 0;
+}
+
+void ReadScanner::addCoverage(Junction* junc, int nucExt){
+  if(junctionMap->isConcurrent()) junc->addCoverageAtomic(nucExt);
+  else junc->addCoverage(nucExt);
+}
+
+void ReadScanner::updateJunction(Junction* junc, int nucExt, unsigned char length){
+  if(junctionMap->isConcurrent()) junc->updateAtomic(nucExt, length);
+  else junc->update(nucExt, length);
+}
+
+int ReadScanner::getJunctionDist(Junction* junc, int nucExt){
+  if(junctionMap->isConcurrent()) return junc->getDistAtomic(nucExt);
+  return junc->dist[nucExt];
+}
+
+void ReadScanner::addPair(Bloom* filter, JuncPair pair){
+  if(junctionMap->isConcurrent()) filter->atomic_addPair(pair);
+  else filter->addPair(pair);
+}
+
 JunctionMap* ReadScanner::getJunctionMap(){
   return junctionMap;
 }
@@ -34,21 +64,20 @@ JunctionMap* ReadScanner::getJunctionMap(){
 //Uses as a reference "real_ext" since it knows that's one valid path
 //Should only be called on a kmer at least j away from the end of the read
 bool ReadScanner::testForJunction(ReadKmer readKmer){
-  kmer_type real_ext = readKmer.getRealExtension();
   //Check alternate extensions, and if the total valid extension count is greater than 1, return true. 
-  kmer_type real = readKmer.getKmer();
   // if (real_ext == revcomp(real)){ return true; }
 
-  for(int nt=0; nt<4; nt++) {//for each extension
-    kmer_type test_ext = readKmer.getExtension(nt); //get possible extension
-    if(real_ext != test_ext){//if the alternate and real extensions are different- note that I took out the other two distinction checks
-      if(bloom->oldContains(get_canon(test_ext)))//if the branch checks out initially
-      { 
+  //extensions that check out initially in the bloom, leaving out the real one
+  int mask = bloom->extensionMask(readKmer.doubleKmer, readKmer.direction) & ~(1 << readKmer.getRealExtensionNuc());
+  //the kmer as seen in the scan direction, whose forward extensions are the branches
+  kmer_type kmer = (readKmer.direction == FORWARD) ? readKmer.doubleKmer.kmer : readKmer.doubleKmer.revcompKmer;
+
+  for(int nt=0; nt<4; nt++) {//for each alternate extension
+    if(mask & (1 << nt)){
         NbJCheckKmer++;
-        if(jchecker->jcheck(test_ext)){//if the branch jchecks
+        if(jchecker->jcheckExtension(kmer, nt)){//if the branch jchecks
             return true;
         }
-      }
     }
   }
 
@@ -89,15 +118,15 @@ bool ReadScanner::find_next_junction(ReadKmer * readKmer, int lastJuncPos){
 //Adds a fake junction in the middle and points it to the two ends.  This ensures we have coverage of long linear regions, and that we capture
 //sinks at the end of such regions.
 //Returns the real extension of the fake junction, for junction pairing
-kmer_type ReadScanner::add_fake_junction(string read){
+kmer_type ReadScanner::add_fake_junction(ReadSpan read){
   // std::cout << "added fake junction\n";
-  ReadKmer* middleKmer = new ReadKmer(&read, read.length()/2- sizeKmer/2, FORWARD);
+  ReadKmer* middleKmer = new ReadKmer(read, read.length/2- sizeKmer/2, FORWARD);
   kmer_type extension = middleKmer->getRealExtension();
   junctionMap->createJunction(middleKmer);
   Junction* junc = junctionMap->getJunction(middleKmer);
-  junc->addCoverage(middleKmer->getRealExtensionNuc());
-  junc->update(middleKmer->getExtensionIndex(BACKWARD), middleKmer->getTotalPos()-2*jchecker->j);
-  junc->update(middleKmer->getExtensionIndex(FORWARD), middleKmer->getDistToEnd()-2*jchecker->j);
+  addCoverage(junc, middleKmer->getRealExtensionNuc());
+  updateJunction(junc, middleKmer->getExtensionIndex(BACKWARD), middleKmer->getTotalPos()-2*jchecker->j);
+  updateJunction(junc, middleKmer->getExtensionIndex(FORWARD), middleKmer->getDistToEnd()-2*jchecker->j);
   delete middleKmer;
   middleKmer = nullptr;
   return extension;
@@ -110,8 +139,12 @@ kmer_type ReadScanner::add_fake_junction(string read){
 //Junction to point to the end of the read.
 //If there are no junctions, add_fake_junction is called
 std::list<kmer_type> ReadScanner::scan_forward(string read, bool no_cleaning){
+  return scan_forward(ReadSpan{read.c_str(), (int)read.length()}, no_cleaning);
+}
+
+std::list<kmer_type> ReadScanner::scan_forward(ReadSpan read, bool no_cleaning){
   std::list<kmer_type> result = {};
-  ReadKmer* readKmer = new ReadKmer(&read);//stores current kmer throughout
+  ReadKmer* readKmer = new ReadKmer(read);//stores current kmer throughout
 
   for(int i = 0; i < 2*jchecker->j + 1; i++){
     readKmer->forward();  
@@ -169,7 +202,7 @@ std::list<kmer_type> ReadScanner::scan_forward(string read, bool no_cleaning){
       }
     }
 
-    junc->addCoverage(readKmer->getRealExtensionNuc()); //add coverage of the junction
+    addCoverage(junc, readKmer->getRealExtensionNuc()); //add coverage of the junction
     
     //if there was a last junction, link the two 
     if(lastKmer){
@@ -179,15 +212,14 @@ std::list<kmer_type> ReadScanner::scan_forward(string read, bool no_cleaning){
     else{ 
       // std::cout<< "first junc position is " << readKmer->getTotalPos()-2*jchecker->j <<std::endl;
       lastKmer = new ReadKmer(readKmer);
-      junc
-        ->update(readKmer->getExtensionIndex(BACKWARD), readKmer->getTotalPos()-2*jchecker->j);//-2*j ADDED
+      updateJunction(junc, readKmer->getExtensionIndex(BACKWARD), readKmer->getTotalPos()-2*jchecker->j);//-2*j ADDED
     }
 
     *lastKmer = *readKmer;
     lastJunc = junc;
 
     int index = readKmer->getExtensionIndex(FORWARD);
-    int dist = max(1, (int)(junc->dist[index]));
+    int dist = max(1, getJunctionDist(junc, index));
     // std::cout << dist << std::endl;
     readKmer->advanceDist(dist); 
 
@@ -202,23 +234,23 @@ std::list<kmer_type> ReadScanner::scan_forward(string read, bool no_cleaning){
   }
   else {
     //If there was at least one junction, point the last junction found to the end of the read
-    lastJunc->update(lastKmer->getExtensionIndex(FORWARD), lastKmer->getDistToEnd()-2*jchecker->j); //2*j ADDED
+    updateJunction(lastJunc, lastKmer->getExtensionIndex(FORWARD), lastKmer->getDistToEnd()-2*jchecker->j); //2*j ADDED
     // std::cout << "some junction exists, connecting with "<< lastKmer->getDistToEnd()-2*jchecker->j << std::endl;
   }
   if (!no_cleaning){
     if(result.size()==2){
       if (firstBackJunc && lastForwardJunc && !(rev_pos > for_pos)){ // outward facing pair
-        short_pair_filter->addPair(JuncPair(firstBackJunc->getRealExtension(), lastForwardJunc->getRealExtension()));
+        addPair(short_pair_filter, JuncPair(firstBackJunc->getRealExtension(), lastForwardJunc->getRealExtension()));
       }
       if ((firstBackJunc && !lastForwardJunc) || (!firstBackJunc && lastForwardJunc)){ // 2 juncs facing in same direction
-        short_pair_filter->addPair(JuncPair(result.front(), result.back())); // don't need to getRealExtension because was done on insertion     
+        addPair(short_pair_filter, JuncPair(result.front(), result.back())); // don't need to getRealExtension because was done on insertion     
       }
     }
     else if(result.size()>2){ 
       // copy list to vector to be able to iterate over - not sure if this is optimal
       std::vector<kmer_type> v{ std::begin(result), std::end(result) };
       for (int i = 0; i< v.size()-2; i++){
-        short_pair_filter->addPair(JuncPair(v[i], v[i+2]));            
+        addPair(short_pair_filter, JuncPair(v[i], v[i+2]));
       }
       v.clear();
     }
@@ -232,46 +264,53 @@ std::list<kmer_type> ReadScanner::scan_forward(string read, bool no_cleaning){
 
 std::list<string> ReadScanner::getValidReads(string read){
   std::list<string> result = {};
+  std::vector<ReadSpan> valid;
+  getValidReads(ReadSpan{read.c_str(), (int)read.length()}, valid);
+  for(ReadSpan span : valid){
+    result.push_back(string(span.seq, span.length));
+  }
+  return result;
+}
+
+void ReadScanner::getValidReads(ReadSpan read, std::vector<ReadSpan>& valid){
+  valid.clear();
   //Move to the first valid kmer
   int start = 0, end = 0;
   int minLength = sizeKmer;//only use valid reads with at least this many valid kmers
 
-  for(ReadKmer kmer = ReadKmer(&read); kmer.getDistToEnd()>= 0; kmer.forward(), kmer.forward()){
-    if(bloom->oldContains(kmer.getCanon())){
+  //look up all the kmers of the read at once
+  int kmerCount = bloom->contains_read(read, readKmersFound);
+
+  for(int pos = 0; pos < kmerCount; pos++){
+    if(readKmersFound[pos]){
       end++;
     } 
     else{
       if(end >= start + minLength){ //buffer to ensure no reads exactly kmer size- might be weird edge cases there
-        result.push_back(read.substr(start, end-start + sizeKmer-1));
-        // std::cout << "Adding " << read.substr(start, end-start + sizeKmer) << " as valid string\n";
+        valid.push_back({read.seq + start, end-start + sizeKmer-1});
       }
-      start = kmer.pos + 1;
-      end = kmer.pos + 1;
+      start = pos + 1;
+      end = pos + 1;
     }
   }
    if(end >= start + minLength){ //buffer to ensure no reads exactly kmer size- might be weird edge cases there
-        result.push_back(read.substr(start, end-start+sizeKmer-1));
-        // std::cout << "Adding " << read.substr(start, end-start+sizeKmer) << " as valid string\n";
+        valid.push_back({read.seq + start, end-start+sizeKmer-1});
     }
-  return result;
 }
 
 //returns back junctions for use in paired end info
 std::list<kmer_type> ReadScanner::scanInputRead(string read, bool no_cleaning){
+  return scanInputRead(ReadSpan{read.c_str(), (int)read.length()}, no_cleaning);
+}
+
+std::list<kmer_type> ReadScanner::scanInputRead(ReadSpan read, bool no_cleaning){
   std::list<kmer_type> result = {};
-  std::list<string> readList = getUnambiguousReads(read);
-  std::list<string> validReads;
-  string validRead;
-  while(!readList.empty()){
-        read = readList.front();
-        readList.pop_front();
-        if(read.length() >= sizeKmer + 2*jchecker->j + 1){
+  getUnambiguousSpans(read, unambiguousPieces);
+  for(ReadSpan piece : unambiguousPieces){
+        if(piece.length >= sizeKmer + 2*jchecker->j + 1){
           unambiguousReads++;
-          validReads = getValidReads(read);
-          // std::cout << "there are " << validReads.size() << " valid reads\n";
-          while(!validReads.empty()){
-            validRead = validReads.front();
-            validReads.pop_front();
+          getValidReads(piece, validPieces);
+          for(ReadSpan validRead : validPieces){
             result.splice(result.end(),scan_forward(validRead, no_cleaning));
             readsNoErrors++;
           }
@@ -281,80 +320,150 @@ std::list<kmer_type> ReadScanner::scanInputRead(string read, bool no_cleaning){
     return result;
 }
 
-void ReadScanner::scanReads(bool fastq, bool paired_ends, bool no_cleaning)
+//Current logic: ensure each one in the first list has a pair in the second
+void ReadScanner::pairMates(std::list<kmer_type>& backJuncs1, std::list<kmer_type>& backJuncs2, bool no_cleaning){
+  if(!backJuncs1.empty() && !backJuncs2.empty()){
+    notEmptyCount++;
+    //printf("Backjuncs1 and backjunc2 both not empty.\n");
+    for(auto it = backJuncs1.begin(); it != backJuncs1.end(); it++){
+        //printf("Processing one back junc 1\n");
+        kmer_type pair1 = *it;
+        bool paired = false;
+        if (!no_cleaning){
+          for(auto it2 = backJuncs2.begin(); it2 != backJuncs2.end(); it2++){
+            kmer_type pair2 = *it2;
+             
+            // long_pair_filter->addPair(JuncPair(pair1, pair2));
+
+            if(long_pair_filter->containsPair(JuncPair(pair1,pair2))){
+                paired = true;
+                break;
+            }
+          }
+          if (!paired){
+            addPair(long_pair_filter, JuncPair(pair1, *backJuncs2.begin()));
+          }
+      }
+    }
+  }
+  else{emptyCount++;}
+}
+
+void ReadScanner::scanReadsThreaded(bool fastq, bool paired_ends, bool no_cleaning, int threads){
+  SeqReader reader(reads_file, fastq, threads);
+  std::mutex progressLock;
+
+  std::vector<ReadScanner*> workers;
+  for(int i = 0; i < threads; i++){
+    ReadScanner* worker = new ReadScanner(junctionMap, reads_file, bloom, short_pair_filter, long_pair_filter, new JChecker(jchecker->j, bloom), maxSpacerDist);
+    worker->jchecker->setCache(jchecker->getCache());
+    worker->jchecker->setEngine(jchecker->getEngine());
+    worker->resetCounters();
+    workers.push_back(worker);
+  }
+
+  junctionMap->startConcurrentScan();
+  if(jchecker->getCache()) jchecker->getCache()->startConcurrent();
+  auto work = [&](ReadScanner* worker){
+    SeqBatch batch;
+    std::list<kmer_type> backJuncs1;
+    std::list<kmer_type> backJuncs2;
+    int count;
+    //READ_BATCH_SIZE is even, so both mates of a pair always land in the same batch
+    while((count = reader.nextBatch(batch, READ_BATCH_SIZE)) > 0){
+      {
+        std::lock_guard<std::mutex> guard(progressLock);
+        if ((readsProcessed + count)/100000 != readsProcessed/100000){
+          fprintf (stdout,"\rreads scanned: %lld",(long long)(readsProcessed + count));
+          fflush(stdout);
+        }
+        readsProcessed += count;
+      }
+      for(int i = 0; i < batch.size(); i++){
+        if(i % 2 == 0){
+          backJuncs1 = worker->scanInputRead(batch[i], no_cleaning);
+        }
+        else{
+          backJuncs2 = worker->scanInputRead(batch[i], no_cleaning);
+          if(paired_ends) worker->pairMates(backJuncs1, backJuncs2, no_cleaning);
+        }
+      }
+    }
+  };
+  std::vector<std::thread> pool;
+  for(int i = 0; i < threads; i++){
+    pool.push_back(std::thread(work, workers[i]));
+  }
+  for(auto& t : pool){
+    t.join();
+  }
+  junctionMap->finishConcurrentScan();
+  if(jchecker->getCache()) jchecker->getCache()->finishConcurrent();
+
+  for(ReadScanner* worker : workers){
+    jchecker->cacheHits += worker->jchecker->cacheHits, jchecker->cacheMisses += worker->jchecker->cacheMisses;
+    NbJCheckKmer += worker->NbJCheckKmer, NbNoJuncs += worker->NbNoJuncs, NbSkipped += worker->NbSkipped,
+    NbProcessed += worker->NbProcessed, readsNoErrors += worker->readsNoErrors, unambiguousReads += worker->unambiguousReads,
+    emptyCount += worker->emptyCount, notEmptyCount += worker->notEmptyCount;
+    delete worker->jchecker;
+    delete worker;
+  }
+}
+
+void ReadScanner::scanReads(bool fastq, bool paired_ends, bool no_cleaning, int threads)
 {
-  NbCandKmer=0, NbRawCandKmer = 0, NbJCheckKmer = 0, NbNoJuncs = 0, 
-  NbSkipped = 0, NbProcessed = 0, readsProcessed = 0, NbSolidKmer =0, 
-  readsNoErrors = 0,  NbJuncPairs = 0, unambiguousReads = 0;
+  resetCounters();
 
   time_t start;
   time_t stop;
   time(&start);
 
-  ifstream solidReads;
-  solidReads.open(reads_file);
+  if(threads > 1){
+    printf("Weight before read scan: %f \n", bloom->weight());
+    printf("Scanning with %d threads\n", threads);
+    scanReadsThreaded(fastq, paired_ends, no_cleaning, threads);
+    printf("\nEmpty count: %llu, not empty count: %llu\n", (unsigned long long)emptyCount, (unsigned long long)notEmptyCount);
+    time(&stop);
+    printf("Reads processed: %llu\n", (unsigned long long)readsProcessed);
+    printf("Unambiguous reads: %llu\n", (unsigned long long)unambiguousReads);
+    printf("Time in seconds for read scan: %f \n", difftime(stop,start));
+    return;
+  }
 
-  string read;
+  SeqReader reader(reads_file, fastq);
+  SeqBatch batch;
 
   // write all positive extensions in disk file
   printf("Weight before read scan: %f \n", bloom->weight());
-  int lastSum = 0, thisSum = 0;
   bool firstEnd = true;
   std::list<kmer_type> backJuncs1;
   std::list<kmer_type> backJuncs2;
-  int emptyCount = 0, notEmptyCount = 0;
-  while (getline(solidReads, read))
+  while (reader.nextBatch(batch, READ_BATCH_SIZE) > 0)
   {
-    getline(solidReads, read);//since it's a fasta we skip the first of every pair of lines
-    // std::cout << "read" << std::endl;
-    if(firstEnd){
-      backJuncs1 = scanInputRead(read, no_cleaning);
-    }
-    else{
-      backJuncs2 = scanInputRead(read, no_cleaning);
-    }
+    for(ReadSpan read : batch.reads){
+      if(firstEnd){
+        backJuncs1 = scanInputRead(read, no_cleaning);
+      }
+      else{
+        backJuncs2 = scanInputRead(read, no_cleaning);
+      }
     
-    if(paired_ends && !firstEnd){//Current logic: ensure each one in the first list has a pair in the second
-      if(!backJuncs1.empty() && !backJuncs2.empty()){
-        notEmptyCount++;
-        //printf("Backjuncs1 and backjunc2 both not empty.\n");
-        for(auto it = backJuncs1.begin(); it != backJuncs1.end(); it++){
-            //printf("Processing one back junc 1\n");
-            kmer_type pair1 = *it;
-            bool paired = false;
-            if (!no_cleaning){
-              for(auto it2 = backJuncs2.begin(); it2 != backJuncs2.end(); it2++){
-                kmer_type pair2 = *it2;
-                 
-                // long_pair_filter->addPair(JuncPair(pair1, pair2));
-
-                if(long_pair_filter->containsPair(JuncPair(pair1,pair2))){
-                    paired = true;
-                    break;
-                }
-              }
-              if (!paired){
-                long_pair_filter->addPair(JuncPair(pair1, *backJuncs2.begin()));
-              }
-          }
-        }
+      if(paired_ends && !firstEnd){
+        pairMates(backJuncs1, backJuncs2, no_cleaning);
       }
-      else{emptyCount++;}
-    }
-    if ((readsProcessed%100000)==0){
-      fprintf (stdout,"\rreads scanned: %lld",(long long)readsProcessed);
-      fflush(stdout);
+      if ((readsProcessed%100000)==0){
+        fprintf (stdout,"\rreads scanned: %lld",(long long)readsProcessed);
+        fflush(stdout);
+      }
+      readsProcessed++;
+      firstEnd = !firstEnd;
     }
-    readsProcessed++;
-    if(fastq) getline(solidReads, read), getline(solidReads, read); //if fastq skip two more lines
-    firstEnd = !firstEnd;
   }
-  printf("Empty count: %d, not empty count: %d\n", emptyCount, notEmptyCount);
+  printf("Empty count: %llu, not empty count: %llu\n", (unsigned long long)emptyCount, (unsigned long long)notEmptyCount);
 
-  solidReads.close();
   time(&stop);
-  printf("Reads processed: %lli\n", readsProcessed);
-  printf("Unambiguous reads: %lli\n", unambiguousReads);
+  printf("Reads processed: %llu\n", (unsigned long long)readsProcessed);
+  printf("Unambiguous reads: %llu\n", (unsigned long long)unambiguousReads);
   printf("Time in seconds for read scan: %f \n", difftime(stop,start));
 }
 
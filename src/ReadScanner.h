@@ -26,6 +26,7 @@ using std::ofstream;
 #include "../utils/ReadKmer.h"
 #include "../utils/Cap.h"
 #include "../utils/JuncPairs.h"
+#include "../utils/SeqReader.h"
 
 #define DEBUGE(a)  //printf a
 
@@ -46,15 +47,32 @@ private:
 
     uint64_t NbCandKmer, NbRawCandKmer, NbJCheckKmer, NbNoJuncs, 
         NbSkipped, NbProcessed, readsProcessed, NbSolidKmer,readsNoErrors,
-         NbJuncPairs, unambiguousReads;
+         NbJuncPairs, unambiguousReads, emptyCount, notEmptyCount;
 
     JChecker* jchecker;
     JunctionMap* junctionMap;
 
+    std::vector<ReadSpan> unambiguousPieces, validPieces; //reused by scanInputRead
+    std::vector<unsigned char> readKmersFound; //reused by getValidReads
+
     //Should only be called on a read with no real junctions
     //Adds a fake junction in the middle and points it to the two ends.  This ensures we have coverage of long linear regions, and that we capture
     //sinks at the end of such regions.
-    kmer_type add_fake_junction(string read);
+    kmer_type add_fake_junction(ReadSpan read);
+
+    //Junction and pair filter updates.  These use the thread-safe versions while the junction map is being
+    //scanned into from several threads.
+    void addCoverage(Junction* junc, int nucExt);
+    void updateJunction(Junction* junc, int nucExt, unsigned char length);
+    int getJunctionDist(Junction* junc, int nucExt);
+    void addPair(Bloom* filter, JuncPair pair);
+
+    //Links the back junctions of the two mates of a pair through the long pair filter
+    void pairMates(std::list<kmer_type>& backJuncs1, std::list<kmer_type>& backJuncs2, bool no_cleaning);
+
+    void resetCounters();
+    //Scans the reads on several threads, each with its own ReadScanner and JChecker, into a shared junction map
+    void scanReadsThreaded(bool fastq, bool paired_ends, bool no_cleaning, int threads);
     
 public:
     JunctionMap* getJunctionMap();
@@ -62,8 +80,13 @@ public:
     //Scans one input read; breaks into small segments and calls scan_forward
     //Returns back junctions along read from beginning to end
     std::list<kmer_type> scanInputRead(string read, bool no_cleaning);
+    std::list<kmer_type> scanInputRead(ReadSpan read, bool no_cleaning);
 
-    void scanReads(bool fastq, bool paired_ends, bool no_cleaning); //scans all the reads.  Fastq if fastq, otherwise fasta
+    //scans all the reads.  Fastq if fastq, otherwise fasta.  With threads > 1 reads are scanned on that many worker threads;
+    //the two mates of a pair are always scanned together, in order.  The junctions a read finds depend on the reads
+    //scanned before it (fake and spacer junctions, and the distances junctions let it skip), so the threaded scan can
+    //find a slightly different junction set, distances, links and pairs than the serial one.
+    void scanReads(bool fastq, bool paired_ends, bool no_cleaning, int threads = 1);
     void printScanSummary(); //prints statistics from the readscan
     
     //Determines if the given ReadKmer is a junction.
@@ -79,6 +102,8 @@ public:
 
     //Returns substrings of the read that are valid with BF and longer than sizeKmer
     std::list<string> getValidReads(string read);
+    //Same, but fills valid with spans of the read instead of copying them
+    void getValidReads(ReadSpan read, std::vector<ReadSpan>& valid);
 
     //Scans a read. 
     //Identifies all junctions on the read, and links adjacent junctions to each other.
@@ -87,6 +112,7 @@ public:
     //If there are no junctions, add_fake_junction is called
     //Returns back junctions along the read from beginning to end
     std::list<kmer_type> scan_forward(string read, bool no_cleaning); 
+    std::list<kmer_type> scan_forward(ReadSpan read, bool no_cleaning);
 
     ReadScanner(JunctionMap* juncMap, string readFile, Bloom* bloom, Bloom* short_pair_filter, Bloom* long_pair_filter, JChecker* jchecker, int maxSpacerDist);
 };
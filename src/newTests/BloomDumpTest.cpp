@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <random>
+#include <vector>
+#include "gtest/gtest.h"
+#include "../../utils/Bloom.h"
+
+
+class bloomDump : public ::testing::Test {
+
+protected:
+    std::vector<string> files;
+    std::mt19937_64 random;
+
+    // A new file name, removed at the end of the test
+    string tempFile(){
+        char name[] = "/tmp/faucetDumpXXXXXX";
+        close(mkstemp(name));
+        files.push_back(name);
+        return name;
+    }
+
+    std::vector<kmer_type> randomKmers(int count){
+        std::vector<kmer_type> kmers;
+        for(int i = 0; i < count; i++){
+            kmers.push_back(get_canon(random() & kmerMask));
+        }
+        return kmers;
+    }
+
+    Bloom* filledFilter(std::vector<kmer_type>& kmers, int layout, bool exactSize){
+        Bloom* bloom = Bloom::create_bloom_filter_optimal(kmers.size(), 0.01, layout, exactSize);
+        for(kmer_type kmer : kmers){
+            bloom->oldAdd(kmer);
+        }
+        return bloom;
+    }
+
+    // Writes the first bytes of the bit array of bloom, without a header, as older dumps were
+    string writeBare(Bloom* bloom, uint64_t bytes){
+        string name = tempFile();
+        FILE* out = fopen(name.c_str(), "wb");
+        fwrite(bloom->blooma, 1, bytes, out);
+        fclose(out);
+        return name;
+    }
+
+    // Dumps a filter of the given layout, then checks that open_dump maps the same filter back and that load reads it
+    // into a new filter made with the same settings
+    void checkRoundTrip(int layout, bool exactSize){
+        std::vector<kmer_type> kmers = randomKmers(5000);
+        Bloom* bloom = filledFilter(kmers, layout, exactSize);
+        string name = tempFile();
+        bloom->dump(&name[0]);
+
+        Bloom* mapped = Bloom::open_dump(name.c_str());
+        ASSERT_NE(mapped, nullptr);
+        EXPECT_EQ(mapped->getLayout(), layout);
+        EXPECT_EQ(mapped->isExactSize(), exactSize);
+        EXPECT_EQ(mapped->getNumHash(), bloom->getNumHash());
+        ASSERT_EQ(mapped->getBytes(), bloom->getBytes());
+        EXPECT_EQ(0, memcmp(mapped->blooma, bloom->blooma, bloom->getBytes()));
+        for(kmer_type kmer : kmers){
+            ASSERT_TRUE(mapped->oldContains(kmer));
+        }
+
+        Bloom* loaded = Bloom::create_bloom_filter_optimal(kmers.size(), 0.01, layout, exactSize);
+        loaded->load(&name[0]);
+        EXPECT_EQ(0, memcmp(loaded->blooma, bloom->blooma, bloom->getBytes()));
+
+        delete bloom;
+        delete mapped;
+        delete loaded;
+    }
+
+    bloomDump() : random(23) {
+        setSizeKmer(31);
+    }
+
+    ~bloomDump(){
+        for(string file : files){
+            unlink(file.c_str());
+        }
+    }
+};
+
+TEST_F(bloomDump, roundTripClassic) {
+    checkRoundTrip(BLOOM_CLASSIC, true);
+}
+
+TEST_F(bloomDump, roundTripPowerOfTwo) {
+    checkRoundTrip(BLOOM_CLASSIC, false);
+}
+
+TEST_F(bloomDump, roundTripBlocked) {
+    checkRoundTrip(BLOOM_BLOCKED, true);
+}
+
+// A dump is only loaded into a filter with the same settings
+TEST_F(bloomDump, headerMismatch) {
+    std::vector<kmer_type> kmers = randomKmers(5000);
+    Bloom* bloom = filledFilter(kmers, BLOOM_CLASSIC, true);
+    string name = tempFile();
+    bloom->dump(&name[0]);
+
+    Bloom* bigger = Bloom::create_bloom_filter_optimal(2*kmers.size(), 0.01);
+    ASSERT_EXIT(bigger->load(&name[0]), ::testing::ExitedWithCode(1), "does not match");
+    Bloom* blocked = Bloom::create_bloom_filter_optimal(kmers.size(), 0.01, BLOOM_BLOCKED);
+    ASSERT_EXIT(blocked->load(&name[0]), ::testing::ExitedWithCode(1), "does not match");
+    delete bloom;
+    delete bigger;
+    delete blocked;
+}
+
+// A dump without a header isn't mapped, and load reads it as a bare bit array
+TEST_F(bloomDump, headerless) {
+    std::vector<kmer_type> kmers = randomKmers(5000);
+    Bloom* bloom = filledFilter(kmers, BLOOM_CLASSIC, true);
+    string name = writeBare(bloom, bloom->getBytes());
+
+    EXPECT_EQ(Bloom::open_dump(name.c_str()), nullptr);
+    Bloom* loaded = Bloom::create_bloom_filter_optimal(kmers.size(), 0.01);
+    loaded->load(&name[0]);
+    EXPECT_EQ(0, memcmp(loaded->blooma, bloom->blooma, bloom->getBytes()));
+    for(kmer_type kmer : kmers){
+        ASSERT_TRUE(loaded->oldContains(kmer));
+    }
+    delete bloom;
+    delete loaded;
+}
+
+// A dump shorter than the filter it is loaded into is an error, not a partly loaded filter
+TEST_F(bloomDump, truncated) {
+    std::vector<kmer_type> kmers = randomKmers(5000);
+    Bloom* bloom = filledFilter(kmers, BLOOM_CLASSIC, true);
+    string name = writeBare(bloom, bloom->getBytes()/2);
+
+    Bloom* loaded = Bloom::create_bloom_filter_optimal(kmers.size(), 0.01);
+    ASSERT_EXIT(loaded->load(&name[0]), ::testing::ExitedWithCode(1), "truncated");
+    delete bloom;
+    delete loaded;
+}
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <random>
+#include <vector>
+#include "gtest/gtest.h"
+#include "../../utils/Bloom.h"
+
+
+class bloomFold : public ::testing::Test {
+
+protected:
+    std::mt19937_64 random;
+    std::vector<kmer_type> kmers;
+    std::vector<string> files;
+
+    // A filter sized for ten times the kmers it gets, so it has room to fold
+    Bloom* oversizedFilter(int layout, bool exactSize){
+        Bloom* bloom = Bloom::create_bloom_filter_optimal(10*kmers.size(), 0.01, layout, exactSize);
+        for(kmer_type kmer : kmers){
+            bloom->oldAdd(kmer);
+        }
+        return bloom;
+    }
+
+    void checkAllContained(Bloom* bloom){
+        for(kmer_type kmer : kmers){
+            ASSERT_TRUE(bloom->oldContains(kmer)) << "lost a kmer after " << bloom->getFolds() << " folds";
+        }
+    }
+
+    // Folds an oversized filter down to a target rate, then on down to the smallest size, checking at each step
+    // that no kmer was lost and that the filter halved
+    void checkFold(int layout, bool exactSize){
+        Bloom* bloom = oversizedFilter(layout, exactSize);
+        uint64_t bytes = bloom->getBytes();
+        int folds = bloom->autoFold(0.05);
+        EXPECT_GT(folds, 0);
+        EXPECT_EQ(bloom->getFolds(), folds);
+        EXPECT_EQ(bloom->getBytes(), bytes >> folds);
+        EXPECT_LE(bloom->estimatedFpRate(), 0.05);
+        checkAllContained(bloom);
+        while(bloom->fold()){
+            EXPECT_EQ(bloom->getBytes(), bytes >> bloom->getFolds());
+            checkAllContained(bloom);
+        }
+        EXPECT_GT(bloom->getFolds(), folds);
+        delete bloom;
+    }
+
+    bloomFold() : random(37) {
+        setSizeKmer(31);
+        Bloom::setFoldable(BLOOM_MAX_FOLDS);
+        for(int i = 0; i < 2000; i++){
+            kmers.push_back(get_canon(random() & kmerMask));
+        }
+    }
+
+    ~bloomFold(){
+        Bloom::setFoldable(0);
+        for(string file : files){
+            unlink(file.c_str());
+        }
+    }
+};
+
+TEST_F(bloomFold, classic) {
+    checkFold(BLOOM_CLASSIC, true);
+}
+
+TEST_F(bloomFold, blocked) {
+    checkFold(BLOOM_BLOCKED, true);
+}
+
+TEST_F(bloomFold, powerOfTwo) {
+    checkFold(BLOOM_CLASSIC, false);
+}
+
+// A folded dump is loaded into a filter created with the settings of the unfolded one, which folds to match it
+TEST_F(bloomFold, loadFoldedDump) {
+    for(int layout : {BLOOM_CLASSIC, BLOOM_BLOCKED}){
+        for(bool exactSize : {true, false}){
+            Bloom* folded = oversizedFilter(layout, exactSize);
+            ASSERT_GT(folded->autoFold(0.05), 0);
+            char name[] = "/tmp/faucetFoldXXXXXX";
+            close(mkstemp(name));
+            files.push_back(name);
+            folded->dump(name);
+
+            Bloom* target = Bloom::create_bloom_filter_optimal(10*kmers.size(), 0.01, layout, exactSize);
+            target->load(name);
+            EXPECT_EQ(target->getFolds(), folded->getFolds());
+            ASSERT_EQ(target->getBytes(), folded->getBytes());
+            EXPECT_EQ(0, memcmp(target->blooma, folded->blooma, folded->getBytes()));
+            checkAllContained(target);
+            delete folded;
+            delete target;
+        }
+    }
+}
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include <set>
+#include "gtest/gtest.h"
+#include "../../utils/Bloom.h"
+
+
+class bloomMerge : public ::testing::Test {
+
+protected:
+    std::vector<string> files;
+
+    // Writes reads to a new fasta file, removed at the end of the test
+    string writeReads(std::vector<string> reads){
+        char name[] = "/tmp/faucetMergeXXXXXX";
+        int fd = mkstemp(name);
+        FILE* out = fdopen(fd, "w");
+        for(size_t i = 0; i < reads.size(); i++){
+            fprintf(out, ">read%d\n%s\n", (int)i, reads[i].c_str());
+        }
+        fclose(out);
+        files.push_back(name);
+        return name;
+    }
+
+    // Reads of length 100 every 90 bases of genome between start and end, so a lane sees each of their kmers once
+    std::vector<string> tileReads(string genome, int start, int end){
+        std::vector<string> reads;
+        for(int i = start; i + 100 <= end; i += 90){
+            reads.push_back(genome.substr(i, 100));
+        }
+        return reads;
+    }
+
+    // The kmers of reads
+    std::set<string> readKmers(std::vector<string> reads){
+        std::set<string> kmers;
+        for(string read : reads){
+            for(int i = 0; i + sizeKmer <= (int)read.size(); i++){
+                kmers.insert(read.substr(i, sizeKmer));
+            }
+        }
+        return kmers;
+    }
+
+    // Loads reads into a new pair of filters sized in the given mode
+    void loadPair(string filename, bool exactSize, Bloom*& bloo1, Bloom*& bloo2){
+        bloo1 = bloo1->create_bloom_filter_optimal(20000, 0.01, BLOOM_CLASSIC, exactSize);
+        bloo2 = bloo2->create_bloom_filter_optimal(20000, 0.01, BLOOM_CLASSIC, exactSize);
+        load_two_filters(bloo1, bloo2, filename, false, false);
+    }
+
+    // Merges two lanes sized in the given mode and checks the merged bits against a load of both lanes together.  The
+    // kmers the lanes share are seen once in each, so they are only solid once merged.  The merge works bit by bit, so
+    // the solid filter may have some more bits set than the joint load, but never fewer.
+    void checkMerge(bool exactSize){
+        setSizeKmer(21);
+        srand(11);
+        string genome;
+        for(int i = 0; i < 6000; i++){
+            genome += getNucChar(rand() % 4);
+        }
+        std::vector<string> lane1 = tileReads(genome, 0, 4000);
+        std::vector<string> lane2 = tileReads(genome, 2000, 6000);
+        std::vector<string> both = lane1;
+        both.insert(both.end(), lane2.begin(), lane2.end());
+
+        Bloom *lane1Bloo1, *lane1Bloo2, *lane2Bloo1, *lane2Bloo2, *jointBloo1, *jointBloo2, *merged1, *merged2;
+        loadPair(writeReads(lane1), exactSize, lane1Bloo1, lane1Bloo2);
+        loadPair(writeReads(lane2), exactSize, lane2Bloo1, lane2Bloo2);
+        loadPair(writeReads(both), exactSize, jointBloo1, jointBloo2);
+        Bloom::merge_two_filters({lane1Bloo1, lane2Bloo1}, {lane1Bloo2, lane2Bloo2}, merged1, merged2, 2);
+
+        ASSERT_EQ(merged1->getBytes(), jointBloo1->getBytes());
+        ASSERT_EQ(merged2->getBytes(), jointBloo2->getBytes());
+        EXPECT_EQ(merged1->getBloomMask(), jointBloo1->getBloomMask());
+        EXPECT_EQ(0, memcmp(merged1->blooma, jointBloo1->blooma, merged1->getBytes()));
+        uint64_t missing = 0, extra = 0, solid = 0;
+        for(uint64_t i = 0; i < merged2->getBytes(); i++){
+            missing += __builtin_popcount(jointBloo2->blooma[i] & ~merged2->blooma[i]);
+            extra += __builtin_popcount(merged2->blooma[i] & ~jointBloo2->blooma[i]);
+            solid += __builtin_popcount(jointBloo2->blooma[i]);
+        }
+        EXPECT_EQ(missing, 0);
+        EXPECT_GT(solid, 0);
+        EXPECT_LT(extra*4, solid);
+        std::set<string> shared = readKmers(lane1);
+        std::set<string> lane2Kmers = readKmers(lane2);
+        int checked = 0;
+        for(string kmer : shared){
+            if(lane2Kmers.count(kmer)){
+                kmer_type forward;
+                getFirstKmerFromRead(&forward, &kmer[0]);
+                EXPECT_TRUE(merged2->oldContains(get_canon(forward))) << kmer;
+                checked++;
+            }
+        }
+        EXPECT_GT(checked, 0);
+
+        for(Bloom* bloom : {lane1Bloo1, lane1Bloo2, lane2Bloo1, lane2Bloo2, jointBloo1, jointBloo2, merged1, merged2}){
+            delete bloom;
+        }
+    }
+
+    ~bloomMerge(){
+        for(string file : files){
+            unlink(file.c_str());
+        }
+    }
+};
+
+// Lanes of exact size filters merge into the filters of a joint load
+TEST_F(bloomMerge, exactSize) {
+    checkMerge(true);
+}
+
+// Lanes of power of two filters keep their size when merged
+TEST_F(bloomMerge, powerOfTwo) {
+    checkMerge(false);
+}
@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+#include "gtest/gtest.h"
+#include "../../utils/Bloom.h"
+#include "../../utils/DoubleKmer.h"
+
+
+class exactSet : public ::testing::Test {
+
+protected:
+    std::mt19937_64 random;
+    std::vector<string> files;
+
+    string randomSequence(int length){
+        string seq;
+        for(int i = 0; i < length; i++){
+            seq += getNucChar(random() % 4);
+        }
+        return seq;
+    }
+
+    kmer_type canonAt(string& seq, int pos){
+        kmer_type kmer = 0;
+        getFirstKmerFromRead(&kmer, &seq[pos]);
+        return get_canon(kmer);
+    }
+
+    // Times kmer was counted by set, read through the threshold
+    int countOf(Bloom* set, kmer_type kmer){
+        int count = 0;
+        for(int threshold = 1; threshold <= BLOOM_MAX_COUNT; threshold++){
+            set->setThreshold(threshold);
+            count += set->oldContains(kmer) ? 1 : 0;
+        }
+        set->setThreshold(1);
+        return count;
+    }
+
+    // Writes reads to a new fasta file, removed at the end of the test
+    string writeReads(std::vector<string>& reads){
+        char name[] = "/tmp/faucetExactXXXXXX";
+        int fd = mkstemp(name);
+        FILE* out = fdopen(fd, "w");
+        for(size_t i = 0; i < reads.size(); i++){
+            fprintf(out, ">read%d\n%s\n", (int)i, reads[i].c_str());
+        }
+        fclose(out);
+        files.push_back(name);
+        return name;
+    }
+
+    exactSet() : random(31) {
+        setSizeKmer(31);
+    }
+
+    ~exactSet(){
+        for(string file : files){
+            unlink(file.c_str());
+        }
+    }
+};
+
+// Counts go up by one per add and saturate at BLOOM_MAX_COUNT, and a kmer is contained once counted threshold times
+TEST_F(exactSet, saturatingCount) {
+    Bloom* set = Bloom::create_exact_set(1000, 2);
+    std::vector<kmer_type> kmers;
+    for(int i = 0; i < 500; i++){
+        kmers.push_back(get_canon(random() & kmerMask));
+    }
+    for(int i = 0; i < (int)kmers.size(); i++){
+        for(int add = 0; add < i % 5; add++){
+            set->oldAdd(kmers[i]);
+        }
+    }
+    for(int i = 0; i < (int)kmers.size(); i++){
+        ASSERT_EQ(set->oldContains(kmers[i]) != 0, i % 5 >= 2);
+    }
+    for(int i = 0; i < (int)kmers.size(); i++){
+        ASSERT_EQ(countOf(set, kmers[i]), std::min(i % 5, BLOOM_MAX_COUNT));
+    }
+    delete set;
+}
+
+// The all-A kmer is canon 0, whose slot must not read as empty once it is added
+TEST_F(exactSet, allAKmer) {
+    Bloom* set = Bloom::create_exact_set(1000, 1);
+    string polyA(sizeKmer, 'A');
+    kmer_type zero = canonAt(polyA, 0);
+    ASSERT_EQ(zero, 0);
+    EXPECT_FALSE(set->oldContains(zero));
+    set->oldAdd(zero);
+    EXPECT_TRUE(set->oldContains(zero));
+    set->oldAdd(zero);
+    set->oldAdd(zero);
+    set->oldAdd(zero);
+    EXPECT_EQ(countOf(set, zero), BLOOM_MAX_COUNT);
+    string read = polyA + "C";
+    std::vector<unsigned char> found;
+    ASSERT_EQ(set->contains_read(ReadSpan{read.c_str(), (int)read.size()}, found), 2);
+    EXPECT_TRUE(found[0]);
+    EXPECT_FALSE(found[1]);
+    delete set;
+}
+
+// Filling the set past BLOOM_EXACT_MAX_LOAD of its slots exits rather than letting its probes grow without bound
+TEST_F(exactSet, full) {
+    Bloom* set = Bloom::create_exact_set(100, 1);
+    uint64_t slots = Bloom::exact_set_bytes(100)/sizeof(uint64_t);
+    ASSERT_EXIT({
+        for(uint64_t i = 1; i <= slots; i++){
+            set->oldAdd(get_canon(i*0x9E3779B97F4A7C15ULL & kmerMask));
+        }
+        exit(0);
+    }, ::testing::ExitedWithCode(1), "exact kmer set is full");
+    delete set;
+}
+
+// contains_read and extensionMask answer exactly from the kmers added, with no false positives
+TEST_F(exactSet, readsAndExtensions) {
+    Bloom* set = Bloom::create_exact_set(4000, 1);
+    string genome = randomSequence(2000);
+    std::set<kmer_type> kmers;
+    for(int i = 0; i + sizeKmer <= (int)genome.size(); i++){
+        kmers.insert(canonAt(genome, i));
+    }
+    set->add_read(ReadSpan{genome.c_str(), (int)genome.size()});
+
+    string read = genome.substr(500, 200);
+    for(int i = 10; i < (int)read.size(); i += 40){
+        read[i] = getNucChar((NT2int(read[i]) + 1) % 4);
+    }
+    std::vector<unsigned char> found;
+    int count = set->contains_read(ReadSpan{read.c_str(), (int)read.size()}, found);
+    ASSERT_EQ(count, (int)read.size() - sizeKmer + 1);
+    for(int i = 0; i < count; i++){
+        ASSERT_EQ(found[i] != 0, kmers.count(canonAt(read, i)) == 1) << i;
+    }
+
+    for(int i = 0; i + sizeKmer <= (int)read.size(); i++){
+        kmer_type kmer = 0;
+        getFirstKmerFromRead(&kmer, &read[i]);
+        for(bool dir : {FORWARD, BACKWARD}){
+            kmer_type base = (dir == FORWARD) ? kmer : revcomp(kmer);
+            int expected = 0;
+            for(int nt = 0; nt < 4; nt++){
+                expected |= (int)kmers.count(get_canon(((base << 2) & kmerMask) + nt)) << nt;
+            }
+            ASSERT_EQ(set->extensionMask(DoubleKmer(kmer), dir), expected) << i;
+        }
+    }
+    delete set;
+}
+
+// A load on four threads claims slots with compare and swap, and must count every kmer as a serial load does
+TEST_F(exactSet, threadedLoad) {
+    //about two reads over each kmer, so the counts range from 1 to saturated
+    string genome = randomSequence(400000);
+    std::vector<string> reads;
+    std::map<kmer_type, int> counts;
+    for(int i = 0; i < 30000; i++){
+        string read = genome.substr(random() % (genome.size() - 60), 60);
+        reads.push_back(read);
+        for(int j = 0; j + sizeKmer <= (int)read.size(); j++){
+            counts[canonAt(read, j)]++;
+        }
+    }
+    string file = writeReads(reads);
+
+    Bloom* serial = Bloom::create_exact_set(counts.size(), 1);
+    Bloom* threaded = Bloom::create_exact_set(counts.size(), 1);
+    load_counting_filter(serial, file, false, 1);
+    load_counting_filter(threaded, file, false, 4);
+    EXPECT_EQ(serial->weight(), threaded->weight());
+    for(auto& kv : counts){
+        ASSERT_EQ(countOf(threaded, kv.first), std::min(kv.second, BLOOM_MAX_COUNT));
+        ASSERT_EQ(countOf(serial, kv.first), std::min(kv.second, BLOOM_MAX_COUNT));
+    }
+    uint64_t used = 0;
+    for(uint64_t i = 0; i < threaded->getBytes()/sizeof(uint64_t); i++){
+        used += ((uint64_t*)threaded->blooma)[i] != 0;
+    }
+    EXPECT_EQ(used, counts.size());
+    delete serial;
+    delete threaded;
+}
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include <set>
+#include "gtest/gtest.h"
+#include "../../utils/Bloom.h"
+#include "../../utils/JChecker.h"
+
+
+class jcheckData : public ::testing::Test {
+
+protected:
+    Bloom* bloom;
+    JChecker* bfs;
+    JChecker* dfs;
+
+    // Build a kmer out of a string input
+    kmer_type getKmerFromString(string kmerString){
+        kmer_type kmer;
+        getFirstKmerFromRead(&kmer, &(kmerString[0]));
+        return kmer;
+    }
+
+    // A fake bloom filter holding exactly the given kmers
+    Bloom* createFakeBloom(std::vector<string> kmers){
+        Bloom* fakeBloom = fakeBloom->create_bloom_filter_optimal(100, 0.1);
+        fakeBloom->fakify();
+        std::set<kmer_type> valids;
+        for (string kmer : kmers) {
+            valids.insert(get_canon(getKmerFromString(kmer)));
+        }
+        fakeBloom->addFakeKmers(valids);
+        return fakeBloom;
+    }
+
+    // One checker of each engine on bloom
+    void createCheckers(int j){
+        bfs = new JChecker(j, bloom);
+        dfs = new JChecker(j, bloom);
+        dfs->setEngine(JCHECK_DFS);
+    }
+
+    // The kmers of a random genome, and random kmers that mostly aren't in it
+    void randomKmers(int genomeLength, int count, std::vector<kmer_type>& genomeKmers, std::vector<kmer_type>& queries){
+        string genome;
+        for(int i = 0; i < genomeLength; i++){
+            genome += getNucChar(rand() % 4);
+        }
+        for(int i = 0; i + sizeKmer <= genomeLength; i++){
+            genomeKmers.push_back(getKmerFromString(genome.substr(i, sizeKmer)));
+        }
+        for(int i = 0; i < count; i++){
+            queries.push_back(i % 2 ? genomeKmers[rand() % genomeKmers.size()] : ((((kmer_type)rand()) << 32) ^ rand()) & kmerMask);
+        }
+    }
+
+    jcheckData() {
+        bloom = nullptr;
+        bfs = nullptr;
+        dfs = nullptr;
+    }
+    ~jcheckData(){
+        delete bfs;
+        delete dfs;
+        delete bloom;
+    }
+};
+
+std::vector<string> validKmers = {"ACGGG","CGGGC","GGGCG","GGCGA","GCGAA","CGAAC","GAACT",
+    "AACTT","ACTTT","CTTTC","TTTCA","TTCAT","TCATA","CATAG","ATAGG","TAGGA", "AACTA","ACTAG",
+    "CTAGT", "TAGTC", "AGTCC","GTCCA", "TCCAT" ,"CATAC", "ATACG", "TACGA", "ACGAT", "CGATT"};
+
+// j = 1: an extension in the filter jchecks, a dead end doesn't
+TEST_F(jcheckData, depthFirstJ1) {
+    setSizeKmer(5);
+    bloom = createFakeBloom(validKmers);
+    createCheckers(1);
+
+    EXPECT_TRUE(dfs->jcheck(getKmerFromString("GTCCA")));
+    EXPECT_FALSE(dfs->jcheck(getKmerFromString("TCCAT")));
+    EXPECT_EQ(bfs->jcheck(getKmerFromString("GTCCA")), dfs->jcheck(getKmerFromString("GTCCA")));
+    EXPECT_EQ(bfs->jcheck(getKmerFromString("TCCAT")), dfs->jcheck(getKmerFromString("TCCAT")));
+}
+
+// j = 2: GAACT branches, and one of its branches goes on; ACGAT has one extension, which stops
+TEST_F(jcheckData, depthFirstJ2) {
+    setSizeKmer(5);
+    bloom = createFakeBloom(validKmers);
+    createCheckers(2);
+
+    EXPECT_TRUE(dfs->jcheck(getKmerFromString("GAACT")));
+    EXPECT_FALSE(dfs->jcheck(getKmerFromString("ACGAT")));
+}
+
+// j = 0 always passes
+TEST_F(jcheckData, depthFirstJ0) {
+    setSizeKmer(5);
+    bloom = createFakeBloom(validKmers);
+    createCheckers(0);
+
+    EXPECT_TRUE(dfs->jcheck(getKmerFromString("TCCAT")));
+}
+
+// The incremental version, on a filter of the old rolling hashes
+TEST_F(jcheckData, depthFirstIncremental) {
+    setSizeKmer(5);
+    bloom = bloom->create_bloom_filter_optimal(1000, 0.001, BLOOM_CLASSIC, false);
+    for (string kmer : validKmers) {
+        bloom->add(getKmerFromString(kmer));
+    }
+    for(int j = 1; j <= 3; j++){
+        JChecker bfsChecker(j, bloom), dfsChecker(j, bloom);
+        dfsChecker.setEngine(JCHECK_DFS);
+        for (string kmer : validKmers) {
+            uint64_t hash0 = bloom->get_rolling_hash(getKmerFromString(kmer), 0);
+            uint64_t hash1 = bloom->get_rolling_hash(getKmerFromString(kmer), 1);
+            EXPECT_EQ(bfsChecker.jcheck(&kmer[0], hash0, hash1), dfsChecker.jcheck(&kmer[0], hash0, hash1)) << kmer << " j " << j;
+        }
+    }
+}
+
+// Both engines agree for j = 1 to 8 on a real filter with false positives, and the time each takes is printed
+TEST_F(jcheckData, engineBenchmark) {
+    setSizeKmer(21);
+    srand(7);
+    std::vector<kmer_type> genomeKmers, queries;
+    randomKmers(200000, 100000, genomeKmers, queries);
+    bloom = bloom->create_bloom_filter_optimal(genomeKmers.size(), 0.05);
+    for (kmer_type kmer : genomeKmers) {
+        bloom->oldAdd(get_canon(kmer));
+    }
+
+    for(int j = 1; j <= 8; j++){
+        JChecker bfsChecker(j, bloom), dfsChecker(j, bloom);
+        dfsChecker.setEngine(JCHECK_DFS);
+        int bfsPassed = 0, dfsPassed = 0, disagree = 0;
+        clock_t start = clock();
+        std::vector<bool> bfsAnswers;
+        for (kmer_type kmer : queries) {
+            bool passed = bfsChecker.jcheck(kmer);
+            bfsAnswers.push_back(passed);
+            bfsPassed += passed;
+        }
+        double bfsTime = (double)(clock() - start)/CLOCKS_PER_SEC;
+        start = clock();
+        for (size_t i = 0; i < queries.size(); i++) {
+            bool passed = dfsChecker.jcheck(queries[i]);
+            dfsPassed += passed;
+            disagree += passed != bfsAnswers[i];
+        }
+        double dfsTime = (double)(clock() - start)/CLOCKS_PER_SEC;
+        printf("j %d: %d of %d kmers jcheck, bfs %.3f s, dfs %.3f s\n", j, dfsPassed, (int)queries.size(), bfsTime, dfsTime);
+        EXPECT_EQ(bfsPassed, dfsPassed);
+        EXPECT_EQ(disagree, 0);
+    }
+}
+
+// jcheckExtension gives the same answers with a cache as without one, on both strands of each kmer.  The small cache
+// has a single set, so most lookups follow an eviction; the large one keeps every kmer.
+TEST_F(jcheckData, cacheMatchesUncached) {
+    setSizeKmer(21);
+    srand(13);
+    std::vector<kmer_type> genomeKmers, queries;
+    randomKmers(20000, 2000, genomeKmers, queries);
+    bloom = bloom->create_bloom_filter_optimal(genomeKmers.size(), 0.05);
+    for (kmer_type kmer : genomeKmers) {
+        bloom->oldAdd(get_canon(kmer));
+    }
+    JChecker uncached(3, bloom);
+    for(uint64_t bytes : {(uint64_t)0, (uint64_t)1 << 24}){
+        JCheckCache cache(bytes);
+        JChecker cached(3, bloom);
+        cached.setCache(&cache);
+        //each extension is asked twice in a row, the second time from the cache, and again in the second round, from
+        //the cache unless it was evicted in between
+        for(int round = 0; round < 2; round++){
+            for (kmer_type query : queries) {
+                for(kmer_type kmer : {query, revcomp(query)}){
+                    for(int nt = 0; nt < 4; nt++){
+                        bool expected = uncached.jcheckExtension(kmer, nt);
+                        for(int repeat = 0; repeat < 2; repeat++){
+                            ASSERT_EQ(cached.jcheckExtension(kmer, nt), expected)
+                                << print_kmer(kmer) << " extension " << nt << ", cache of " << bytes << " bytes";
+                        }
+                    }
+                }
+            }
+        }
+        EXPECT_GT(cached.cacheHits, 0);
+        if(bytes == 0){
+            EXPECT_EQ(cache.getEntries(), JCHECK_CACHE_WAYS);
+        }
+        else{
+            EXPECT_GT(cached.cacheHits, cached.cacheMisses);
+        }
+    }
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <map>
+#include <thread>
 #include "gtest/gtest.h"
 #include "../ReadScanner.h"
 #include "../../utils/Bloom.h"
@@ -231,3 +232,50 @@ TEST_F(juncMapData, endJuncMap) {
 
 }
 
+// Creates and updates the same junctions from four threads at once through the sharded table, then checks that every
+// update landed once: coverage counts all the calls up to its saturation at 255, dist keeps the largest length and
+// each thread's link is set.  A junction created before the scan must carry over into the shards and back.
+TEST_F(juncMapData, concurrentUpdates) {
+    int threads = 4;
+    int juncs = 500;
+    junctionMap->createJunction(1000000);
+    junctionMap->getJunction(1000000)->addCoverage(2);
+
+    junctionMap->startConcurrentScan();
+    ASSERT_TRUE(junctionMap->isJunction(1000000));
+    std::vector<std::thread> pool;
+    for(int t = 0; t < threads; t++){
+        pool.push_back(std::thread([&, t](){
+            for(int rep = 0; rep < 100; rep++){
+                for(kmer_type kmer = 0; kmer < juncs; kmer++){
+                    junctionMap->createJunction(kmer);
+                    Junction* junc = junctionMap->getJunction(kmer);
+                    junc->addCoverageAtomic(0);
+                    if(rep < 50){
+                        junc->addCoverageAtomic(1);
+                    }
+                    junc->updateAtomic(4, rep + t);
+                    junc->linkAtomic(t);
+                }
+            }
+        }));
+    }
+    for(auto& thread : pool){
+        thread.join();
+    }
+    junctionMap->finishConcurrentScan();
+
+    ASSERT_EQ(junctionMap->getNumJunctions(), juncs + 1);
+    ASSERT_EQ(junctionMap->getJunction(1000000)->getCoverage(2), 1);
+    for(kmer_type kmer = 0; kmer < juncs; kmer++){
+        Junction* junc = junctionMap->getJunction(kmer);
+        ASSERT_NE(junc, nullptr);
+        ASSERT_EQ(junc->getCoverage(0), 255);
+        ASSERT_EQ(junc->getCoverage(1), 50*threads);
+        ASSERT_EQ(junc->dist[4], 99 + threads - 1);
+        for(int t = 0; t < threads; t++){
+            ASSERT_TRUE(junc->linked[t]);
+        }
+        ASSERT_FALSE(junc->linked[4]);
+    }
+}
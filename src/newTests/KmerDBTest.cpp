@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <random>
+#include <vector>
+#include "gtest/gtest.h"
+#include "../../utils/Bloom.h"
+#include "../../utils/KmerDB.h"
+
+
+class kmerDB : public ::testing::Test {
+
+protected:
+    std::mt19937_64 random;
+    std::vector<kmer_type> kmers;
+    std::vector<uint32_t> counts;
+    std::vector<string> files;
+
+    // A new file name, removed at the end of the test
+    string tempFile(){
+        char name[] = "/tmp/faucetKmerDBXXXXXX";
+        close(mkstemp(name));
+        files.push_back(name);
+        return name;
+    }
+
+    // Writes the kmers with their counts to a new database for k
+    string writeDB(int k){
+        string name = tempFile();
+        KmerDBWriter writer(name, k);
+        EXPECT_TRUE(writer.isOpen());
+        for(size_t i = 0; i < kmers.size(); i++){
+            writer.write(kmers[i], counts[i]);
+        }
+        EXPECT_EQ(writer.getCount(), kmers.size());
+        return name;
+    }
+
+    kmerDB() : random(41) {
+        setSizeKmer(25);
+        for(int i = 0; i < 5000; i++){
+            kmers.push_back(get_canon(random() & kmerMask));
+            //mostly low counts, like the errors in a real database, and a few large ones
+            counts.push_back(i % 10 == 0 ? 100000 + random() % 100000 : 1 + random() % 6);
+        }
+    }
+
+    ~kmerDB(){
+        for(string file : files){
+            unlink(file.c_str());
+        }
+    }
+};
+
+// Records read back in the order written, with their counts
+TEST_F(kmerDB, writeAndRead) {
+    string name = writeDB(sizeKmer);
+    KmerDB db(name);
+    EXPECT_EQ(db.getK(), sizeKmer);
+    ASSERT_EQ(db.size(), kmers.size());
+    for(uint64_t i = 0; i < db.size(); i++){
+        ASSERT_EQ(db.kmer(i), kmers[i]);
+        ASSERT_EQ(db.count(i), counts[i]);
+    }
+    for(uint32_t minCount : {1, 3, 7, 100000}){
+        uint64_t solid = 0;
+        for(uint32_t count : counts){
+            solid += count >= minCount;
+        }
+        EXPECT_EQ(db.countSolid(minCount), solid);
+    }
+}
+
+// A database cut short of the records its header announces is refused
+TEST_F(kmerDB, truncated) {
+    string name = writeDB(sizeKmer);
+    ASSERT_EQ(truncate(name.c_str(), KMER_DB_HEADER_SIZE + 100*((sizeKmer + 3)/4 + 4) + 3), 0);
+    ASSERT_EXIT(KmerDB db(name), ::testing::ExitedWithCode(1), "is truncated");
+}
+
+// A database for another k can't be loaded into a filter for this k
+TEST_F(kmerDB, wrongK) {
+    string name = writeDB(21);
+    Bloom* bloom = Bloom::create_bloom_filter_optimal(kmers.size(), 0.01);
+    ASSERT_EXIT(load_kmer_db(bloom, name, 2), ::testing::ExitedWithCode(1), "was built with k = 21");
+    delete bloom;
+}
+
+// load_kmer_db adds the kmers counted at least min_count times and no others, so its filter has the same bits as one
+// the solid kmers were added to directly, on one thread or several
+TEST_F(kmerDB, loadSolid) {
+    string name = writeDB(sizeKmer);
+    for(uint32_t minCount : {1, 3, 100000}){
+        Bloom* expected = Bloom::create_bloom_filter_optimal(kmers.size(), 0.01);
+        for(size_t i = 0; i < kmers.size(); i++){
+            if(counts[i] >= minCount){
+                expected->oldAdd(kmers[i]);
+            }
+        }
+        for(int threads : {1, 4}){
+            Bloom* bloom = Bloom::create_bloom_filter_optimal(kmers.size(), 0.01);
+            load_kmer_db(bloom, name, minCount, threads);
+            ASSERT_EQ(0, memcmp(bloom->blooma, expected->blooma, expected->getBytes()))
+                << "min count " << minCount << ", " << threads << " threads";
+            delete bloom;
+        }
+        delete expected;
+    }
+}
@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <map>
+#include <random>
+#include <unistd.h>
 #include "gtest/gtest.h"
 #include "../ReadScanner.h"
 #include "../../utils/Bloom.h"
@@ -280,6 +282,98 @@ TEST_F(readScan, smallDblJuncMap) {
     printJunctionMap(*scanner);
 }
 
+// Scans mate pairs on one thread and on four.  The junctions a scan finds can depend on read order: a read with no
+// junction gets a fake one, which later reads stop at, and spacer junctions are placed from the junctions already
+// found.  Here every read crosses a SNP and is shorter than twice the spacer distance, so both scans must find the
+// same junctions with the same coverage and set the same short pairs, and every pair of mates must be in the long
+// pair filter, which only holds if the threaded scan keeps the mates of a pair together and in order.
+TEST_F(readScan, threadedScanMatchesSerial) {
+    setSizeKmer(11);
+    std::mt19937 random(3);
+    string genome, variant;
+    for(int i = 0; i < 3000; i++){
+        genome += "ACGT"[random() % 4];
+    }
+    variant = genome;
+    for(int i = 5; i < genome.size(); i += 12){
+        variant[i] = "ACGT"[(string("ACGT").find(genome[i]) + 1 + random() % 3) % 4];
+    }
+    for(string hap : {genome, variant}){
+        for(int i = 0; i + sizeKmer <= hap.size(); i++){
+            kmers.push_back(hap.substr(i, sizeKmer));
+        }
+    }
+    addKmers(bloom, kmers);
+
+    int length = 30;
+    std::vector<std::pair<string, string> > mates;
+    char fileName[] = "/tmp/readScanXXXXXX";
+    int fd = mkstemp(fileName);
+    FILE* file = fdopen(fd, "w");
+    for(int i = 0; i < 12000; i++){
+        string hap = (random() % 2) ? genome : variant;
+        int offset = random() % (hap.size() - 2*length - 20);
+        string mate1 = hap.substr(offset, length);
+        string mate2 = hap.substr(offset + length + 20, length);
+        std::reverse(mate2.begin(), mate2.end());
+        for(char& c : mate2){
+            c = revcomp_char(c);
+        }
+        mates.push_back(std::make_pair(mate1, mate2));
+        fprintf(file, "@r%d/1\n%s\n+\n%s\n@r%d/2\n%s\n+\n%s\n", i, mate1.c_str(), string(length, 'I').c_str(),
+            i, mate2.c_str(), string(length, 'I').c_str());
+    }
+    fclose(file);
+
+    JunctionMap* maps[2];
+    Bloom* shortPairs[2];
+    Bloom* longPairs[2];
+    ReadScanner* scanners[2];
+    for(int i = 0; i < 2; i++){
+        maps[i] = new JunctionMap(bloom, jchecker, length);
+        shortPairs[i] = shortPairs[i]->create_bloom_filter_optimal(100000, .01);
+        longPairs[i] = longPairs[i]->create_bloom_filter_optimal(100000, .01);
+        scanners[i] = new ReadScanner(maps[i], fileName, bloom, shortPairs[i], longPairs[i], jchecker, length);
+        scanners[i]->scanReads(true, true, false, i == 0 ? 1 : 4);
+    }
+    unlink(fileName);
+
+    std::unordered_map<kmer_type, Junction>& serial = maps[0]->junctionMap;
+    std::unordered_map<kmer_type, Junction>& threaded = maps[1]->junctionMap;
+    ASSERT_GT(serial.size(), 0);
+    ASSERT_EQ(serial.size(), threaded.size());
+    for(auto& kv : serial){
+        ASSERT_EQ(threaded.count(kv.first), 1);
+        for(int i = 0; i < 5; i++){
+            ASSERT_EQ(kv.second.getCoverage(i), threaded[kv.first].getCoverage(i));
+        }
+    }
+    ASSERT_EQ(shortPairs[0]->getBytes(), shortPairs[1]->getBytes());
+    ASSERT_EQ(memcmp(shortPairs[0]->blooma, shortPairs[1]->blooma, shortPairs[0]->getBytes()), 0);
+
+    //the junctions of each mate, taken from the serial scanner without adding pairs
+    int unpaired = 0;
+    for(auto& pair : mates){
+        std::list<kmer_type> juncs1 = scanners[0]->scanInputRead(pair.first, true);
+        std::list<kmer_type> juncs2 = scanners[0]->scanInputRead(pair.second, true);
+        for(kmer_type junc1 : juncs1){
+            bool paired = false;
+            for(kmer_type junc2 : juncs2){
+                paired = paired || longPairs[1]->containsPair(JuncPair(junc1, junc2));
+            }
+            unpaired += !paired;
+        }
+    }
+    ASSERT_EQ(unpaired, 0);
+
+    for(int i = 0; i < 2; i++){
+        delete scanners[i];
+        delete maps[i];
+        delete shortPairs[i];
+        delete longPairs[i];
+    }
+}
+
 // add separate to JunctionMapTest
 // test building of map, then removal of complex junctions - closer to 
 // then
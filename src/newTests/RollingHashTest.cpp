@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <random>
+#include <vector>
+#include "gtest/gtest.h"
+#include "../../utils/Bloom.h"
+#include "../../utils/DoubleKmer.h"
+
+
+class rollingHash : public ::testing::Test {
+
+protected:
+    std::mt19937_64 random;
+    Bloom* bloom;
+
+    string randomSequence(int length){
+        string seq;
+        for(int i = 0; i < length; i++){
+            seq += getNucChar(random() % 4);
+        }
+        return seq;
+    }
+
+    kmer_type kmerAt(string& seq, int pos){
+        kmer_type kmer = 0;
+        getFirstKmerFromRead(&kmer, &seq[pos]);
+        return kmer;
+    }
+
+    // A filter in the rolling hash mode, with k set first since the filter keeps it
+    Bloom* rollingFilter(int k, int layout = BLOOM_CLASSIC){
+        setSizeKmer(k);
+        Bloom* filter = Bloom::create_bloom_filter_optimal(10000, 0.01, layout);
+        filter->setHashMode(BLOOM_HASH_ROLLING);
+        return filter;
+    }
+
+    // Rolls the state along a random sequence and checks it against the state computed from scratch at every kmer
+    void checkRoll(int k){
+        bloom = rollingFilter(k);
+        string seq = randomSequence(500);
+        RollingHash rolled = bloom->rollingState(kmerAt(seq, 0));
+        for(int i = 1; i + k <= (int)seq.size(); i++){
+            rolled = bloom->roll(rolled, NT2int(seq[i - 1]), NT2int(seq[i + k - 1]));
+            RollingHash calculated = bloom->rollingState(kmerAt(seq, i));
+            ASSERT_EQ(rolled.forward, calculated.forward) << "k " << k << " position " << i;
+            ASSERT_EQ(rolled.reverse, calculated.reverse) << "k " << k << " position " << i;
+        }
+        delete bloom;
+    }
+
+    // Checks the extension mask of kmers of a filter in the rolling mode, which rolls the state of the kmer to its four
+    // extensions, against the hashes of the extensions computed from scratch.  Half the extensions are added to the
+    // filter, so each answer is tested both ways.
+    void checkExtensionMask(int layout){
+        bloom = rollingFilter(31, layout);
+        std::vector<kmer_type> kmers;
+        for(int i = 0; i < 300; i++){
+            kmers.push_back(random() & kmerMask);
+        }
+        for(kmer_type kmer : kmers){
+            for(int nt = 0; nt < 4; nt += 2){
+                bloom->oldAdd(get_canon(((kmer << 2) & kmerMask) + nt));
+            }
+        }
+        for(kmer_type kmer : kmers){
+            for(bool dir : {FORWARD, BACKWARD}){
+                kmer_type base = (dir == FORWARD) ? kmer : revcomp(kmer);
+                int expected = 0;
+                for(int nt = 0; nt < 4; nt++){
+                    uint64_t hA, hB;
+                    bloom->hashKmer(get_canon(((base << 2) & kmerMask) + nt), hA, hB);
+                    expected |= bloom->contains(hA, hB) << nt;
+                }
+                int mask = bloom->extensionMask(DoubleKmer(kmer), dir);
+                ASSERT_EQ(mask, expected);
+                if(dir == FORWARD){
+                    ASSERT_EQ(mask & 5, 5);
+                }
+            }
+        }
+        delete bloom;
+    }
+
+    rollingHash() : random(29) {
+    }
+};
+
+TEST_F(rollingHash, rollMatchesScratch) {
+    checkRoll(27);
+    checkRoll(31);
+    checkRoll(5);
+}
+
+// The state of a kmer rolled base by base over a whole kmer length lands on the state of the next kmer
+TEST_F(rollingHash, canonicalRollCheckSame) {
+    bloom = rollingFilter(27);
+    string seq = "ACTTACTGGGCTCTATTGCGTATCGATCGATCGATGCATCTACCCCCATCTAATTAGAGTGAATAGATCGATCGATCGCATACTCAGCATAGCTATA";
+    RollingHash rolled = bloom->rollingState(kmerAt(seq, 0));
+    for(int i = 0; i < sizeKmer; i++){
+        rolled = bloom->roll(rolled, NT2int(seq[i]), NT2int(seq[i + sizeKmer]));
+    }
+    RollingHash calculated = bloom->rollingState(kmerAt(seq, sizeKmer));
+    EXPECT_EQ(rolled.forward, calculated.forward);
+    EXPECT_EQ(rolled.reverse, calculated.reverse);
+    delete bloom;
+}
+
+// Both strands of a kmer get the same filter hashes
+TEST_F(rollingHash, sameOnBothStrands) {
+    bloom = rollingFilter(31);
+    for(int i = 0; i < 1000; i++){
+        kmer_type kmer = random() & kmerMask;
+        uint64_t hash0, hash1, revHash0, revHash1;
+        bloom->rollingHashes(bloom->rollingState(kmer), hash0, hash1);
+        bloom->rollingHashes(bloom->rollingState(revcomp(kmer)), revHash0, revHash1);
+        ASSERT_EQ(hash0, revHash0);
+        ASSERT_EQ(hash1, revHash1);
+    }
+    delete bloom;
+}
+
+// hash_read rolls the hash along the read, and must give the hashes of each canonical kmer on its own
+TEST_F(rollingHash, hashReadMatchesKmerHashes) {
+    for(int layout : {BLOOM_CLASSIC, BLOOM_MINIMIZER}){
+        bloom = rollingFilter(31, layout);
+        string read = randomSequence(150);
+        std::vector<kmer_type> kmers;
+        getCanonKmers(ReadSpan{read.c_str(), (int)read.size()}, kmers);
+        std::vector<uint64_t> hashA(kmers.size()), hashB(kmers.size());
+        ASSERT_EQ(bloom->hash_read(ReadSpan{read.c_str(), (int)read.size()}, hashA.data(), hashB.data()), (int)kmers.size());
+        for(size_t i = 0; i < kmers.size(); i++){
+            uint64_t hA, hB;
+            bloom->hashKmer(kmers[i], hA, hB);
+            ASSERT_EQ(hashA[i], hA) << "layout " << layout << " kmer " << i;
+            ASSERT_EQ(hashB[i], hB) << "layout " << layout << " kmer " << i;
+        }
+        delete bloom;
+    }
+}
+
+TEST_F(rollingHash, extensionMaskClassic) {
+    checkExtensionMask(BLOOM_CLASSIC);
+}
+
+TEST_F(rollingHash, extensionMaskMinimizer) {
+    checkExtensionMask(BLOOM_MINIMIZER);
+}
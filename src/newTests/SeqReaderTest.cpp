@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <zlib.h>
+#include <bzlib.h>
+#include "gtest/gtest.h"
+#include "../../utils/SeqReader.h"
+
+
+class seqReader : public ::testing::Test {
+
+protected:
+    std::vector<string> files;
+
+    // Writes contents to a new file, removed at the end of the test
+    string writeFile(string contents){
+        char name[] = "/tmp/faucetSeqXXXXXX";
+        int fd = mkstemp(name);
+        EXPECT_EQ(write(fd, contents.data(), contents.size()), (ssize_t)contents.size());
+        close(fd);
+        files.push_back(name);
+        return name;
+    }
+
+    // Every sequence of a reader, read in batches of two records
+    std::vector<string> readAll(SeqReader& reader){
+        EXPECT_TRUE(reader.isOpen());
+        std::vector<string> reads;
+        SeqBatch batch;
+        while(reader.nextBatch(batch, 2) > 0){
+            for(ReadSpan read : batch.reads){
+                reads.push_back(string(read.seq, read.length));
+            }
+        }
+        return reads;
+    }
+
+    // Every sequence of contents, read from a mapped file
+    std::vector<string> readMapped(string contents, bool fastq){
+        SeqReader reader(writeFile(contents), fastq);
+        EXPECT_TRUE(reader.isMapped());
+        return readAll(reader);
+    }
+
+    // Every sequence of contents, read from a pipe, which falls back to buffered reads
+    std::vector<string> readPiped(string contents, bool fastq){
+        char name[] = "/tmp/faucetFifoXXXXXX";
+        close(mkstemp(name));
+        unlink(name);
+        EXPECT_EQ(mkfifo(name, 0600), 0);
+        files.push_back(name);
+        std::thread writer([&](){
+            int fd = open(name, O_WRONLY);
+            EXPECT_EQ(write(fd, contents.data(), contents.size()), (ssize_t)contents.size());
+            close(fd);
+        });
+        std::vector<string> reads;
+        {
+            SeqReader reader(name, fastq);
+            EXPECT_FALSE(reader.isMapped());
+            reads = readAll(reader);
+        }
+        writer.join();
+        return reads;
+    }
+
+    // Checks that contents reads as expected both mapped and piped
+    void checkReads(string contents, bool fastq, std::vector<string> expected){
+        EXPECT_EQ(readMapped(contents, fastq), expected);
+        EXPECT_EQ(readPiped(contents, fastq), expected);
+    }
+
+    // A fastq file of random reads with random qualities, of at least bytes bytes.  It compresses to a bit under half
+    // of that, so a few MB are enough for several parallel decompression jobs.
+    static const string& randomFastq(size_t bytes){
+        static string fastq;
+        if(fastq.size() < bytes){
+            fastq.clear();
+            srand(5);
+            for(int i = 0; fastq.size() < bytes; i++){
+                string seq, qual;
+                for(int j = 0; j < 100; j++){
+                    seq += "ACGT"[rand() % 4];
+                    qual += (char)('!' + rand() % 41);
+                }
+                fastq += "@read" + std::to_string(i) + "\n" + seq + "\n+\n" + qual + "\n";
+            }
+        }
+        return fastq;
+    }
+
+    // contents cut into pieces of pieceSize bytes, regardless of where the records end
+    std::vector<string> cut(const string& contents, size_t pieceSize){
+        std::vector<string> pieces;
+        for(size_t start = 0; start < contents.size(); start += pieceSize){
+            pieces.push_back(contents.substr(start, pieceSize));
+        }
+        return pieces;
+    }
+
+    // A bzip2 stream of piece
+    string bzip2Stream(const string& piece){
+        unsigned int length = piece.size() + piece.size()/100 + 600;
+        string stream(length, 0);
+        EXPECT_EQ(BZ2_bzBuffToBuffCompress(&stream[0], &length, (char*)piece.data(), piece.size(), 9, 0, 0), BZ_OK);
+        stream.resize(length);
+        return stream;
+    }
+
+    // A deflate stream of piece, raw for a BGZF block (windowBits -15) or with a gzip member around it (31)
+    string deflateStream(const string& piece, int windowBits){
+        z_stream z;
+        memset(&z, 0, sizeof(z));
+        EXPECT_EQ(deflateInit2(&z, 1, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY), Z_OK);
+        string stream(deflateBound(&z, piece.size()), 0);
+        z.next_in = (Bytef*)piece.data(), z.avail_in = piece.size();
+        z.next_out = (Bytef*)&stream[0], z.avail_out = stream.size();
+        EXPECT_EQ(deflate(&z, Z_FINISH), Z_STREAM_END);
+        stream.resize(z.total_out);
+        deflateEnd(&z);
+        return stream;
+    }
+
+    // A BGZF block of piece, at most 64 KB: a gzip member whose BC extra field gives the block size
+    string bgzfBlock(const string& piece){
+        string data = deflateStream(piece, -15);
+        size_t blockSize = 18 + data.size() + 8;
+        unsigned char header[18] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0,
+            (unsigned char)((blockSize - 1) & 0xff), (unsigned char)((blockSize - 1) >> 8)};
+        uint32_t crc = crc32(0, (const Bytef*)piece.data(), piece.size());
+        uint32_t size = piece.size();
+        string block((const char*)header, 18);
+        block += data;
+        for(int i = 0; i < 4; i++) block += (char)((crc >> 8*i) & 0xff);
+        for(int i = 0; i < 4; i++) block += (char)((size >> 8*i) & 0xff);
+        return block;
+    }
+
+    // Checks that the compressed file reads like the plain one, from a mapped file with threads and from a pipe
+    void checkDecompressed(string compressed, const string& plain, int compression){
+        SeqReader reader(writeFile(compressed), true, 4);
+        EXPECT_EQ(reader.getCompression(), compression);
+        std::vector<string> expected = readMapped(plain, true);
+        std::vector<string> reads = readAll(reader);
+        EXPECT_EQ(reads.size(), expected.size());
+        EXPECT_TRUE(reads == expected);
+        reads = readPiped(compressed, true);
+        EXPECT_EQ(reads.size(), expected.size());
+        EXPECT_TRUE(reads == expected);
+    }
+
+    // The masked sequences of a mapped file, which must be left as it was, and the number of bases masked
+    std::vector<string> readMasked(string contents, uint64_t& masked){
+        string name = writeFile(contents);
+        SeqReader reader(name, true);
+        EXPECT_TRUE(reader.isMapped());
+        std::vector<string> reads = readAll(reader);
+        masked = reader.getMaskedBases();
+        std::ifstream file(name);
+        std::stringstream after;
+        after << file.rdbuf();
+        EXPECT_EQ(after.str(), contents);
+        return reads;
+    }
+
+    ~seqReader(){
+        SeqReader::setQualityMask(0);
+        for(string file : files){
+            unlink(file.c_str());
+        }
+    }
+};
+
+// Fasta records on one line, and wrapped over several
+TEST_F(seqReader, wrappedFasta) {
+    checkReads(">r1\nACGT\n>r2\nACGT\nGGCC\nTA\n>r3\nTTTT\n", false, {"ACGT", "ACGTGGCCTA", "TTTT"});
+}
+
+// Fastq records whose sequence and qualities are wrapped
+TEST_F(seqReader, wrappedFastq) {
+    checkReads("@r1\nACGT\nGG\n+\nIIII\nII\n@r2\nAC\n+r2\nII\n@r3\nA\nC\nG\n+\nI\nII\n", true, {"ACGTGG", "AC", "ACG"});
+}
+
+// Quality lines starting with '@' or '+' are not taken for headers or separators
+TEST_F(seqReader, qualityMarkers) {
+    checkReads("@r1\nACGT\n+\n@III\n@r2\nGGGG\n+\n+I@I\n@r3\nTT\nAA\n+\n@@\n++\n", true, {"ACGT", "GGGG", "TTAA"});
+}
+
+// Windows line endings are dropped
+TEST_F(seqReader, crlf) {
+    checkReads(">r1\r\nACGT\r\nTT\r\n>r2\r\nGG\r\n", false, {"ACGTTT", "GG"});
+    checkReads("@r1\r\nACGT\r\n+\r\nIIII\r\n@r2\r\nGG\r\n+\r\nII\r\n", true, {"ACGT", "GG"});
+}
+
+// A fasta file may hold bare sequences, one per line, with blank lines skipped
+TEST_F(seqReader, bareSequences) {
+    checkReads("ACGT\nGGGG\n\nTTTT\nCA", false, {"ACGT", "GGGG", "TTTT", "CA"});
+}
+
+// Records without a sequence come back empty
+TEST_F(seqReader, emptyRecords) {
+    checkReads(">r1\n>r2\nACGT\n>r3\n", false, {"", "ACGT", ""});
+    checkReads("@r1\n\n+\n\n@r2\nAC\n+\nII\n", true, {"", "AC"});
+}
+
+// A file without a final newline, and blank lines between records
+TEST_F(seqReader, blankLines) {
+    checkReads(">r1\nACGT\n\n\n>r2\nGG", false, {"ACGT", "GG"});
+    checkReads("@r1\nACGT\n+\nIIII\n\n@r2\nGG\n+\nII", true, {"ACGT", "GG"});
+}
+
+// Concatenated bzip2 streams are split between parallel jobs at stream starts, and a pipe follows one stream to the next
+TEST_F(seqReader, multiStreamBzip2) {
+    const string& plain = randomFastq(12 << 20);
+    string compressed;
+    for(string piece : cut(plain, 1 << 20)){
+        compressed += bzip2Stream(piece);
+    }
+    checkDecompressed(compressed, plain, COMPRESSION_BZIP2);
+}
+
+// A match for a stream start the previous job doesn't end at sends the reader back to one thread from where that job
+// ended.  Here a stream ends in padding, which ends the input for bzip2, so the stream after it is dropped however
+// many threads decompress the file.
+TEST_F(seqReader, bzip2SplitFallback) {
+    const string& plain = randomFastq(12 << 20);
+    string compressed = bzip2Stream(plain) + string(4, 0) + bzip2Stream("@extra\nACGT\n+\nIIII\n");
+    checkDecompressed(compressed, plain, COMPRESSION_BZIP2);
+}
+
+// BGZF blocks are split between parallel jobs by the sizes in their headers, and end with an empty block
+TEST_F(seqReader, bgzf) {
+    const string& plain = randomFastq(12 << 20);
+    string compressed;
+    for(string piece : cut(plain, 65280)){
+        compressed += bgzfBlock(piece);
+    }
+    compressed += bgzfBlock("");
+    checkDecompressed(compressed, plain, COMPRESSION_GZIP);
+}
+
+// Plain gzip members are decompressed one after the other on a single thread
+TEST_F(seqReader, multiMemberGzip) {
+    const string& plain = randomFastq(4 << 20);
+    string compressed;
+    for(string piece : cut(plain, 1 << 20)){
+        compressed += deflateStream(piece, 31);
+    }
+    checkDecompressed(compressed, plain, COMPRESSION_GZIP);
+}
+
+// Bases with a quality below -min_qual become N.  Masked records on one line are copied out of the mapped file, which
+// must not be written to, and records around them that need no mask are read as they are.
+TEST_F(seqReader, maskSingleLine) {
+    SeqReader::setQualityMask(20);
+    string contents = "@r1\nACGTACGT\n+\nIII#III#\n@r2\nACGTACGT\n+\nIIIIIIII\n"
+        "@r3\nACGTACGT\n+\n5555####\n@r4\nTTTT\n+\n+III\n@r5\nGGGG\n+\nIIII\n";
+    std::vector<string> expected = {"ACGNACGN", "ACGTACGT", "ACGTNNNN", "NTTT", "GGGG"};
+    uint64_t masked;
+    EXPECT_EQ(readMasked(contents, masked), expected);
+    EXPECT_EQ(masked, 2 + 4 + 1);
+    EXPECT_EQ(readPiped(contents, true), expected);
+}
+
+// The qualities of a wrapped record are matched to its bases across the line breaks
+TEST_F(seqReader, maskWrapped) {
+    SeqReader::setQualityMask(20);
+    string contents = "@r1\nACGT\nACGT\n+\nII#I\nIII#\n@r2\nAC\nGT\nAC\n+\nI#II\n#I\n";
+    std::vector<string> expected = {"ACNTACGN", "ANGTNC"};
+    uint64_t masked;
+    EXPECT_EQ(readMasked(contents, masked), expected);
+    EXPECT_EQ(masked, 4);
+    EXPECT_EQ(readPiped(contents, true), expected);
+}
+
+// With -qual_offset 64 the same Phred threshold falls on other characters
+TEST_F(seqReader, maskOffset64) {
+    SeqReader::setQualityMask(20, 64);
+    //at offset 64 'h' is Phred 40 and 'T' Phred 20, which are kept, but 'J' is Phred 10 and 'I' Phred 9
+    string contents = "@r1\nACGTACGT\n+\nhhJhTTIh\n";
+    std::vector<string> expected = {"ACNTACNT"};
+    uint64_t masked;
+    EXPECT_EQ(readMasked(contents, masked), expected);
+    EXPECT_EQ(masked, 2);
+}
+
+// Without a mask nothing is counted, and low qualities are left alone
+TEST_F(seqReader, noMask) {
+    string contents = "@r1\nACGTACGT\n+\n########\n";
+    uint64_t masked;
+    EXPECT_EQ(readMasked(contents, masked), std::vector<string>({"ACGTACGT"}));
+    EXPECT_EQ(masked, 0);
+}
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "gtest/gtest.h"
+#include "../../utils/Bloom.h"
+#include "../../utils/XorFilter.h"
+
+
+class xorFilter : public ::testing::Test {
+
+protected:
+    std::mt19937_64 random;
+
+    xorFilter() : random(17) {}
+
+    // count distinct random keys
+    std::vector<uint64_t> randomKeys(int count){
+        std::vector<uint64_t> keys;
+        while((int)keys.size() < count){
+            for(int i = keys.size(); i < count; i++){
+                keys.push_back(random());
+            }
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        }
+        return keys;
+    }
+
+    // Share of count random keys that aren't in sorted keys but that filter contains
+    double falsePositiveRate(const XorFilter& filter, const std::vector<uint64_t>& keys, int count){
+        int tried = 0, positives = 0;
+        while(tried < count){
+            uint64_t key = random();
+            if(std::binary_search(keys.begin(), keys.end(), key)) continue;
+            tried++;
+            positives += filter.contains(key);
+        }
+        return (double)positives/tried;
+    }
+
+    // A random pair of kmers
+    JuncPair randomPair(){
+        return JuncPair(random() & kmerMask, random() & kmerMask);
+    }
+};
+
+// Every key the filter is built from is contained, and other keys are at the designed rate of 1/256
+TEST_F(xorFilter, falsePositiveRate) {
+    std::vector<uint64_t> keys = randomKeys(200000);
+    XorFilter filter(keys);
+    for(uint64_t key : keys){
+        ASSERT_TRUE(filter.contains(key));
+    }
+    double rate = falsePositiveRate(filter, keys, 1000000);
+    printf("False positive rate %f at %.2f bits per key\n", rate, filter.bitsPerKey());
+    EXPECT_GT(rate, 0.8/256);
+    EXPECT_LT(rate, 1.2/256);
+    EXPECT_LT(filter.bitsPerKey(), 10);
+}
+
+// Tiny key sets, which get the smallest arrays
+TEST_F(xorFilter, smallSets) {
+    for(int count : {0, 1, 2, 10, 100, 1000}){
+        std::vector<uint64_t> keys = randomKeys(count);
+        XorFilter filter(keys);
+        EXPECT_EQ(filter.getKeyCount(), (uint64_t)count);
+        for(uint64_t key : keys){
+            EXPECT_TRUE(filter.contains(key)) << count << " keys";
+        }
+    }
+}
+
+// A filter over the fingerprints of another one, as for a mapped dump, answers the same
+TEST_F(xorFilter, sharedFingerprints) {
+    std::vector<uint64_t> keys = randomKeys(50000);
+    XorFilter filter(keys);
+    XorFilter shared(filter.getFingerprints(), filter.getSeed(), filter.getSegmentLength(), filter.getSegmentCount(), filter.getKeyCount());
+    for(uint64_t key : keys){
+        EXPECT_TRUE(shared.contains(key));
+    }
+    for(int i = 0; i < 100000; i++){
+        uint64_t key = random();
+        EXPECT_EQ(filter.contains(key), shared.contains(key));
+    }
+}
+
+// A frozen pair filter contains every pair its bloom filter held, either way round, with fewer false positives
+TEST_F(xorFilter, frozenPairs) {
+    setSizeKmer(21);
+    Bloom* pairs = Bloom::create_bloom_filter_optimal(20000, 0.01);
+    pairs->collectPairs();
+    std::vector<JuncPair> added;
+    for(int i = 0; i < 20000; i++){
+        added.push_back(randomPair());
+        pairs->addPair(added.back());
+    }
+    for(int i = 0; i < 1000; i++){
+        pairs->addPair(added[i]); //pairs are seen more than once
+    }
+    std::vector<JuncPair> others;
+    int bloomPositives = 0;
+    for(int i = 0; i < 200000; i++){
+        others.push_back(randomPair());
+        bloomPositives += pairs->containsPair(others.back());
+    }
+    for(JuncPair pair : added){
+        ASSERT_TRUE(pairs->containsPair(pair));
+    }
+
+    pairs->freezePairs();
+    EXPECT_TRUE(pairs->isFrozen());
+    for(JuncPair pair : added){
+        EXPECT_TRUE(pairs->containsPair(pair));
+        EXPECT_TRUE(pairs->containsPair(JuncPair(pair.kmer2, pair.kmer1)));
+        EXPECT_TRUE(pairs->containsPair(JuncPair(revcomp(pair.kmer1), revcomp(pair.kmer2))));
+    }
+    int frozenPositives = 0;
+    for(JuncPair pair : others){
+        frozenPositives += pairs->containsPair(pair);
+    }
+    printf("False positives: %d bloom, %d frozen of %d pairs\n", bloomPositives, frozenPositives, (int)others.size());
+    //the bloom filter was made for 1% false positives, the frozen one has 1/256
+    EXPECT_LT(frozenPositives, 1.5*others.size()/256);
+    EXPECT_LT(frozenPositives, bloomPositives);
+    delete pairs;
+}
+
+// A frozen pair filter is dumped with its segments and mapped back by open_dump with every pair still contained
+TEST_F(xorFilter, frozenPairsDump) {
+    setSizeKmer(21);
+    Bloom* pairs = Bloom::create_bloom_filter_optimal(5000, 0.01);
+    pairs->collectPairs();
+    std::vector<JuncPair> added;
+    for(int i = 0; i < 5000; i++){
+        added.push_back(randomPair());
+        pairs->addPair(added.back());
+    }
+    pairs->freezePairs();
+    char name[] = "/tmp/faucetXorXXXXXX";
+    close(mkstemp(name));
+    pairs->dump(name);
+
+    Bloom* mapped = Bloom::open_dump(name);
+    ASSERT_NE(mapped, nullptr);
+    EXPECT_TRUE(mapped->isFrozen());
+    for(JuncPair pair : added){
+        ASSERT_TRUE(mapped->containsPair(pair));
+        ASSERT_TRUE(mapped->containsPair(JuncPair(pair.kmer2, pair.kmer1)));
+    }
+    int agree = 0;
+    for(int i = 0; i < 20000; i++){
+        JuncPair pair = randomPair();
+        agree += mapped->containsPair(pair) == pairs->containsPair(pair);
+    }
+    EXPECT_EQ(agree, 20000);
+    unlink(name);
+    delete pairs;
+    delete mapped;
+}
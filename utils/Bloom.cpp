@@ -12,9 +12,25 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include "Bloom.h"
+#include "SeqReader.h"
+#include "ReadSpool.h"
+#include "XorFilter.h"
+#include "KmerDB.h"
 #include <set>
 #include <list>
+#include <unordered_map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 using std::ifstream;
 using std::string;
 
@@ -124,6 +140,80 @@ double brents_fun(std::function<double (double)> f, double lower, double upper,
 } // end brents_fun
 
 
+//Pair keys recorded for freezePairs, sharded by key so threads adding pairs rarely wait on each other.  A shard is
+//sorted and deduplicated whenever it doubles, since most pairs are added many times.
+struct PairKeys{
+    std::vector<uint64_t> keys[PAIR_KEY_SHARDS];
+    size_t compacted[PAIR_KEY_SHARDS] = {0};
+    std::mutex locks[PAIR_KEY_SHARDS];
+
+    void add(uint64_t key){
+        int shard = key % PAIR_KEY_SHARDS;
+        std::lock_guard<std::mutex> guard(locks[shard]);
+        std::vector<uint64_t>& shardKeys = keys[shard];
+        shardKeys.push_back(key);
+        if(shardKeys.size() >= 2*compacted[shard] + 4096){
+            compact(shard);
+        }
+    }
+
+    void compact(int shard){
+        std::vector<uint64_t>& shardKeys = keys[shard];
+        std::sort(shardKeys.begin(), shardKeys.end());
+        shardKeys.erase(std::unique(shardKeys.begin(), shardKeys.end()), shardKeys.end());
+        compacted[shard] = shardKeys.size();
+    }
+};
+
+uint64_t Bloom::pairKey(JuncPair pair){
+    uint64_t elem1 = get_canon(pair.kmer1);
+    uint64_t elem2 = get_canon(pair.kmer2);
+    return finalize(finalize(std::min(elem1, elem2)) ^ std::max(elem1, elem2));
+}
+
+void Bloom::collectPairs(){
+    if(!pairKeys){
+        pairKeys = new PairKeys();
+    }
+}
+
+bool Bloom::isFrozen(){
+    return frozenPairs != NULL;
+}
+
+void Bloom::freezePairs(){
+    if(!pairKeys){
+        fprintf(stderr, "freezePairs called on a filter that wasn't collecting pairs\n");
+        exit(1);
+    }
+    //shards hold disjoint keys, so once each is deduplicated they can just be joined
+    std::vector<uint64_t> keys;
+    for(int shard = 0; shard < PAIR_KEY_SHARDS; shard++){
+        pairKeys->compact(shard);
+        keys.insert(keys.end(), pairKeys->keys[shard].begin(), pairKeys->keys[shard].end());
+        std::vector<uint64_t>().swap(pairKeys->keys[shard]);
+    }
+    delete pairKeys;
+    pairKeys = NULL;
+
+    uint64_t bloomBytes = nchar;
+    XorFilter* frozen = new XorFilter(keys);
+    for(int i = 0; i < subFilterCount; i++){
+        bloomBytes += subFilters[i]->nchar;
+        delete subFilters[i];
+    }
+    subFilterCount = 0;
+    scalable = false;
+    releaseBits();
+    frozenPairs = frozen;
+    layout = BLOOM_FROZEN_PAIRS;
+    blooma = (unsigned char*)frozen->getFingerprints();
+    nchar = frozen->getArrayLength();
+    tai = nchar*8;
+    printf("Froze %llu pairs: %.2f bits per pair, %.2f MB instead of %.2f MB\n", (unsigned long long)keys.size(),
+        frozen->bitsPerKey(), nchar/(1024.0*1024.0), bloomBytes/(1024.0*1024.0));
+}
+
 void Bloom::addPair(JuncPair pair){
     bloom_elem elem1 = get_canon(pair.kmer1);
     bloom_elem elem2 = get_canon(pair.kmer2);
@@ -136,9 +226,24 @@ void Bloom::addPair(JuncPair pair){
 
     //printf("Adding %lli, %lli\n", hA, hB);
     add(hA, hB);
+    if(pairKeys){
+        pairKeys->add(pairKey(pair));
+    }
+}
+
+void Bloom::atomic_addPair(JuncPair pair){
+    bloom_elem elem1 = get_canon(pair.kmer1);
+    bloom_elem elem2 = get_canon(pair.kmer2);
+    atomic_add(oldHash(std::min(elem1,elem2), 0), oldHash(std::max(elem1,elem2), 1));
+    if(pairKeys){
+        pairKeys->add(pairKey(pair));
+    }
 }
 
 int Bloom::containsPair(JuncPair pair){
+    if(frozenPairs){
+        return frozenPairs->contains(pairKey(pair));
+    }
     bloom_elem elem1 = get_canon(pair.kmer1);
     bloom_elem elem2 = get_canon(pair.kmer2);
     uint64_t hA,hB;
@@ -153,6 +258,214 @@ int Bloom::containsPair(JuncPair pair){
     return contains(hA, hB);
 }
 
+void Bloom::makeScalable(){
+    if(layout == BLOOM_COUNTING || !exactSize || capacity == 0){
+        fprintf(stderr, "Only exact size bloom filters made with their expected number of items can be scalable\n");
+        exit(1);
+    }
+    scalable = true;
+}
+
+int Bloom::getSubFilterCount(){
+    return __atomic_load_n(&subFilterCount, __ATOMIC_ACQUIRE);
+}
+
+//A key already in some sub-filter is not added again, so itemsAdded counts distinct keys, up to false positives.
+//New keys go to the newest sub-filter, and the one that fills it to capacity adds the next.
+int Bloom::scalableAdd(uint64_t h0, uint64_t h1, bool atomic){
+    int count = __atomic_load_n(&subFilterCount, __ATOMIC_ACQUIRE);
+    if(containsBits(h0, h1)){
+        return 1;
+    }
+    for(int i = 0; i < count; i++){
+        if(subFilters[i]->containsBits(h0, h1)){
+            return 1;
+        }
+    }
+    Bloom* newest = count ? subFilters[count - 1] : this;
+    if(atomic){
+        if(newest->atomicAddBits(h0, h1)){
+            return 1;
+        }
+    }
+    else{
+        newest->addBits(h0, h1);
+    }
+    if(__atomic_add_fetch(&newest->itemsAdded, 1, __ATOMIC_RELAXED) == newest->capacity){
+        grow(count);
+    }
+    return 0;
+}
+
+int Bloom::scalableContains(uint64_t h0, uint64_t h1){
+    if(containsBits(h0, h1)){
+        return 1;
+    }
+    int count = __atomic_load_n(&subFilterCount, __ATOMIC_ACQUIRE);
+    for(int i = 0; i < count; i++){
+        if(subFilters[i]->containsBits(h0, h1)){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//The sub-filter keeps the hash functions of the first, and gets the bits that bring it to its false positive rate
+//once it holds its items: (1 - e^(-kn/m))^k = rate for k probes of n items in m bits.
+void Bloom::grow(int seen){
+    static std::mutex growLock;
+    std::lock_guard<std::mutex> guard(growLock);
+    if(subFilterCount != seen){
+        return;
+    }
+    if(seen == BLOOM_MAX_SUBFILTERS){
+        printf("Bloom filter has %d sub-filters and can't grow any more, the last one will fill up\n", seen + 1);
+        return;
+    }
+    Bloom* newest = seen ? subFilters[seen - 1] : this;
+    uint64_t items = newest->capacity * BLOOM_SCALABLE_GROWTH;
+    float rate = newest->designFpRate * BLOOM_SCALABLE_TIGHTENING;
+    double bits = -(double)n_hash_func * items / log(1 - pow(rate, 1.0/n_hash_func));
+    Bloom* sub = new Bloom((uint64_t)bits, k, layout, exactSize);
+    sub->set_number_of_hash_func(n_hash_func);
+    sub->setMinimizerSize(minimizerSize);
+    sub->capacity = items;
+    sub->designFpRate = rate;
+    subFilters[seen] = sub;
+    __atomic_store_n(&subFilterCount, seen + 1, __ATOMIC_RELEASE);
+    printf("\nBloom filter full at %llu items, added sub-filter %d for %llu more items: %.2f MB, false positive rate %f\n",
+        (unsigned long long)newest->capacity, seen + 1, (unsigned long long)items, sub->nchar/(1024.0*1024.0), rate);
+}
+
+bool Bloom::canFold(){
+    if(fake || (layout != BLOOM_CLASSIC && layout != BLOOM_BLOCKED) || mappedFile || subFilterCount){
+        return false;
+    }
+    if(!exactSize){
+        return tai >= 2*BLOOM_BLOCK_BITS;
+    }
+    if(layout == BLOOM_BLOCKED){
+        return blockCount >= 2 && blockCount % 2 == 0;
+    }
+    return tai >= 2*BLOOM_BLOCK_BITS && tai % 16 == 0; //whole bytes after the fold
+}
+
+int Bloom::getFolds(){
+    return folds;
+}
+
+int Bloom::foldableFolds = 0;
+
+void Bloom::setFoldable(int folds){
+    foldableFolds = folds;
+}
+
+double Bloom::estimate_fp_rate(const unsigned char* bits, uint64_t bytes){
+    if(layout == BLOOM_BLOCKED || layout == BLOOM_MINIMIZER){
+        double rate = 0;
+        for(uint64_t block = 0; block < bytes / BLOOM_BLOCK_BYTES; block++){
+            int ones = 0;
+            for(int i = 0; i < BLOOM_BLOCK_BYTES; i += 8){
+                uint64_t word;
+                memcpy(&word, bits + block*BLOOM_BLOCK_BYTES + i, 8);
+                ones += __builtin_popcountll(word);
+            }
+            rate += pow((double)ones / BLOOM_BLOCK_BITS, n_hash_func);
+        }
+        return rate / (bytes / BLOOM_BLOCK_BYTES);
+    }
+    uint64_t ones = 0;
+    uint64_t i = 0;
+    for(; i + 8 <= bytes; i += 8){
+        uint64_t word;
+        memcpy(&word, bits + i, 8);
+        ones += __builtin_popcountll(word);
+    }
+    for(; i < bytes; i++){
+        ones += __builtin_popcount(bits[i]);
+    }
+    return pow((double)ones / (8*bytes), n_hash_func);
+}
+
+double Bloom::estimatedFpRate(){
+    double rate = estimate_fp_rate(blooma, nchar);
+    for(int i = 0; i < subFilterCount; i++){
+        rate += subFilters[i]->estimatedFpRate();
+    }
+    return std::min(rate, 1.0);
+}
+
+//Bit p of an exact size classic filter folds onto bit p/2: each pair of bits of a byte becomes one bit, and the bits
+//of two bytes make one byte
+static inline unsigned char fold_byte_pair(unsigned char low, unsigned char high){
+    uint32_t x = low | ((uint32_t)high << 8);
+    x = (x | (x >> 1)) & 0x5555;
+    x = (x | (x >> 1)) & 0x3333;
+    x = (x | (x >> 2)) & 0x0F0F;
+    x = (x | (x >> 4)) & 0x00FF;
+    return (unsigned char)x;
+}
+
+static void release_bits(unsigned char* bits, unsigned char* map, uint64_t mapLength){
+    if(map){
+        munmap(map, mapLength);
+    }
+    else{
+        free(bits);
+    }
+}
+
+bool Bloom::fold(double maxFpRate){
+    if(!canFold()){
+        return false;
+    }
+    uint64_t half = nchar/2;
+    unsigned char* oldBits = blooma;
+    unsigned char* oldMap = allocatedMap;
+    uint64_t oldMapLength = allocatedLength;
+    allocatedMap = NULL;
+    unsigned char* bits = allocate(half);
+    if(!exactSize){
+        for(uint64_t i = 0; i < half; i++){
+            bits[i] = oldBits[i] | oldBits[i + half];
+        }
+    }
+    else if(layout == BLOOM_BLOCKED){
+        for(uint64_t block = 0; block < blockCount/2; block++){
+            const unsigned char* pair = oldBits + 2*block*BLOOM_BLOCK_BYTES;
+            for(int i = 0; i < BLOOM_BLOCK_BYTES; i++){
+                bits[block*BLOOM_BLOCK_BYTES + i] = pair[i] | pair[i + BLOOM_BLOCK_BYTES];
+            }
+        }
+    }
+    else{
+        for(uint64_t i = 0; i < half; i++){
+            bits[i] = fold_byte_pair(oldBits[2*i], oldBits[2*i + 1]);
+        }
+    }
+    if(estimate_fp_rate(bits, half) > maxFpRate){
+        release_bits(bits, allocatedMap, allocatedLength);
+        allocatedMap = oldMap;
+        allocatedLength = oldMapLength;
+        return false;
+    }
+    release_bits(oldBits, oldMap, oldMapLength);
+    blooma = bits;
+    tai /= 2;
+    nchar = half;
+    blockCount = tai/BLOOM_BLOCK_BITS;
+    folds++;
+    return true;
+}
+
+int Bloom::autoFold(double targetFpRate){
+    int count = 0;
+    while(fold(targetFpRate)){
+        count++;
+    }
+    return count;
+}
+
 void Bloom::fakify(){
     fake = true;
 }
@@ -162,48 +475,198 @@ void Bloom::addFakeKmers(std::set<bloom_elem> valid_kmers) {
 }
 
 
- Bloom::Bloom(uint64_t tai_bloom, int kVal)
+ Bloom::Bloom(uint64_t tai_bloom, int kVal, int layoutVal, bool exactSizeVal)
  {
     fake = false;
+    layout = layoutVal;
+    exactSize = exactSizeVal;
+    threshold = 1;
+    hashMode = BLOOM_HASH_OLD;
+    mappedFile = NULL;
+    mappedLength = 0;
+    allocatedMap = NULL;
+    allocatedLength = 0;
+    frozenPairs = NULL;
+    pairKeys = NULL;
+    scalable = false;
+    capacity = 0;
+    designFpRate = 0;
+    itemsAdded = 0;
+    subFilterCount = 0;
+    folds = 0;
+    //at least a block, or a partition of blocks in the minimizer layout
+    uint64_t minBits = (layout == BLOOM_MINIMIZER) ? BLOOM_BLOCK_BITS*BLOOM_PARTITION_BLOCKS : BLOOM_BLOCK_BITS;
+    if(layout != BLOOM_CLASSIC && tai_bloom < minBits){
+        tai_bloom = minBits;
+    }
      //printf("custom construc \n");
     k = kVal;
+    setMinimizerSize(BLOOM_DEFAULT_MINIMIZER);
     n_hash_func = 4 ;//def
     user_seed =0;
     nb_elem = 0;
-    hashSize = (int) log2(tai_bloom)+1;
-    //printf("Hash size: %d \n", hashSize);
-    tai = pow(2, hashSize);
-    // tai = tai_bloom;
-    //printf("Tai: %lli \n", tai);
-    if(tai == 0){
-       tai = 1;
-    }
-    bloomMask = tai-1;
+    if(exactSize){
+        //whole blocks for the blocked layout, whole partitions for the minimizer layout, whole words otherwise, times
+        //the folds asked for by setFoldable
+        uint64_t unit = ((layout != BLOOM_CLASSIC) ? BLOOM_BLOCK_BITS : 64) << foldableFolds;
+        if(layout == BLOOM_MINIMIZER){
+            unit = minBits;
+        }
+        tai = std::max((tai_bloom + unit - 1) / unit * unit, unit);
+        hashSize = 64;
+        bloomMask = ~0ULL;
+    }
+    else{
+        hashSize = (int) log2(tai_bloom)+1;
+        //printf("Hash size: %d \n", hashSize);
+        tai = pow(2, hashSize);
+        // tai = tai_bloom;
+        //printf("Tai: %lli \n", tai);
+        if(tai == 0){
+           tai = 1;
+        }
+        bloomMask = tai-1;
+    }
+    blockCount = tai/BLOOM_BLOCK_BITS;
     //printf("Mask: %lli \n", bloomMask);
     nchar = (tai/8LL);
-    blooma =(unsigned char *)  malloc( nchar *sizeof(unsigned char)); // 1 bit per elem
+    // 1 bit per elem, aligned so the blocks of the blocked layout are cache lines
+    blooma = allocate(nchar *sizeof(unsigned char));
     //printf("Allocation for filter: %lli bits. \n",nchar *sizeof(unsigned char)*8);
-    memset(blooma,0,nchar *sizeof(unsigned char));
     //fprintf(stderr,"malloc bloom %lli MB \n",(tai/8LL)/1024LL/1024LL);
     this->generate_hash_seed();
  }
 
 float Bloom::weight()
 {
-    // return the number of 1's in the Bloom, nibble by nibble
+    if(layout == BLOOM_FROZEN_PAIRS){
+        return 0;
+    }
+    if(layout == BLOOM_COUNTING){
+        uint64_t counted = 0;
+        for(uint64_t counter = 0; counter < tai/2; counter++){
+            if(getCounter(blooma, counter) >= threshold){
+                counted++;
+            }
+        }
+        return (float)counted/(float)(tai/2);
+    }
+    if(layout == BLOOM_EXACT){
+        const uint64_t* slots = (const uint64_t*)blooma;
+        uint64_t solid = 0;
+        for(uint64_t i = 0; i < tai/64; i++){
+            solid += slots[i] && (int)(slots[i] >> BLOOM_EXACT_COUNT_SHIFT) >= threshold;
+        }
+        return (float)solid/(float)(tai/64);
+    }
+    // return the number of 1's in the Bloom, nibble by nibble, over all the sub-filters of a scalable one
     const unsigned char oneBits[] = {0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4};
     long weight = 0;
-    for(uint64_t index = 0; index < nchar; index++)
+    uint64_t bits = 0;
+    for(int i = -1; i < subFilterCount; i++)
     {
-        unsigned char current_char = blooma[index];
-        weight += oneBits[current_char&0x0f];
-        weight += oneBits[current_char>>4];
+        Bloom* sub = i < 0 ? this : subFilters[i];
+        for(uint64_t index = 0; index < sub->nchar; index++)
+        {
+            unsigned char current_char = sub->blooma[index];
+            weight += oneBits[current_char&0x0f];
+            weight += oneBits[current_char>>4];
+        }
+        bits += sub->tai;
+    }
+    return (float)weight/(float)bits;
+}
+
+
+//False positive rate of a classic filter with the given bits per item and hash functions
+static double classic_fp_rate(double bits_per_item, int num_hash){
+    return pow(1 - exp(-num_hash/bits_per_item), num_hash);
+}
+
+//False positive rate of a blocked filter, following Putze, Sanders and Singler, "Cache-, Hash- and Space-Efficient
+//Bloom Filters": the number of items in a block is Poisson distributed with mean BLOOM_BLOCK_BITS/bits_per_item,
+//and a block holding i items answers like a small classic filter of BLOOM_BLOCK_BITS bits with i items.
+static double blocked_fp_rate(double bits_per_item, int num_hash){
+    double mean = BLOOM_BLOCK_BITS/bits_per_item;
+    double rate = 0;
+    for(int i = 0; i < mean + 10*sqrt(mean) + 10; i++){
+        double weight = exp(-mean + i*log(mean) - lgamma(i+1));
+        rate += weight*pow(1 - pow(1 - 1.0/BLOOM_BLOCK_BITS, (double)num_hash*i), num_hash);
+    }
+    return rate;
+}
+
+//False positive rate of the threshold view of a counting filter, with the same Poisson model of the block loads as
+//blocked_fp_rate.  Within a block, a counter is hit by the probes of the repeated kmers and of the singletons at
+//Poisson rates, and reaches the threshold if any repeated kmer hits it or if threshold singletons do.
+//Counting every repeated kmer as reaching the threshold overestimates the rate for thresholds above 2.
+static double counting_fp_rate(double counters_per_item, int num_hash, double singleton_fraction, int threshold){
+    double mean = BLOOM_BLOCK_COUNTERS/counters_per_item;
+    double rate = 0;
+    for(int i = 0; i < mean + 10*sqrt(mean) + 10; i++){
+        double weight = exp(-mean + i*log(mean) - lgamma(i+1));
+        double repeatedHits = (double)num_hash*i*(1 - singleton_fraction)/BLOOM_BLOCK_COUNTERS;
+        double singletonHits = (double)num_hash*i*singleton_fraction/BLOOM_BLOCK_COUNTERS;
+        double belowThreshold = 0, term = exp(-singletonHits);
+        for(int j = 0; j < threshold; j++){
+            belowThreshold += term;
+            term *= singletonHits/(j+1);
+        }
+        rate += weight*pow(1 - exp(-repeatedHits)*belowThreshold, num_hash);
     }
-    return (float)weight/(float)tai;
+    return rate;
+}
+
+int Bloom::getLayout(){
+    return layout;
+}
+
+uint64_t Bloom::getBlockCount(){
+    return blockCount;
+}
+
+uint64_t Bloom::getBytes(){
+    return nchar;
+}
+
+bool Bloom::isScalable(){
+    return scalable;
+}
+
+bool Bloom::isExact(){
+    return layout == BLOOM_EXACT;
+}
+
+void Bloom::setThreshold(int t){
+    threshold = t;
+}
+
+int Bloom::getThreshold(){
+    return threshold;
 }
 
+void Bloom::setHashMode(int mode){
+    hashMode = mode;
+}
 
-Bloom* Bloom::create_bloom_filter_2_hash(uint64_t estimated_items, float fpRate){
+int Bloom::getHashMode(){
+    return hashMode;
+}
+
+void Bloom::setMinimizerSize(int m){
+    minimizerSize = std::max(1, std::min(std::min(m, k), 32));
+    mmerMask = (minimizerSize == 32) ? ~0ULL : (1ULL << (2*minimizerSize)) - 1;
+}
+
+int Bloom::getMinimizerSize(){
+    return minimizerSize;
+}
+
+bool Bloom::isExactSize(){
+    return exactSize;
+}
+
+Bloom* Bloom::create_bloom_filter_2_hash(uint64_t estimated_items, float fpRate, int layout, bool exactSize){
      
     Bloom * bloo1;
     int bits_per_item = 2*(int)(1/pow(fpRate,.5));// needed to process argv[5]
@@ -216,20 +679,35 @@ Bloom* Bloom::create_bloom_filter_2_hash(uint64_t estimated_items, float fpRate)
     printf("Estimated bloom size: %lli .\n", estimated_bloom_size);
     
     printf("BF memory: %f MB\n", (float)(estimated_bloom_size/8LL /1024LL)/1024);
-    bloo1 = new Bloom(estimated_bloom_size, sizeKmer);
+    bloo1 = new Bloom(estimated_bloom_size, sizeKmer, layout, exactSize);
 
 
     printf("Number of hash functions: %d \n", 2);
     bloo1->set_number_of_hash_func(2);
+    bloo1->capacity = estimated_items;
+    bloo1->designFpRate = fpRate;
 
     return bloo1;
 }
 
 
-Bloom* Bloom::create_bloom_filter_optimal(uint64_t estimated_items, float fpRate){
+Bloom* Bloom::create_bloom_filter_optimal(uint64_t estimated_items, float fpRate, int layout, bool exactSize){
      
     Bloom * bloo1;
     int bits_per_item = -log(fpRate)/log(2)/log(2); // needed to process argv[5]
+    int num_hash = (int)floorf(0.7*bits_per_item);
+
+    if(layout == BLOOM_BLOCKED || layout == BLOOM_MINIMIZER){
+        //grow the filter until the blocked false positive rate matches what the classic filter would give.
+        //The minimizer layout loads its blocks less evenly than this assumes, since partitions get whole minimizers.
+        double target = std::max((double)fpRate, classic_fp_rate(bits_per_item, std::max(num_hash, 1)));
+        num_hash = std::min(std::max(num_hash, 1), NSEEDSBLOOM);
+        while(blocked_fp_rate(bits_per_item, num_hash) > target && bits_per_item < BLOOM_BLOCK_BITS){
+            bits_per_item++;
+            num_hash = std::min(std::max((int)floorf(0.7*bits_per_item), 1), NSEEDSBLOOM);
+        }
+        printf("Blocked layout, expected false positive rate: %f \n", blocked_fp_rate(bits_per_item, num_hash));
+    }
 
     printf("Bits per kmer: %d \n", bits_per_item);
     // int estimated_bloom_size = max( (int)ceilf(log2f(nb_reads * NBITS_PER_KMER )), 1);
@@ -238,24 +716,291 @@ Bloom* Bloom::create_bloom_filter_optimal(uint64_t estimated_items, float fpRate
     //printf("Estimated bloom size: %lli.\n", estimated_bloom_size);
     
     printf("BF memory: %f MB\n", (float)(estimated_bloom_size/8LL /1024LL)/1024);
-    bloo1 = new Bloom(estimated_bloom_size, sizeKmer);
+    bloo1 = new Bloom(estimated_bloom_size, sizeKmer, layout, exactSize);
 
-    printf("Number of hash functions: %d \n", (int)floorf(0.7*bits_per_item));
-    bloo1->set_number_of_hash_func((int)floorf(0.7*bits_per_item));
+    printf("Number of hash functions: %d \n", num_hash);
+    bloo1->set_number_of_hash_func(num_hash);
+    bloo1->capacity = estimated_items;
+    bloo1->designFpRate = fpRate;
 
     return bloo1;
 }
 
+int Bloom::extensionMask(DoubleKmer kmer, bool dir){
+    //Extending a kmer forward by nt extends its reverse complement backward by revcomp_int(nt)
+    kmer_type forwardBase = (dir == FORWARD) ? kmer.kmer : kmer.revcompKmer;
+    kmer_type backwardBase = (dir == FORWARD) ? kmer.revcompKmer : kmer.kmer;
+    kmer_type baseKmer = forwardBase; //before it is extended, for its minimizer
+    //the rolling hash of the extensions is rolled from the strand that is extended forward
+    RollingHash state;
+    int outNt = 0;
+    if(hashMode == BLOOM_HASH_ROLLING && !fake){
+        state = rollingState(forwardBase);
+        outNt = (int)(forwardBase >> (2*k - 2)) & 3;
+    }
+    forwardBase <<= 2;
+    forwardBase &= kmerMask;
+    backwardBase >>= 2;
+
+    bloom_elem canon[4];
+    uint64_t hashA[4], hashB[4];
+    for(int nt = 0; nt < 4; nt++){
+        kmer_type ext = forwardBase;
+        ext += nt;
+        kmer_type revcompExt = backwardBase;
+        revcompExt += ((uint64_t)revcomp_int(nt)) << (2*sizeKmer-2);
+        canon[nt] = std::min(ext, revcompExt);
+    }
+
+    int mask = 0;
+    if(fake){
+        for(int nt = 0; nt < 4; nt++){
+            if(valid_set.find(canon[nt]) != valid_set.end()){
+                mask |= 1 << nt;
+            }
+        }
+        return mask;
+    }
+    if(layout == BLOOM_EXACT){
+        for(int nt = 0; nt < 4; nt++){
+            exactPrefetch(canon[nt]);
+        }
+        for(int nt = 0; nt < 4; nt++){
+            if(exactContains(canon[nt])){
+                mask |= 1 << nt;
+            }
+        }
+        return mask;
+    }
+
+    if(hashMode == BLOOM_HASH_ROLLING){
+        for(int nt = 0; nt < 4; nt++){
+            rollingHashes(roll(state, outNt, nt), hashA[nt], hashB[nt]);
+        }
+    }
+    else{
+        for(int nt = 0; nt < 4; nt++){
+            hashA[nt] = oldHash(canon[nt], 0);
+        }
+        for(int nt = 0; nt < 4; nt++){
+            hashB[nt] = oldHash(canon[nt], 1);
+        }
+    }
+    if(layout == BLOOM_MINIMIZER){
+        //the extensions are the base kmer extended forward, and most keep its minimizer
+        Minimizer min = minimizerOf(baseKmer);
+        for(int nt = 0; nt < 4; nt++){
+            hashA[nt] = withMinimizer(hashA[nt], extendMinimizer(min, forwardBase + nt).hash);
+        }
+    }
+    for(int nt = 0; nt < 4; nt++){
+        prefetch(hashA[nt], hashB[nt]);
+    }
+    for(int nt = 0; nt < 4; nt++){
+        if(contains(hashA[nt], hashB[nt])){
+            mask |= 1 << nt;
+        }
+    }
+    return mask;
+}
+
+void Bloom::hash_batch(const bloom_elem* elems, int count, uint64_t* hashA, uint64_t* hashB){
+    hash_batch_kmers(elems, count, hashA, hashB);
+    if(layout == BLOOM_MINIMIZER){
+        for(int i = 0; i < count; i++){
+            hashA[i] = withMinimizer(hashA[i], minimizerOf(elems[i]).hash);
+        }
+    }
+}
+
+void Bloom::hash_batch_kmers(const bloom_elem* elems, int count, uint64_t* hashA, uint64_t* hashB){
+    if(hashMode == BLOOM_HASH_ROLLING){
+        //lone kmers have no previous state to roll from
+        for(int i = 0; i < count; i++){
+            rollingHashes(rollingState(elems[i]), hashA[i], hashB[i]);
+        }
+        return;
+    }
+    for(int i = 0; i < count; i++){
+        hashA[i] = oldHash(elems[i], 0);
+    }
+    for(int i = 0; i < count; i++){
+        hashB[i] = oldHash(elems[i], 1);
+    }
+}
+
+void Bloom::add_batch(const bloom_elem* elems, int count){
+    uint64_t hashA[BLOOM_WINDOW], hashB[BLOOM_WINDOW];
+    for(int start = 0; start < count; start += BLOOM_WINDOW){
+        int size = std::min(count - start, BLOOM_WINDOW);
+        hash_batch(elems + start, size, hashA, hashB);
+        add_hashes(hashA, hashB, size);
+    }
+}
+
+void Bloom::atomic_add_batch(const bloom_elem* elems, int count){
+    uint64_t hashA[BLOOM_WINDOW], hashB[BLOOM_WINDOW];
+    for(int start = 0; start < count; start += BLOOM_WINDOW){
+        int size = std::min(count - start, BLOOM_WINDOW);
+        hash_batch(elems + start, size, hashA, hashB);
+        atomic_add_hashes(hashA, hashB, size);
+    }
+}
+
+void Bloom::contains_batch(const bloom_elem* elems, int count, unsigned char* found){
+    if(fake){
+        for(int i = 0; i < count; i++){
+            found[i] = (valid_set.find(elems[i]) != valid_set.end());
+        }
+        return;
+    }
+    if(layout == BLOOM_EXACT){
+        for(int i = 0; i < count && i < BLOOM_PREFETCH_DISTANCE; i++){
+            exactPrefetch(elems[i]);
+        }
+        for(int i = 0; i < count; i++){
+            if(i + BLOOM_PREFETCH_DISTANCE < count){
+                exactPrefetch(elems[i + BLOOM_PREFETCH_DISTANCE]);
+            }
+            found[i] = exactContains(elems[i]);
+        }
+        return;
+    }
+    uint64_t hashA[BLOOM_WINDOW], hashB[BLOOM_WINDOW];
+    for(int start = 0; start < count; start += BLOOM_WINDOW){
+        int size = std::min(count - start, BLOOM_WINDOW);
+        hash_batch(elems + start, size, hashA, hashB);
+        contains_hashes(hashA, hashB, size, found + start);
+    }
+}
+
+void Bloom::add_hashes(const uint64_t* hashA, const uint64_t* hashB, int count){
+    for(int i = 0; i < count && i < BLOOM_PREFETCH_DISTANCE; i++){
+        prefetch(hashA[i], hashB[i]);
+    }
+    for(int i = 0; i < count; i++){
+        if(i + BLOOM_PREFETCH_DISTANCE < count){
+            prefetch(hashA[i + BLOOM_PREFETCH_DISTANCE], hashB[i + BLOOM_PREFETCH_DISTANCE]);
+        }
+        add(hashA[i], hashB[i]);
+    }
+}
+
+void Bloom::atomic_add_hashes(const uint64_t* hashA, const uint64_t* hashB, int count){
+    for(int i = 0; i < count && i < BLOOM_PREFETCH_DISTANCE; i++){
+        prefetch(hashA[i], hashB[i]);
+    }
+    for(int i = 0; i < count; i++){
+        if(i + BLOOM_PREFETCH_DISTANCE < count){
+            prefetch(hashA[i + BLOOM_PREFETCH_DISTANCE], hashB[i + BLOOM_PREFETCH_DISTANCE]);
+        }
+        atomic_add(hashA[i], hashB[i]);
+    }
+}
+
+void Bloom::contains_hashes(const uint64_t* hashA, const uint64_t* hashB, int count, unsigned char* found){
+    for(int i = 0; i < count && i < BLOOM_PREFETCH_DISTANCE; i++){
+        prefetch(hashA[i], hashB[i]);
+    }
+    for(int i = 0; i < count; i++){
+        if(i + BLOOM_PREFETCH_DISTANCE < count){
+            prefetch(hashA[i + BLOOM_PREFETCH_DISTANCE], hashB[i + BLOOM_PREFETCH_DISTANCE]);
+        }
+        found[i] = contains(hashA[i], hashB[i]);
+    }
+}
+
+Bloom* Bloom::create_counting_filter(uint64_t estimated_items, uint64_t singletons, float fpRate, int threshold, bool exactSize){
+    Bloom * bloo1;
+    double singleton_fraction = estimated_items ? std::min(1.0, (double)singletons/estimated_items) : 0;
+
+    //the fewest counters per item that reach fpRate, each with its best number of hash functions
+    double counters_per_item;
+    int num_hash = 1;
+    double rate;
+    for(counters_per_item = 1; counters_per_item < BLOOM_BLOCK_COUNTERS; counters_per_item += 0.25){
+        rate = 1;
+        for(int i = 1; i <= NSEEDSBLOOM; i++){
+            double iRate = counting_fp_rate(counters_per_item, i, singleton_fraction, threshold);
+            if(iRate < rate){
+                rate = iRate, num_hash = i;
+            }
+        }
+        if(rate <= fpRate) break;
+    }
+
+    uint64_t estimated_bloom_size = (uint64_t)(estimated_items*counters_per_item*2);
+    printf("Counting filter: %.2f counters per kmer, threshold %d, expected false positive rate: %f \n", counters_per_item, threshold, rate);
+    printf("BF memory: %f MB\n", (float)(estimated_bloom_size/8LL /1024LL)/1024);
+    bloo1 = new Bloom(estimated_bloom_size, sizeKmer, BLOOM_COUNTING, exactSize);
+
+    printf("Number of hash functions: %d \n", num_hash);
+    bloo1->set_number_of_hash_func(num_hash);
+    bloo1->setThreshold(threshold);
+
+    return bloo1;
+}
+
+uint64_t Bloom::exact_set_bytes(uint64_t estimated_items){
+    uint64_t slots = 1024;
+    while(slots < estimated_items*BLOOM_EXACT_SLOTS_PER_KMER){
+        slots <<= 1;
+    }
+    return slots*sizeof(uint64_t);
+}
+
+Bloom* Bloom::create_exact_set(uint64_t estimated_items, int threshold){
+    //a power of two of slots, which is a whole number of blocks for the constructor
+    Bloom* set = new Bloom(exact_set_bytes(estimated_items)*8, sizeKmer, BLOOM_EXACT, true);
+    set->set_number_of_hash_func(1);
+    set->setThreshold(threshold);
+    set->capacity = estimated_items;
+    printf("Exact kmer set: %llu slots for %llu kmers, threshold %d \n", (unsigned long long)(set->tai/64),
+        (unsigned long long)estimated_items, threshold);
+    printf("Exact set memory: %f MB\n", set->nchar/(1024.0*1024.0));
+    return set;
+}
+
+//Adds one to the count of canon, claiming the first empty slot from its home if it isn't in the set yet
+void Bloom::exactAdd(bloom_elem canon, bool atomic){
+    uint64_t* slots = (uint64_t*)blooma;
+    uint64_t mask = tai/64 - 1;
+    uint64_t one = 1ULL << BLOOM_EXACT_COUNT_SHIFT;
+    for(uint64_t i = exactHome(canon); ; i = (i + 1) & mask){
+        uint64_t slot = atomic ? __atomic_load_n(&slots[i], __ATOMIC_RELAXED) : slots[i];
+        while(slot == 0 || (slot & BLOOM_EXACT_KMER_BITS) == canon){
+            uint64_t next = (slot == 0) ? (canon | one) : slot + ((slot >> BLOOM_EXACT_COUNT_SHIFT) < BLOOM_MAX_COUNT ? one : 0);
+            if(next == slot){
+                return;
+            }
+            if(!atomic){
+                slots[i] = next;
+            }
+            //a failed exchange reloads slot, which another thread may have given to canon or to another kmer
+            else if(!__atomic_compare_exchange_n(&slots[i], &slot, next, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+                continue;
+            }
+            if(slot == 0){
+                uint64_t used = atomic ? __atomic_add_fetch(&itemsAdded, 1, __ATOMIC_RELAXED) : ++itemsAdded;
+                if(used > BLOOM_EXACT_MAX_LOAD*(tai/64)){
+                    fprintf(stderr, "The exact kmer set is full at %llu kmers, sized for %llu: raise -estimated_kmers, or use --estimate_kmers.\n",
+                        (unsigned long long)used, (unsigned long long)capacity);
+                    exit(1);
+                }
+            }
+            return;
+        }
+    }
+}
+
 bool isJunction(ReadKmer readKmer, Bloom* bloom, bool dir){
   kmer_type real_ext = readKmer.getRealExtension();
   //Check alternate extensions, and if the total valid extension count is greater than 1, return true. 
-  kmer_type real = readKmer.getKmer();
+  int mask = bloom->extensionMask(readKmer.doubleKmer, dir);
 
-  for(int nt=0; nt<4; nt++) {//for each extension
-    kmer_type test_ext = readKmer.doubleKmer.getExtension(nt, dir); //get possible extension
-    if(real_ext != test_ext){//if the alternate and real extensions are different
-      if(bloom->oldContains(get_canon(test_ext)))//if the branch checks out initially
-      { 
+  for(int nt=0; nt<4; nt++) {//for each extension in the filter
+    if(mask & (1 << nt)){
+      if(real_ext != readKmer.doubleKmer.getExtension(nt, dir)){//if the alternate and real extensions are different
         return true;
       }
     }
@@ -264,156 +1009,799 @@ bool isJunction(ReadKmer readKmer, Bloom* bloom, bool dir){
   return false;  
 }
 
-void load_two_filters(Bloom* bloo1, Bloom* bloo2, string reads_filename, bool fastq, bool mercy){
-    ifstream solidReads;
-    solidReads.open(reads_filename);
+//Loads the kmers of one unambiguous read into the pair of filters.
+//A kmer goes to bloo2 if all its bits were already set in bloo1, and to bloo1 otherwise.
+//The canonical kmers of a read and their hashes, kept per loader thread so the vectors are reused
+struct ReadHashes{
+    std::vector<kmer_type> kmers;
+    std::vector<uint64_t> hashA, hashB;
+    int count;
+
+    //Hashes all the kmers of read with the seeds of bloom and returns their number
+    int compute(Bloom* bloom, ReadSpan read){
+        int kmerCount = std::max(read.length - sizeKmer + 1, 0);
+        if(hashA.size() < (size_t)kmerCount){
+            hashA.resize(kmerCount);
+            hashB.resize(kmerCount);
+        }
+        count = bloom->hash_read(read, hashA.data(), hashB.data());
+        return count;
+    }
 
-    int readsProcessed = 0;
+    //Prefetches the probes of kmer i in both filters, if it exists
+    void prefetch(Bloom* bloo1, Bloom* bloo2, int i){
+        if(i < count){
+            bloo1->prefetch(hashA[i], hashB[i]);
+            bloo2->prefetch(hashA[i], hashB[i]);
+        }
+    }
+};
+static thread_local ReadHashes readHashes;
+
+int Bloom::hash_read(ReadSpan read, uint64_t* hashA, uint64_t* hashB){
+    int count = hash_read_kmers(read, hashA, hashB);
+    if(layout == BLOOM_MINIMIZER && count > 0){
+        //slide the minimizer along the read with its forward strand kmer
+        kmer_type kmer = 0;
+        for(int i = 0; i < k; i++){
+            kmer = (kmer << 2) + NT2int(read.seq[i]);
+        }
+        Minimizer min = minimizerOf(kmer);
+        hashA[0] = withMinimizer(hashA[0], min.hash);
+        for(int i = 1; i < count; i++){
+            kmer = ((kmer << 2) + NT2int(read.seq[i + k - 1])) & kmerMask;
+            min = extendMinimizer(min, kmer);
+            hashA[i] = withMinimizer(hashA[i], min.hash);
+        }
+    }
+    return count;
+}
 
-    string read;
-    time_t start, stop;
-    time(&start);
-    printf("Weights before load: %f, %f \n", bloo1->weight(), bloo2->weight());
+int Bloom::hash_read_kmers(ReadSpan read, uint64_t* hashA, uint64_t* hashB){
+    int count = 0;
+    if(hashMode == BLOOM_HASH_ROLLING){
+        if(read.length < k){
+            return 0;
+        }
+        RollingHash state = {0, 0};
+        for(int i = 0; i < k; i++){
+            int nt = NT2int(read.seq[i]);
+            state.forward = rol(state.forward, 1) ^ nt_hash_seed[nt];
+            state.reverse ^= rol(nt_hash_seed[nt ^ 2], i);
+        }
+        rollingHashes(state, hashA[count], hashB[count]);
+        count++;
+        for(int i = k; i < read.length; i++){
+            state = roll(state, NT2int(read.seq[i - k]), NT2int(read.seq[i]));
+            rollingHashes(state, hashA[count], hashB[count]);
+            count++;
+        }
+        return count;
+    }
+    std::vector<kmer_type>& kmers = readHashes.kmers;
+    getCanonKmers(read, kmers);
+    hash_batch_kmers(kmers.data(), kmers.size(), hashA, hashB);
+    return kmers.size();
+}
+
+//The kmers of a read are added in order, with their slots prefetched ahead like the probes of add_hashes
+void Bloom::exact_add_read(ReadSpan read, bool atomic){
+    std::vector<kmer_type>& kmers = readHashes.kmers;
+    getCanonKmers(read, kmers);
+    int count = kmers.size();
+    for(int i = 0; i < count && i < BLOOM_PREFETCH_DISTANCE; i++){
+        exactPrefetch(kmers[i]);
+    }
+    for(int i = 0; i < count; i++){
+        if(i + BLOOM_PREFETCH_DISTANCE < count){
+            exactPrefetch(kmers[i + BLOOM_PREFETCH_DISTANCE]);
+        }
+        exactAdd(kmers[i], atomic);
+    }
+}
+
+void Bloom::add_read(ReadSpan read){
+    if(layout == BLOOM_EXACT){
+        exact_add_read(read, false);
+        return;
+    }
+    int count = readHashes.compute(this, read);
+    add_hashes(readHashes.hashA.data(), readHashes.hashB.data(), count);
+}
+
+void Bloom::atomic_add_read(ReadSpan read){
+    if(layout == BLOOM_EXACT){
+        exact_add_read(read, true);
+        return;
+    }
+    int count = readHashes.compute(this, read);
+    atomic_add_hashes(readHashes.hashA.data(), readHashes.hashB.data(), count);
+}
+
+int Bloom::contains_read(ReadSpan read, std::vector<unsigned char>& found){
+    if(fake || layout == BLOOM_EXACT){
+        std::vector<kmer_type>& kmers = readHashes.kmers;
+        getCanonKmers(read, kmers);
+        found.resize(kmers.size());
+        contains_batch(kmers.data(), kmers.size(), found.data());
+        return kmers.size();
+    }
+    int count = readHashes.compute(this, read);
+    found.resize(count);
+    contains_hashes(readHashes.hashA.data(), readHashes.hashB.data(), count, found.data());
+    return count;
+}
+
+static void load_read_two_filters(Bloom* bloo1, Bloom* bloo2, ReadSpan read, bool mercy){
     uint64_t hashA, hashB;
     kmer_type canonKmer;
-    uint64_t unambiguousReads = 0;
-    while (getline(solidReads, read))
-    {
-        getline(solidReads, read);//since it's a fasta or fastq we skip the first of every pair of lines
-        std::list<string> readList = getUnambiguousReads(read);
-        while(!readList.empty()){
-            read = readList.front();
-            readList.pop_front();
-            unambiguousReads++;
-            if (!mercy){
-                for(ReadKmer kmer = ReadKmer(&read); kmer.getDistToEnd() >= 0 ; kmer.forward(), kmer.forward()){
-                    canonKmer = kmer.getCanon();
-                    hashA = bloo1->oldHash(canonKmer, 0);
-                    hashB = bloo1->oldHash(canonKmer, 1);
-                    if(bloo1->contains(hashA, hashB)){
-                        bloo2->add(hashA, hashB);
+    if (!mercy){
+        //hash the whole read first, then resolve the kmers in order with their probes prefetched ahead
+        int count = readHashes.compute(bloo1, read);
+        for(int i = 0; i < BLOOM_PREFETCH_DISTANCE; i++){
+            readHashes.prefetch(bloo1, bloo2, i);
+        }
+        for(int i = 0; i < count; i++){
+            readHashes.prefetch(bloo1, bloo2, i + BLOOM_PREFETCH_DISTANCE);
+            hashA = readHashes.hashA[i];
+            hashB = readHashes.hashB[i];
+            if(bloo1->contains(hashA, hashB)){
+                bloo2->add(hashA, hashB);
+            }
+            else{
+                bloo1->add(hashA, hashB);
+            }
+        }
+    } else{ // mercy kmers strategy - try to capture low coverage connecting k-mers
+        ReadKmer *last_kmer = nullptr;
+        std::list<std::pair<uint64_t, uint64_t>  > hash_vals = {};
+        for(ReadKmer kmer = ReadKmer(read); kmer.getDistToEnd() >= 0 ; kmer.forward(), kmer.forward()){
+            canonKmer = kmer.getCanon();
+            bloo1->hashKmer(canonKmer, hashA, hashB);
+            if(bloo1->contains(hashA, hashB)){
+                bloo2->add(hashA, hashB);
+                last_kmer = &kmer;
+
+                if(hash_vals.size()!=0) { // came from low to high 
+                    if (!isJunction(kmer, bloo1, BACKWARD)){
+                        for(auto val : hash_vals){
+                            bloo2->add(val.first, val.second);
+                        }
                     }
-                    else{
-                        bloo1->add(hashA, hashB);
+                    hash_vals.clear();
+                }                                                  
+            }
+            else{
+                bloo1->add(hashA, hashB);
+                if (last_kmer) {
+                    if (hash_vals.size()==0) { // came from high to low
+                        if(!isJunction(*last_kmer, bloo1, FORWARD)){
+                            hash_vals.push_back(std::make_pair(hashA, hashB));
+                        }
+                    }else{
+                        hash_vals.push_back(std::make_pair(hashA, hashB));
                     }
                 }
-            } else{ // mercy kmers strategy - try to capture low coverage connecting k-mers
-                ReadKmer *last_kmer = nullptr;
-                std::list<std::pair<uint64_t, uint64_t>  > hash_vals = {};
-                for(ReadKmer kmer = ReadKmer(&read); kmer.getDistToEnd() >= 0 ; kmer.forward(), kmer.forward()){
-                    canonKmer = kmer.getCanon();
-                    hashA = bloo1->oldHash(canonKmer, 0);
-                    hashB = bloo1->oldHash(canonKmer, 1);
-                    if(bloo1->contains(hashA, hashB)){
-                        bloo2->add(hashA, hashB);
-                        last_kmer = &kmer;
-
-                        if(hash_vals.size()!=0) { // came from low to high 
-                            if (!isJunction(kmer, bloo1, BACKWARD)){
-                                for(auto val : hash_vals){
-                                    bloo2->add(val.first, val.second);
-                                }
-                            }
-                            hash_vals.clear();
-                        }                                                  
+            }
+        }
+    }
+}
+
+//Lets a load resolve the kmers its workers hash in file order.  The workers read batches rounds at a time: a round is
+//the next batches batches of the file, and each worker tells its callbacks which batch of the round, counting from 0,
+//the reads that follow come from with startBatch.  Once every batch of a round is loaded, resolve is called on one
+//thread with the number of batches read, while the workers wait, and the next round starts.
+struct LoadRounds{
+    int batches;
+    std::function<void (int worker, int slot)> startBatch;
+    std::function<void (int count)> resolve;
+};
+
+//Runs loadRead on every unambiguous read of the file, from the given number of threads.
+//Each thread takes batches of READ_BATCH_SIZE records from a shared SeqReader, then hashes them independently.
+//loadRead also gets the index of the thread, from 0 to threads - 1, so a caller can keep state of its own for each one.
+//With one thread the reads are loaded in file order on the calling thread, as worker 0.
+//If spool is given, every read's unambiguous pieces are also written to it, in file order.
+//If rounds is given, the batches are read in rounds, see LoadRounds.
+static void load_reads(string reads_filename, bool fastq, int threads, std::function<void (ReadSpan, int)> loadRead, SpoolWriter* spool = nullptr,
+    LoadRounds* rounds = nullptr){
+    SeqReader reader(reads_filename, fastq, threads);
+
+    std::mutex progressLock;
+    uint64_t readsProcessed = 0;
+    std::atomic<uint64_t> unambiguousReads(0);
+
+    //the round being read: batches handed out, batches still being loaded, and whether the reader is done
+    std::mutex roundLock;
+    std::condition_variable roundChanged;
+    int roundRead = 0, roundLoading = 0;
+    bool readerDone = false;
+    auto endRound = [&](){
+        if(roundLoading == 0 && roundRead > 0 && (roundRead == rounds->batches || readerDone)){
+            rounds->resolve(roundRead);
+            roundRead = 0;
+            roundChanged.notify_all();
+        }
+    };
+
+    auto worker = [&](int index){
+        SeqBatch batch;
+        std::vector<ReadSpan> pieces;
+        string spoolBlock;
+        uint64_t localUnambiguous = 0;
+        int count;
+        while(true){
+            if(rounds){
+                std::unique_lock<std::mutex> guard(roundLock);
+                roundChanged.wait(guard, [&]{ return readerDone || roundRead < rounds->batches; });
+                if(readerDone || (count = reader.nextBatch(batch, READ_BATCH_SIZE)) == 0){
+                    readerDone = true;
+                    endRound();
+                    roundChanged.notify_all();
+                    break;
+                }
+                rounds->startBatch(index, roundRead++);
+                roundLoading++;
+            }
+            else if((count = reader.nextBatch(batch, READ_BATCH_SIZE)) == 0){
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> guard(progressLock);
+                if ((readsProcessed + count)/100000 != readsProcessed/100000){
+                    fprintf (stdout,"\rreads consumed: %lld",(long long)(readsProcessed + count));
+                    fflush(stdout);
+                }
+                readsProcessed += count;
+            }
+            for(ReadSpan read : batch.reads){
+                getUnambiguousSpans(read, pieces);
+                for(ReadSpan piece : pieces){
+                    loadRead(piece, index);
+                    localUnambiguous++;
+                }
+                if(spool) encodeSpoolRecord(pieces, spoolBlock);
+            }
+            if(spool) spool->write(batch.index, spoolBlock), spoolBlock.clear();
+            if(rounds){
+                std::lock_guard<std::mutex> guard(roundLock);
+                roundLoading--;
+                endRound();
+            }
+        }
+        unambiguousReads += localUnambiguous;
+    };
+
+    if(threads > 1){
+        std::vector<std::thread> workers;
+        for(int i = 0; i < threads; i++){
+            workers.push_back(std::thread(worker, i));
+        }
+        for(auto& t : workers){
+            t.join();
+        }
+    }
+    else{
+        worker(0);
+    }
+    printf("\n");
+    printf("Reads processed: %llu\n", (unsigned long long)readsProcessed);
+    printf("Unambiguous reads: %llu\n", (unsigned long long)unambiguousReads);
+    if(reader.getMaskedBases()){
+        printf("Bases masked for low quality: %llu\n", (unsigned long long)reader.getMaskedBases());
+    }
+}
+
+//Opens the read spool of a load, or returns nullptr if spool_filename is empty
+static SpoolWriter* open_spool(string spool_filename){
+    if(spool_filename.empty()){
+        return nullptr;
+    }
+    SpoolWriter* spool = new SpoolWriter(spool_filename);
+    if(!spool->isOpen()) exit(1);
+    printf("Spooling reads to %s\n", spool_filename.c_str());
+    return spool;
+}
+
+static void close_spool(SpoolWriter* spool){
+    if(spool){
+        printf("Read spool size: %llu bytes\n", (unsigned long long)spool->getBytesWritten());
+        delete spool;
+    }
+}
+
+//Runs work on items 0 to count - 1, each on one of up to threads threads
+static void parallel_items(int count, int threads, std::function<void (int)> work){
+    std::atomic<int> next(0);
+    auto worker = [&](){
+        int item;
+        while((item = next++) < count){
+            work(item);
+        }
+    };
+    std::vector<std::thread> workers;
+    for(int i = 1; i < std::min(threads, count); i++){
+        workers.push_back(std::thread(worker));
+    }
+    worker();
+    for(auto& t : workers){
+        t.join();
+    }
+}
+
+//The kmers of one batch of a round of load_two_filters_threaded: the bits of every kmer, filed by region of the filters
+//in file order as (kmer, bit from the start of the region), and which kmers had a bit not yet set in bloo1
+struct TwoFilterBatch{
+    uint32_t kmers;
+    std::vector<std::vector<std::pair<uint32_t, uint32_t> > > probes;
+    std::vector<unsigned char> missing;
+};
+
+//load_two_filters on several threads, giving the same filters as the serial load.  In the serial load a kmer goes to
+//bloo2 if all its bits were set in bloo1 by the kmers before it.  Here the workers hash a round of batches, one batch
+//each, and file the bits of their kmers by region of the filters.  Then each region is resolved by one thread, going
+//through the round in file order: a bit of bloo1 that isn't set yet is set, and marks its kmer as missing from bloo1.
+//Once every region is done, the bits of the kmers that weren't missing are set in bloo2.  Regions are whole blocks, so
+//no two threads write the same byte.  A round takes about 8 bytes per bit of every kmer it holds.
+static void load_two_filters_threaded(Bloom* bloo1, Bloom* bloo2, string reads_filename, bool fastq, int threads, SpoolWriter* spool){
+    uint64_t bits = bloo1->getBytes()*8;
+    uint64_t regions = std::max<uint64_t>(BLOOM_LOAD_REGIONS*threads, (bits >> 31) + 1);
+    uint64_t regionBits = ((bits + regions - 1)/regions + BLOOM_BLOCK_BITS - 1)/BLOOM_BLOCK_BITS*BLOOM_BLOCK_BITS;
+    regions = (bits + regionBits - 1)/regionBits;
+
+    std::vector<TwoFilterBatch> round(threads);
+    std::vector<TwoFilterBatch*> current(threads);
+    LoadRounds rounds;
+    rounds.batches = threads;
+    rounds.startBatch = [&](int worker, int slot){
+        TwoFilterBatch& batch = round[slot];
+        batch.kmers = 0;
+        batch.probes.resize(regions);
+        for(auto& probes : batch.probes){
+            probes.clear();
+        }
+        current[worker] = &batch;
+    };
+    rounds.resolve = [&](int count){
+        for(int slot = 0; slot < count; slot++){
+            round[slot].missing.assign(round[slot].kmers, 0);
+        }
+        parallel_items(regions, threads, [&](int region){
+            unsigned char* seen = bloo1->blooma + region*(regionBits/8);
+            for(int slot = 0; slot < count; slot++){
+                TwoFilterBatch& batch = round[slot];
+                for(auto& probe : batch.probes[region]){
+                    unsigned char mask = bit_mask[probe.second & 7];
+                    if(!(seen[probe.second >> 3] & mask)){
+                        seen[probe.second >> 3] |= mask;
+                        __atomic_store_n(&batch.missing[probe.first], 1, __ATOMIC_RELAXED);
                     }
-                    else{
-                        bloo1->add(hashA, hashB);
-                        if (last_kmer) {
-                            if (hash_vals.size()==0) { // came from high to low
-                                if(!isJunction(*last_kmer, bloo1, FORWARD)){
-                                    hash_vals.push_back(std::make_pair(hashA, hashB));
-                                }
-                            }else{
-                                hash_vals.push_back(std::make_pair(hashA, hashB));
-                            }
-                        }
+                }
+            }
+        });
+        parallel_items(regions, threads, [&](int region){
+            unsigned char* solid = bloo2->blooma + region*(regionBits/8);
+            for(int slot = 0; slot < count; slot++){
+                TwoFilterBatch& batch = round[slot];
+                for(auto& probe : batch.probes[region]){
+                    if(!batch.missing[probe.first]){
+                        solid[probe.second >> 3] |= bit_mask[probe.second & 7];
                     }
                 }
-            }   
+            }
+        });
+    };
+    load_reads(reads_filename, fastq, threads, [&](ReadSpan read, int worker){
+        TwoFilterBatch& batch = *current[worker];
+        int count = readHashes.compute(bloo1, read);
+        uint64_t kmerBits[NSEEDSBLOOM];
+        for(int i = 0; i < count; i++){
+            int probes = bloo1->probeBits(readHashes.hashA[i], readHashes.hashB[i], kmerBits);
+            for(int j = 0; j < probes; j++){
+                uint64_t region = kmerBits[j] / regionBits;
+                batch.probes[region].push_back(std::make_pair(batch.kmers, (uint32_t)(kmerBits[j] - region*regionBits)));
+            }
+            batch.kmers++;
+        }
+    }, spool, &rounds);
+}
+
+void load_two_filters(Bloom* bloo1, Bloom* bloo2, string reads_filename, bool fastq, bool mercy, int threads, string spool_filename){
+    time_t start, stop;
+    time(&start);
+    SpoolWriter* spool = open_spool(spool_filename);
+    printf("Weights before load: %f, %f \n", bloo1->weight(), bloo2->weight());
+    //the mercy kmers of a read depend on the junctions in bloo1 as the read is loaded, and a scalable filter grows
+    //with the keys added, so these loads stay on one thread
+    bool sameFilters = bloo1->getLayout() == bloo2->getLayout() && bloo1->getBytes() == bloo2->getBytes()
+        && bloo1->isExactSize() == bloo2->isExactSize() && bloo1->getNumHash() == bloo2->getNumHash();
+    if(threads > 1 && (mercy || bloo1->isScalable() || bloo2->isScalable() || !sameFilters
+       || (bloo1->getLayout() != BLOOM_CLASSIC && bloo1->getLayout() != BLOOM_BLOCKED && bloo1->getLayout() != BLOOM_MINIMIZER))){
+        printf("Loading on one thread: %s\n", mercy ? "--mercy needs the reads in order" : "the filters can't be split by region");
+        threads = 1;
+    }
+    if(threads > 1){
+        printf("Loading with %d threads\n", threads);
+        load_two_filters_threaded(bloo1, bloo2, reads_filename, fastq, threads, spool);
+    }
+    else{
+        load_reads(reads_filename, fastq, 1, [&](ReadSpan read, int){
+            load_read_two_filters(bloo1, bloo2, read, mercy);
+        }, spool);
+    }
+    close_spool(spool);
+    printf("Weights after load: %f, %f \n", bloo1->weight(), bloo2->weight());
+    time(&stop);
+    printf("Time to load: %f \n", difftime(stop,start));
+}
+
+//The bucket files of a bucketed load
+struct BloomBuckets{
+    std::vector<FILE*> files;
+    std::vector<string> names;
+    std::vector<std::mutex> locks;
+    std::vector<uint64_t> records;
+
+    BloomBuckets(string dir, int count) : files(count), names(count), locks(count), records(count, 0) {
+        for(int i = 0; i < count; i++){
+            names[i] = dir + "/faucet." + std::to_string(getpid()) + ".bucket" + std::to_string(i);
+            files[i] = fopen(names[i].c_str(), "w+b");
+            if(!files[i]){
+                fprintf(stderr, "Could not create bucket file %s: %s\n", names[i].c_str(), strerror(errno));
+                exit(1);
+            }
         }
-        readsProcessed++;
-        if ((readsProcessed%100000)==0){
-         fprintf (stdout,"\rreads consumed: %lld",(long long)readsProcessed);
-         fflush(stdout);
+    }
+
+    //Appends count records of two hashes each to bucket
+    void write(int bucket, const uint64_t* hashes, size_t count){
+        std::lock_guard<std::mutex> guard(locks[bucket]);
+        if(fwrite(hashes, 2*sizeof(uint64_t), count, files[bucket]) != count){
+            fprintf(stderr, "Could not write to bucket file %s: %s\n", names[bucket].c_str(), strerror(errno));
+            exit(1);
         }
-        if(fastq) getline(solidReads, read),getline(solidReads, read); //ignore two more lines if its fastq
+        records[bucket] += count;
     }
+};
 
-    solidReads.close();
-    printf("\n");
+//The records of each bucket from one batch of reads, held until the batches before it are written
+struct BucketBuffers{
+    std::vector<std::vector<uint64_t> > hashes;
+
+    BucketBuffers(int count) : hashes(count) {}
+
+    void add(int bucket, uint64_t hashA, uint64_t hashB){
+        hashes[bucket].push_back(hashA);
+        hashes[bucket].push_back(hashB);
+    }
+
+    void flush(BloomBuckets& buckets, int bucket){
+        if(!hashes[bucket].empty()){
+            buckets.write(bucket, hashes[bucket].data(), hashes[bucket].size()/2);
+            hashes[bucket].clear();
+        }
+    }
+};
+
+//Loads one bucket, whose kmers all fall in the same slice of bloo1 and bloo2, reading its file in order
+static void load_bucket(Bloom* bloo1, Bloom* bloo2, FILE* file){
+    const size_t chunk = 1 << 16;
+    std::vector<uint64_t> hashes(2*chunk);
+    rewind(file);
+    size_t count;
+    while((count = fread(hashes.data(), 2*sizeof(uint64_t), chunk, file)) > 0){
+        for(size_t i = 0; i < count && i < BLOOM_PREFETCH_DISTANCE; i++){
+            bloo1->prefetch(hashes[2*i], hashes[2*i + 1]);
+            bloo2->prefetch(hashes[2*i], hashes[2*i + 1]);
+        }
+        for(size_t i = 0; i < count; i++){
+            if(i + BLOOM_PREFETCH_DISTANCE < count){
+                size_t ahead = 2*(i + BLOOM_PREFETCH_DISTANCE);
+                bloo1->prefetch(hashes[ahead], hashes[ahead + 1]);
+                bloo2->prefetch(hashes[ahead], hashes[ahead + 1]);
+            }
+            uint64_t hashA = hashes[2*i], hashB = hashes[2*i + 1];
+            if(bloo1->contains(hashA, hashB)){
+                bloo2->add(hashA, hashB);
+            }
+            else{
+                bloo1->add(hashA, hashB);
+            }
+        }
+    }
+}
+
+void load_two_filters_bucketed(Bloom* bloo1, Bloom* bloo2, string reads_filename, bool fastq, string bucket_dir, int buckets, int threads, string spool_filename){
+    int layout = bloo1->getLayout();
+    if((layout != BLOOM_BLOCKED && layout != BLOOM_MINIMIZER) || bloo2->getLayout() != layout
+       || bloo1->getBlockCount() != bloo2->getBlockCount() || bloo1->isScalable() || bloo2->isScalable()){
+        fprintf(stderr, "A bucketed load needs two blocked filters of the same size, without sub-filters\n");
+        exit(1);
+    }
+    time_t start, stop;
+    time(&start);
+    uint64_t blockCount = bloo1->getBlockCount();
+    if(buckets <= 0){
+        buckets = (int)std::min<uint64_t>(BLOOM_MAX_BUCKETS, (blockCount*BLOOM_BLOCK_BYTES + BLOOM_BUCKET_SLICE - 1)/BLOOM_BUCKET_SLICE);
+    }
+    buckets = (int)std::max<uint64_t>(1, std::min<uint64_t>(std::min(buckets, BLOOM_MAX_BUCKETS), blockCount));
+    printf("Weights before load: %f, %f \n", bloo1->weight(), bloo2->weight());
+    printf("Bucketed load: %d buckets in %s, %.2f MB of each filter per bucket\n", buckets, bucket_dir.c_str(),
+        blockCount*BLOOM_BLOCK_BYTES/(1024.0*1024.0)/buckets);
+
+    //phase one: hash the reads and sort the hashes into buckets by block
+    BloomBuckets files(bucket_dir, buckets);
+    SpoolWriter* spool = open_spool(spool_filename);
+    //the workers sort a round of batches into buffers of their batch, which are written bucket by bucket in file
+    //order once the round is read, so the buckets and the filters loaded from them are the same for any threads
+    std::vector<BucketBuffers> round(std::max(threads, 1), BucketBuffers(buckets));
+    std::vector<BucketBuffers*> current(std::max(threads, 1));
+    LoadRounds rounds;
+    rounds.batches = round.size();
+    rounds.startBatch = [&](int worker, int slot){
+        current[worker] = &round[slot];
+    };
+    rounds.resolve = [&](int count){
+        parallel_items(buckets, threads, [&](int bucket){
+            for(int slot = 0; slot < count; slot++){
+                round[slot].flush(files, bucket);
+            }
+        });
+    };
+    load_reads(reads_filename, fastq, threads, [&](ReadSpan read, int worker){
+        int count = readHashes.compute(bloo1, read);
+        for(int i = 0; i < count; i++){
+            uint64_t hashA = readHashes.hashA[i], hashB = readHashes.hashB[i];
+            int bucket = (int)(bloo1->getBlockIndex(hashA) * buckets / blockCount);
+            current[worker]->add(bucket, hashA, hashB);
+        }
+    }, spool, &rounds);
+    close_spool(spool);
+    uint64_t records = 0;
+    for(int i = 0; i < buckets; i++){
+        records += files.records[i];
+        fflush(files.files[i]);
+    }
+    time(&stop);
+    printf("Bucketed %llu kmers, %.2f MB on disk, in %f s\n", (unsigned long long)records,
+        records*2*sizeof(uint64_t)/(1024.0*1024.0), difftime(stop,start));
+
+    //phase two: load the buckets one slice at a time; buckets cover separate blocks, so threads don't share any bits
+    std::atomic<int> nextBucket(0);
+    auto worker = [&](){
+        int bucket;
+        while((bucket = nextBucket++) < buckets){
+            load_bucket(bloo1, bloo2, files.files[bucket]);
+            fclose(files.files[bucket]);
+            remove(files.names[bucket].c_str());
+        }
+    };
+    if(threads > 1){
+        std::vector<std::thread> workers;
+        for(int i = 0; i < std::min(threads, buckets); i++){
+            workers.push_back(std::thread(worker));
+        }
+        for(auto& t : workers){
+            t.join();
+        }
+    }
+    else{
+        worker();
+    }
     printf("Weights after load: %f, %f \n", bloo1->weight(), bloo2->weight());
-    printf("Reads processed: %d\n", readsProcessed);
-    printf("Unambiguous reads: %lli\n", unambiguousReads);
     time(&stop);
     printf("Time to load: %f \n", difftime(stop,start));
 }
 
-void load_single_filter(Bloom* bloo1, string reads_filename, bool fastq){
-    ifstream solidReads;
-    solidReads.open(reads_filename);
-    int readsProcessed = 0;
-    string read;
+void load_counting_filter(Bloom* bloom, string reads_filename, bool fastq, int threads, string spool_filename){
     time_t start, stop;
     time(&start);
-    printf("Weight before load: %f\n", bloo1->weight());
-    uint64_t hashA, hashB;
-    kmer_type canonKmer;
-    uint64_t unambiguousReads = 0;
+    SpoolWriter* spool = open_spool(spool_filename);
+    printf("Weight before load: %f\n", bloom->weight());
+    if(threads > 1){
+        printf("Loading with %d threads\n", threads);
+    }
+    load_reads(reads_filename, fastq, threads, [&](ReadSpan read, int){
+        if(threads > 1){
+            bloom->atomic_add_read(read);
+        }
+        else{
+            bloom->add_read(read);
+        }
+    }, spool);
+    close_spool(spool);
+    printf("Weight after load: %f\n", bloom->weight());
+    time(&stop);
+    printf("Time to load: %f \n", difftime(stop,start));
+}
 
-    while (getline(solidReads, read))
-    {
-        getline(solidReads, read);//since it's a fasta or fastq we skip the first of every pair of lines
-        std::list<string> readList = getUnambiguousReads(read);
-        while(!readList.empty()){
-            read = readList.front();
-            readList.pop_front();
-            unambiguousReads++;
-            for(ReadKmer kmer = ReadKmer(&read); kmer.getDistToEnd() >= 0 ; kmer.forward(), kmer.forward()){
-                canonKmer = kmer.getCanon();
-                hashA = bloo1->oldHash(canonKmer, 0);
-                hashB = bloo1->oldHash(canonKmer, 1);                                
-                bloo1->add(hashA, hashB);                
-            }    
+//Exact counts of the kmer hashes with their top level bits at 0, see estimate_kmer_counts
+struct KmerSample{
+    std::unordered_map<uint64_t, uint32_t> counts;
+    int level;
+    size_t maxSize;
+
+    KmerSample(size_t maxSize) : level(0), maxSize(maxSize) {}
+
+    static bool sampled(uint64_t hash, int level){
+        return level == 0 || (hash >> (64 - level)) == 0;
+    }
+
+    void add(uint64_t hash){
+        if(!sampled(hash, level)){
+            return;
+        }
+        counts[hash]++;
+        if(counts.size() > maxSize){
+            raise(level + 1);
         }
-        readsProcessed++;
-        if ((readsProcessed%10000)==0) fprintf (stderr,"%c %lld",13,(long long)readsProcessed);        
-        if(fastq) getline(solidReads, read),getline(solidReads, read); //ignore two more lines if its fastq
     }
-    solidReads.close();
-    printf("\n");
+
+    //Drops the hashes that aren't sampled at newLevel.  The ones that are were sampled from the start, so their counts are exact.
+    void raise(int newLevel){
+        level = newLevel;
+        for(auto it = counts.begin(); it != counts.end(); ){
+            if(sampled(it->first, level)){
+                it++;
+            }
+            else{
+                it = counts.erase(it);
+            }
+        }
+    }
+};
+
+void estimate_kmer_counts(string reads_filename, bool fastq, uint64_t& distinct, uint64_t& singletons, int threads, string spool_filename){
+    time_t start, stop;
+    time(&start);
+    SpoolWriter* spool = open_spool(spool_filename);
+    printf("Estimating kmer counts from %s\n", reads_filename.c_str());
+
+    //one sample per worker, made on its first read
+    size_t maxSize = std::max<size_t>(ESTIMATE_SAMPLES / std::max(threads, 1), 1 << 16);
+    std::vector<KmerSample*> samples(std::max(threads, 1), nullptr);
+
+    load_reads(reads_filename, fastq, threads, [&](ReadSpan read, int worker){
+        if(!samples[worker]){
+            samples[worker] = new KmerSample(maxSize);
+        }
+        KmerSample* sample = samples[worker];
+        std::vector<kmer_type>& kmers = readHashes.kmers;
+        getCanonKmers(read, kmers);
+        for(kmer_type kmer : kmers){
+            sample->add(Bloom::finalize(kmer));
+        }
+    }, spool);
+    close_spool(spool);
+
+    //a hash sampled at the highest level was sampled by every thread, so its counts add up exactly
+    int level = 0;
+    for(KmerSample* s : samples){
+        if(s) level = std::max(level, s->level);
+    }
+    std::unordered_map<uint64_t, uint32_t> counts;
+    for(KmerSample* s : samples){
+        if(!s){
+            continue;
+        }
+        for(auto& entry : s->counts){
+            if(KmerSample::sampled(entry.first, level)){
+                counts[entry.first] += entry.second;
+            }
+        }
+        delete s;
+    }
+    uint64_t sampledSingletons = 0;
+    for(auto& entry : counts){
+        if(entry.second == 1){
+            sampledSingletons++;
+        }
+    }
+    distinct = (uint64_t)counts.size() << level;
+    singletons = sampledSingletons << level;
+    printf("Estimated %llu distinct kmers, %llu of them singletons, from 1 in %llu kmer hashes\n",
+        (unsigned long long)distinct, (unsigned long long)singletons, 1ULL << level);
+    time(&stop);
+    printf("Time to estimate: %f \n", difftime(stop,start));
+}
+
+void load_kmer_db(Bloom* bloom, string db_filename, uint32_t min_count, int threads){
+    time_t start, stop;
+    time(&start);
+    KmerDB db(db_filename);
+    if(db.getK() != sizeKmer){
+        fprintf(stderr, "Kmer database %s was built with k = %d, but k is %d\n", db_filename.c_str(), db.getK(), sizeKmer);
+        exit(1);
+    }
+    printf("Weight before load: %f\n", bloom->weight());
+    uint64_t records = db.size();
+    threads = (int)std::max<uint64_t>(1, std::min<uint64_t>(threads, records / BLOOM_WINDOW + 1));
+    std::atomic<uint64_t> solid(0);
+    auto worker = [&](uint64_t first, uint64_t last){
+        bloom_elem kmers[BLOOM_WINDOW];
+        uint64_t hashA[BLOOM_WINDOW], hashB[BLOOM_WINDOW];
+        uint64_t localSolid = 0;
+        int count = 0;
+        auto addKmers = [&](){
+            bloom->hash_batch(kmers, count, hashA, hashB);
+            if(threads > 1){
+                bloom->atomic_add_hashes(hashA, hashB, count);
+            }
+            else{
+                bloom->add_hashes(hashA, hashB, count);
+            }
+            localSolid += count;
+            count = 0;
+        };
+        for(uint64_t i = first; i < last; i++){
+            if(db.count(i) >= min_count){
+                kmers[count++] = db.kmer(i);
+                if(count == BLOOM_WINDOW) addKmers();
+            }
+        }
+        if(count > 0) addKmers();
+        solid += localSolid;
+    };
+    if(threads > 1){
+        std::vector<std::thread> workers;
+        for(int i = 0; i < threads; i++){
+            workers.push_back(std::thread(worker, records*i/threads, records*(i + 1)/threads));
+        }
+        for(auto& t : workers){
+            t.join();
+        }
+    }
+    else{
+        worker(0, records);
+    }
+    printf("Kmers in the database: %llu, at least %u times: %llu\n", (unsigned long long)records, min_count,
+        (unsigned long long)solid);
+    printf("Weight after load: %f\n", bloom->weight());
+    time(&stop);
+    printf("Time to load: %f \n", difftime(stop,start));
+}
+
+void load_single_filter(Bloom* bloo1, string reads_filename, bool fastq, int threads){
+    time_t start, stop;
+    time(&start);
+    printf("Weight before load: %f\n", bloo1->weight());
+    if(threads > 1){
+        printf("Loading with %d threads\n", threads);
+    }
+    load_reads(reads_filename, fastq, threads, [&](ReadSpan read, int){
+        if(threads > 1){
+            bloo1->atomic_add_read(read);
+        }
+        else{
+            bloo1->add_read(read);
+        }
+    });
     printf("Weight after load: %f\n", bloo1->weight());
-    printf("Reads processed: %d\n", readsProcessed);
-    printf("Unambiguous reads: %lli\n", unambiguousReads);
     time(&stop);
     printf("Time to load: %f \n", difftime(stop,start));
 }
 
 void Bloom::load_from_reads(const char* reads_filename){
-    ifstream solidReads;
-    solidReads.open(reads_filename);
+    SeqReader reader(reads_filename, false);
+    SeqBatch batch;
 
     int readsProcessed = 0;
 
-    //should fix this.. just because right now there's no empty constructor
-    string fake = "FAKE";
-    ReadKmer kmer(&fake);
-
-    string read;
     time_t start, stop;
     time(&start);
     printf("Weight before load: %f \n", weight());
-    while (getline(solidReads, read))
+    while (reader.nextBatch(batch, READ_BATCH_SIZE) > 0)
     {
-        getline(solidReads, read);//since it's a fasta we skip the first of every pair of lines
-        for(kmer = ReadKmer(&read); kmer.getDistToEnd() >= 0 ; kmer.forward(), kmer.forward()){
-            oldAdd(kmer.getCanon());
-        }    
-        readsProcessed++;
-        if ((readsProcessed%10000)==0) fprintf (stderr,"%c %lld",13,(long long)readsProcessed);
+        for(ReadSpan read : batch.reads){
+            if(read.length < sizeKmer) continue;
+            for(ReadKmer kmer = ReadKmer(read); kmer.getDistToEnd() >= 0 ; kmer.forward(), kmer.forward()){
+                oldAdd(kmer.getCanon());
+            }    
+            readsProcessed++;
+            if ((readsProcessed%10000)==0) fprintf (stderr,"%c %lld",13,(long long)readsProcessed);
+        }
     }
 
-    solidReads.close();
     printf("\n");
     printf("Weight after load: %f \n", weight()); 
     time(&stop);
@@ -473,7 +1861,25 @@ Bloom::Bloom()
 {
     //empty default constructor
     nb_elem = 0;
+    layout = BLOOM_CLASSIC;
+    exactSize = false;
+    threshold = 1;
+    hashMode = BLOOM_HASH_OLD;
+    mappedFile = NULL;
+    mappedLength = 0;
+    allocatedMap = NULL;
+    allocatedLength = 0;
+    frozenPairs = NULL;
+    pairKeys = NULL;
+    scalable = false;
+    capacity = 0;
+    designFpRate = 0;
+    itemsAdded = 0;
+    subFilterCount = 0;
+    folds = 0;
     blooma = NULL;
+    minimizerSize = 0;
+    mmerMask = 0;
 }
 
 void Bloom::setSeed(uint64_t seed)
@@ -564,15 +1970,132 @@ uint64_t Bloom::get_rolling_hash(uint64_t key, int num_hash)
 Bloom::~Bloom()
 {
     valid_set.clear();
-  if(blooma!=NULL) 
+  for(int i = 0; i < subFilterCount; i++)
+    delete subFilters[i];
+  releaseBits();
+  delete frozenPairs;
+  delete pairKeys;
+}
+
+void Bloom::releaseBits()
+{
+  if(mappedFile!=NULL)
+    munmap(mappedFile, mappedLength);
+  else if(allocatedMap!=NULL)
+    munmap(allocatedMap, allocatedLength);
+  else if(blooma!=NULL && frozenPairs==NULL)
     free(blooma);
+  mappedFile = NULL;
+  allocatedMap = NULL;
+  blooma = NULL;
+}
+
+//Header of a dump, written in the byte order of the machine.  Fields added later go in the reserved space and read
+//as 0 from older version 1 dumps, so 0 must mean the old behaviour.
+struct BloomFileHeader{
+    char magic[8]; //BLOOM_FILE_MAGIC, without the terminating 0
+    uint32_t version;
+    uint32_t headerSize; //offset of the bit array in the file
+    uint32_t k;
+    uint32_t numHash;
+    uint64_t seed;
+    uint64_t tai; //bits in the filter
+    uint64_t nchar; //bytes in the bit array
+    uint64_t bloomMask;
+    int32_t hashSize;
+    uint32_t layout;
+    uint32_t exactSize;
+    uint32_t threshold;
+    uint32_t hashMode; //BLOOM_HASH_OLD in older dumps
+    //the XorFilter of a BLOOM_FROZEN_PAIRS dump, whose bit array is the fingerprints
+    uint32_t segmentLength;
+    uint64_t frozenSeed;
+    uint64_t segmentCount;
+    uint64_t frozenKeys;
+    //sub-filters of a scalable filter, each dumped after the one before as a header and bit array of its own, starting
+    //at the next multiple of BLOOM_FILE_HEADER_SIZE so it can be mapped on its own
+    uint32_t subFilters;
+    uint32_t folds; //times the filter was folded before the dump, so tai is the size it was created with over 2^folds
+    uint32_t minimizerSize; //of a BLOOM_MINIMIZER filter
+    char reserved[BLOOM_FILE_HEADER_SIZE - 116];
+};
+static_assert(sizeof(BloomFileHeader) == BLOOM_FILE_HEADER_SIZE, "Bloom file header must fill its page");
+
+//Reads the header at the start of file.  Returns false, with the file rewound, if the file has no header.
+//Exits if the header is from a newer version.
+static bool read_bloom_header(FILE* file, const char* filename, BloomFileHeader& header){
+    memset(&header, 0, sizeof(header));
+    size_t got = fread(&header, 1, sizeof(header), file);
+    if(got < sizeof(header.magic) || memcmp(header.magic, BLOOM_FILE_MAGIC, sizeof(header.magic)) != 0){
+        rewind(file);
+        return false;
+    }
+    if(got < sizeof(header) || header.version > BLOOM_FILE_VERSION || header.headerSize < sizeof(header)){
+        fprintf(stderr, "Bloom file %s has an unsupported header (version %u)\n", filename, header.version);
+        exit(1);
+    }
+    fseek(file, header.headerSize, SEEK_SET);
+    return true;
+}
+
+//Offset of the sub-filter dumped after a filter that starts at offset with the given header
+static uint64_t next_dump_offset(uint64_t offset, const BloomFileHeader& header){
+    uint64_t end = offset + header.headerSize + header.nchar;
+    return (end + BLOOM_FILE_HEADER_SIZE - 1) / BLOOM_FILE_HEADER_SIZE * BLOOM_FILE_HEADER_SIZE;
 }
 
 void Bloom::dump(char * filename)
 {
  FILE *file_data;
  file_data = fopen(filename,"wb");
- fwrite(blooma, sizeof(unsigned char), nchar, file_data); //1+
+ if(!file_data){
+    fprintf(stderr, "Could not write the bloom filter to %s: %s\n", filename, strerror(errno));
+    exit(1);
+ }
+ bool written = true;
+ uint64_t offset = 0;
+ for(int i = -1; i < subFilterCount; i++){
+    Bloom* filter = i < 0 ? this : subFilters[i];
+    BloomFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BLOOM_FILE_MAGIC, sizeof(header.magic));
+    header.version = BLOOM_FILE_VERSION;
+    header.headerSize = BLOOM_FILE_HEADER_SIZE;
+    header.k = k;
+    header.numHash = filter->n_hash_func;
+    header.seed = user_seed;
+    header.tai = filter->tai;
+    header.nchar = filter->nchar;
+    header.bloomMask = bloomMask;
+    header.hashSize = hashSize;
+    header.layout = layout;
+    header.exactSize = exactSize;
+    header.threshold = threshold;
+    header.hashMode = hashMode;
+    if(layout == BLOOM_MINIMIZER){
+       header.minimizerSize = minimizerSize;
+    }
+    if(frozenPairs){
+       header.segmentLength = frozenPairs->getSegmentLength();
+       header.frozenSeed = frozenPairs->getSeed();
+       header.segmentCount = frozenPairs->getSegmentCount();
+       header.frozenKeys = frozenPairs->getKeyCount();
+    }
+    if(i < 0){
+       header.subFilters = subFilterCount;
+       header.folds = folds;
+    }
+    else{
+       fseek(file_data, offset, SEEK_SET);
+    }
+    written &= fwrite(&header, sizeof(header), 1, file_data) == 1;
+    written &= fwrite(filter->blooma, sizeof(unsigned char), filter->nchar, file_data) == filter->nchar;
+    offset = next_dump_offset(offset, header);
+ }
+ if(!written || fclose(file_data) != 0){
+    fprintf(stderr, "Could not write the bloom filter to %s: %s\n", filename, strerror(errno));
+    exit(1);
+ }
  printf("bloom dumped \n");
 
 }
@@ -581,7 +2104,431 @@ void Bloom::load(char * filename)
 {
  FILE *file_data;
  file_data = fopen(filename,"rb");
+ if(!file_data){
+    fprintf(stderr, "Could not open bloom file %s: %s\n", filename, strerror(errno));
+    exit(1);
+ }
+ BloomFileHeader header;
+ if(read_bloom_header(file_data, filename, header)){
+    //a folded dump is read into this filter folded the same way, which is still empty
+    while(folds < (int)header.folds && header.tai < tai && fold()){
+    }
+    if((int)header.k != k || header.tai != tai || (int)header.numHash != n_hash_func || (int)header.layout != layout
+       || header.exactSize != exactSize || header.seed != user_seed || (int)header.hashMode != hashMode || header.subFilters != 0
+       || (layout == BLOOM_MINIMIZER && (int)header.minimizerSize != minimizerSize)){
+        fprintf(stderr, "Bloom file %s does not match the filter it is loaded into: it has k %u, %llu bits, %u hash functions, layout %u, hash mode %u, %u sub-filters\n",
+            filename, header.k, (unsigned long long)header.tai, header.numHash, header.layout, header.hashMode, header.subFilters);
+        exit(1);
+    }
+ }
  printf("loading bloom filter from file, nelem %lli \n",nchar);
- int a = fread(blooma, sizeof(unsigned char), nchar, file_data);// go away warning..
+ if(fread(blooma, sizeof(unsigned char), nchar, file_data) != nchar){
+    fprintf(stderr, "Bloom file %s is truncated: expected %llu bytes of filter\n", filename, (unsigned long long)nchar);
+    exit(1);
+ }
+ fclose(file_data);
  printf("bloom loaded\n");
 }
+
+Bloom* Bloom::open_dump(const char* filename)
+{
+    FILE* file = fopen(filename, "rb");
+    if(!file){
+        fprintf(stderr, "Could not open bloom file %s: %s\n", filename, strerror(errno));
+        exit(1);
+    }
+    BloomFileHeader header;
+    bool hasHeader = read_bloom_header(file, filename, header);
+    fclose(file);
+    if(!hasHeader){
+        return nullptr;
+    }
+    if((int)header.k != sizeKmer){
+        fprintf(stderr, "Bloom file %s was built with k = %u, but k is %d\n", filename, header.k, sizeKmer);
+        exit(1);
+    }
+
+    int fd = open(filename, O_RDONLY);
+    struct stat info;
+    if(fd < 0 || fstat(fd, &info) != 0){
+        fprintf(stderr, "Bloom file %s is truncated\n", filename);
+        exit(1);
+    }
+    //maps the filter whose header is at offset
+    auto mapFilter = [&](const BloomFileHeader& header, uint64_t offset){
+        uint64_t length = header.headerSize + header.nchar;
+        if((uint64_t)info.st_size < offset + length){
+            fprintf(stderr, "Bloom file %s is truncated\n", filename);
+            exit(1);
+        }
+        void* map = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, offset);
+        if(map == MAP_FAILED){
+            fprintf(stderr, "Could not map bloom file %s: %s\n", filename, strerror(errno));
+            exit(1);
+        }
+        madvise(map, length, MADV_WILLNEED);
+
+        Bloom* bloom = new Bloom();
+        bloom->fake = false;
+        bloom->k = header.k;
+        bloom->n_hash_func = header.numHash;
+        bloom->user_seed = header.seed;
+        bloom->tai = header.tai;
+        bloom->nchar = header.nchar;
+        bloom->bloomMask = header.bloomMask;
+        bloom->hashSize = header.hashSize;
+        bloom->layout = header.layout;
+        bloom->exactSize = header.exactSize;
+        bloom->threshold = header.threshold ? header.threshold : 1;
+        bloom->hashMode = header.hashMode;
+        bloom->setMinimizerSize(header.minimizerSize);
+        bloom->blockCount = header.tai/BLOOM_BLOCK_BITS;
+        bloom->folds = header.folds;
+        bloom->mappedFile = (unsigned char*)map;
+        bloom->mappedLength = length;
+        bloom->blooma = (unsigned char*)map + header.headerSize;
+        bloom->generate_hash_seed();
+        return bloom;
+    };
+    Bloom* bloom = mapFilter(header, 0);
+    if(header.subFilters > BLOOM_MAX_SUBFILTERS){
+        fprintf(stderr, "Bloom file %s has %u sub-filters, more than %d\n", filename, header.subFilters, BLOOM_MAX_SUBFILTERS);
+        exit(1);
+    }
+    uint64_t offset = next_dump_offset(0, header);
+    for(uint32_t i = 0; i < header.subFilters; i++){
+        BloomFileHeader subHeader;
+        if(pread(fd, &subHeader, sizeof(subHeader), offset) != sizeof(subHeader)
+           || memcmp(subHeader.magic, BLOOM_FILE_MAGIC, sizeof(subHeader.magic)) != 0){
+            fprintf(stderr, "Bloom file %s is missing sub-filter %u\n", filename, i + 1);
+            exit(1);
+        }
+        bloom->subFilters[i] = mapFilter(subHeader, offset);
+        offset = next_dump_offset(offset, subHeader);
+    }
+    bloom->subFilterCount = header.subFilters;
+    close(fd);
+    if(bloom->layout == BLOOM_FROZEN_PAIRS){
+        bloom->frozenPairs = new XorFilter(bloom->blooma, header.frozenSeed, header.segmentLength, header.segmentCount, header.frozenKeys);
+        printf("Mapped frozen pair filter %s: %llu pairs\n", filename, (unsigned long long)header.frozenKeys);
+        return bloom;
+    }
+    if(bloom->layout == BLOOM_EXACT){
+        printf("Mapped exact kmer set %s: %llu slots, threshold %d\n", filename, (unsigned long long)(bloom->tai/64), bloom->threshold);
+        return bloom;
+    }
+    printf("Mapped bloom file %s: %llu bits, %d hash functions, layout %d, %s hash\n", filename,
+        (unsigned long long)bloom->tai, bloom->n_hash_func, bloom->layout, bloom->hashMode == BLOOM_HASH_ROLLING ? "rolling" : "old");
+    if(header.subFilters){
+        printf("Mapped %u sub-filters of a scalable filter\n", header.subFilters);
+    }
+    return bloom;
+}
+
+bool Bloom::isMapped(){
+    return mappedFile != NULL;
+}
+
+void Bloom::checkMergeable(Bloom* other){
+    if(fake || frozenPairs || subFilterCount || scalable || folds || layout == BLOOM_EXACT){
+        fprintf(stderr, "Only plain filters can be merged, not folded, scalable or frozen ones, nor exact kmer sets\n");
+        exit(1);
+    }
+    if(other->k != k || other->tai != tai || other->layout != layout || other->exactSize != exactSize
+       || other->n_hash_func != n_hash_func || other->hashMode != hashMode || other->minimizerSize != minimizerSize
+       || other->user_seed != user_seed || other->fake || other->frozenPairs || other->subFilterCount || other->folds){
+        fprintf(stderr, "The filters to merge were built with different settings\n");
+        exit(1);
+    }
+}
+
+Bloom* Bloom::emptyMergeTarget(){
+    //the lane's geometry is taken as it is, since the sizing constructor would round a power of two size up again
+    Bloom* merged = new Bloom();
+    merged->fake = false;
+    merged->k = k;
+    merged->n_hash_func = n_hash_func;
+    merged->user_seed = user_seed;
+    merged->tai = tai;
+    merged->nchar = nchar;
+    merged->bloomMask = bloomMask;
+    merged->hashSize = hashSize;
+    merged->layout = layout;
+    merged->exactSize = exactSize;
+    merged->threshold = threshold;
+    merged->hashMode = hashMode;
+    merged->setMinimizerSize(minimizerSize);
+    merged->blockCount = blockCount;
+    merged->blooma = merged->allocate(nchar);
+    merged->generate_hash_seed();
+    return merged;
+}
+
+//Calls merge on consecutive ranges of bytes bytes, block aligned, from up to threads threads
+static void merge_regions(uint64_t bytes, int threads, std::function<void (uint64_t, uint64_t)> merge){
+    uint64_t blocks = (bytes + BLOOM_BLOCK_BYTES - 1) / BLOOM_BLOCK_BYTES;
+    threads = (int)std::max<uint64_t>(1, std::min<uint64_t>(threads, blocks));
+    std::vector<std::thread> workers;
+    for(int i = 0; i < threads; i++){
+        uint64_t start = std::min(bytes, blocks*i/threads*BLOOM_BLOCK_BYTES);
+        uint64_t end = std::min(bytes, blocks*(i + 1)/threads*BLOOM_BLOCK_BYTES);
+        if(threads == 1){
+            merge(start, end);
+        }
+        else{
+            workers.push_back(std::thread(merge, start, end));
+        }
+    }
+    for(auto& t : workers){
+        t.join();
+    }
+}
+
+void Bloom::merge_two_filters(const std::vector<Bloom*>& lanes1, const std::vector<Bloom*>& lanes2, Bloom*& merged1, Bloom*& merged2, int threads){
+    if(lanes1.empty() || lanes1.size() != lanes2.size()){
+        fprintf(stderr, "Merging needs both filters of every lane\n");
+        exit(1);
+    }
+    Bloom* first = lanes1[0];
+    if(first->layout == BLOOM_COUNTING){
+        fprintf(stderr, "Counting filters are merged with merge_counting_filters\n");
+        exit(1);
+    }
+    for(size_t i = 0; i < lanes1.size(); i++){
+        first->checkMergeable(lanes1[i]);
+        first->checkMergeable(lanes2[i]);
+    }
+    merged1 = first->emptyMergeTarget();
+    merged2 = first->emptyMergeTarget();
+    unsigned char* seen = merged1->blooma;
+    unsigned char* solid = merged2->blooma;
+    merge_regions(first->nchar, threads, [&](uint64_t start, uint64_t end){
+        for(size_t lane = 0; lane < lanes1.size(); lane++){
+            const unsigned char* once = lanes1[lane]->blooma;
+            const unsigned char* twice = lanes2[lane]->blooma;
+            for(uint64_t i = start; i < end; i++){
+                //a bit already seen in an earlier lane and seen again in this one is solid
+                solid[i] |= (seen[i] & once[i]) | twice[i];
+                seen[i] |= once[i];
+            }
+        }
+    });
+}
+
+//Sums of two bytes of four 2 bit counters, each saturating at BLOOM_MAX_COUNT
+struct CounterSumTable{
+    unsigned char sums[256][256];
+    CounterSumTable(){
+        for(int a = 0; a < 256; a++){
+            for(int b = 0; b < 256; b++){
+                int sum = 0;
+                for(int c = 0; c < 4; c++){
+                    int count = std::min(((a >> 2*c) & 3) + ((b >> 2*c) & 3), BLOOM_MAX_COUNT);
+                    sum |= count << 2*c;
+                }
+                sums[a][b] = sum;
+            }
+        }
+    }
+};
+
+Bloom* Bloom::merge_counting_filters(const std::vector<Bloom*>& lanes, int threads){
+    if(lanes.empty() || lanes[0]->layout != BLOOM_COUNTING){
+        fprintf(stderr, "merge_counting_filters needs counting filters\n");
+        exit(1);
+    }
+    for(size_t i = 0; i < lanes.size(); i++){
+        lanes[0]->checkMergeable(lanes[i]);
+    }
+    static CounterSumTable table;
+    Bloom* merged = lanes[0]->emptyMergeTarget();
+    unsigned char* counters = merged->blooma;
+    merge_regions(merged->nchar, threads, [&](uint64_t start, uint64_t end){
+        for(Bloom* lane : lanes){
+            const unsigned char* laneCounters = lane->blooma;
+            for(uint64_t i = start; i < end; i++){
+                counters[i] = table.sums[counters[i]][laneCounters[i]];
+            }
+        }
+    });
+    return merged;
+}
+
+int Bloom::allocPages = BLOOM_PAGES_SMALL;
+int Bloom::allocNuma = BLOOM_NUMA_NONE;
+int Bloom::allocThreads = 1;
+
+void Bloom::setAllocationPolicy(int pages, int numa, int threads){
+    allocPages = pages;
+    allocNuma = numa;
+    allocThreads = std::max(threads, 1);
+}
+
+//Online NUMA nodes, from a list like "0-1,3"
+static std::vector<int> numa_nodes(){
+    std::vector<int> nodes;
+    FILE* file = fopen("/sys/devices/system/node/online", "r");
+    if(file){
+        int first, last;
+        while(fscanf(file, "%d", &first) == 1){
+            last = first;
+            int c = fgetc(file);
+            if(c == '-' && fscanf(file, "%d", &last) == 1){
+                c = fgetc(file);
+            }
+            for(int node = first; node <= last; node++){
+                nodes.push_back(node);
+            }
+            if(c != ','){
+                break;
+            }
+        }
+        fclose(file);
+    }
+    if(nodes.empty()){
+        nodes.push_back(0);
+    }
+    return nodes;
+}
+
+//The bracketed choice of /sys/kernel/mm/transparent_hugepage/enabled: always, madvise or never
+static string thp_setting(){
+    char line[256] = "";
+    FILE* file = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if(!file){
+        return "unsupported";
+    }
+    if(!fgets(line, sizeof(line), file)){
+        line[0] = 0;
+    }
+    fclose(file);
+    char* start = strchr(line, '[');
+    char* end = start ? strchr(start, ']') : NULL;
+    return end ? string(start + 1, end) : "unknown";
+}
+
+//Sets the memory policy of [addr, addr + length) with the mbind system call, which glibc doesn't wrap.
+//Returns false if the kernel refused it.
+static bool bind_memory(void* addr, uint64_t length, int mode, const std::vector<int>& nodes){
+    const int MAX_NODES = 1024;
+    unsigned long mask[MAX_NODES/64] = {0};
+    for(int node : nodes){
+        if(node < MAX_NODES){
+            mask[node/64] |= 1UL << (node%64);
+        }
+    }
+    return syscall(SYS_mbind, addr, length, mode, mask, (unsigned long)MAX_NODES, 0) == 0;
+}
+#define BLOOM_MPOL_BIND 2
+#define BLOOM_MPOL_INTERLEAVE 3
+
+//Zeroes data on up to threads threads, each taking a contiguous part, so the page faults are taken in parallel and,
+//without a NUMA policy, each part lands on the node of the thread that zeroes it.
+static void zero_parallel(unsigned char* data, uint64_t bytes, int threads){
+    const uint64_t minPart = 16*BLOOM_HUGE_PAGE_BYTES;
+    threads = (int)std::min<uint64_t>(threads, std::max<uint64_t>(bytes/minPart, 1));
+    if(threads <= 1){
+        memset(data, 0, bytes);
+        return;
+    }
+    uint64_t part = (bytes/threads + BLOOM_HUGE_PAGE_BYTES - 1) / BLOOM_HUGE_PAGE_BYTES * BLOOM_HUGE_PAGE_BYTES;
+    std::vector<std::thread> workers;
+    for(int i = 0; i < threads; i++){
+        uint64_t start = std::min(bytes, i*part);
+        uint64_t end = std::min(bytes, start + part);
+        workers.push_back(std::thread([=](){ memset(data + start, 0, end - start); }));
+    }
+    for(auto& worker : workers){
+        worker.join();
+    }
+}
+
+unsigned char* Bloom::allocate(uint64_t bytes){
+    unsigned char* data;
+    if(allocPages == BLOOM_PAGES_SMALL && allocNuma == BLOOM_NUMA_NONE){
+        if(posix_memalign((void**)&data, BLOOM_BLOCK_BYTES, bytes) != 0){
+            fprintf(stderr, "Could not allocate %llu bytes for the bloom filter\n", (unsigned long long)bytes);
+            exit(1);
+        }
+        zero_parallel(data, bytes, allocThreads);
+        return data;
+    }
+
+    //mbind and madvise work on whole pages, so these policies map the array directly
+    uint64_t pageSize = (allocPages == BLOOM_PAGES_SMALL) ? (uint64_t)sysconf(_SC_PAGESIZE) : BLOOM_HUGE_PAGE_BYTES;
+    uint64_t length = std::max<uint64_t>((bytes + pageSize - 1) / pageSize * pageSize, pageSize);
+    void* map = MAP_FAILED;
+    string pages;
+    if(allocPages == BLOOM_PAGES_HUGETLB){
+        map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(map == MAP_FAILED){
+            pages = string("explicit huge pages unavailable (") + strerror(errno) + "), ";
+        }
+        else{
+            pages = "explicit huge pages";
+        }
+    }
+    if(map == MAP_FAILED){
+        //for huge pages, map a huge page more than needed and trim it so the array starts on a huge page boundary
+        uint64_t slack = (allocPages == BLOOM_PAGES_SMALL) ? 0 : BLOOM_HUGE_PAGE_BYTES;
+        void* raw = mmap(NULL, length + slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(raw == MAP_FAILED){
+            fprintf(stderr, "Could not map %llu bytes for the bloom filter: %s\n", (unsigned long long)length, strerror(errno));
+            exit(1);
+        }
+        uintptr_t start = ((uintptr_t)raw + slack) / pageSize * pageSize;
+        if(start > (uintptr_t)raw){
+            munmap(raw, start - (uintptr_t)raw);
+        }
+        if((uintptr_t)raw + length + slack > start + length){
+            munmap((void*)(start + length), (uintptr_t)raw + length + slack - start - length);
+        }
+        map = (void*)start;
+        if(allocPages == BLOOM_PAGES_SMALL){
+            pages = "small pages";
+        }
+        else if(madvise(map, length, MADV_HUGEPAGE) == 0){
+            pages += "transparent huge pages (system setting " + thp_setting() + ")";
+        }
+        else{
+            pages += string("small pages, transparent huge pages refused (") + strerror(errno) + ")";
+        }
+    }
+    data = (unsigned char*)map;
+
+    //placement has to be set before the pages are first touched
+    string placement = "first touch";
+    std::vector<int> nodes = numa_nodes();
+    if(allocNuma != BLOOM_NUMA_NONE && nodes.size() == 1){
+        placement = "single NUMA node";
+    }
+    else if(allocNuma == BLOOM_NUMA_INTERLEAVE){
+        placement = bind_memory(data, length, BLOOM_MPOL_INTERLEAVE, nodes) ?
+            "interleaved over " + std::to_string(nodes.size()) + " nodes" : string("interleave refused (") + strerror(errno) + ")";
+    }
+    else if(allocNuma == BLOOM_NUMA_PARTITION){
+        uint64_t part = (length/nodes.size() + pageSize - 1) / pageSize * pageSize;
+        placement = "partitioned over " + std::to_string(nodes.size()) + " nodes";
+        for(size_t i = 0; i < nodes.size() && i*part < length; i++){
+            if(!bind_memory(data + i*part, std::min(part, length - i*part), BLOOM_MPOL_BIND, std::vector<int>(1, nodes[i]))){
+                placement = string("partition refused (") + strerror(errno) + ")";
+                break;
+            }
+        }
+    }
+
+    //an anonymous mapping is already zero, this just faults it in now rather than during the load
+    zero_parallel(data, length, allocThreads);
+    printf("Bloom filter of %.2f MB: %s, %s, zeroed by %d thread%s\n", length/(1024.0*1024.0), pages.c_str(),
+        placement.c_str(), allocThreads, allocThreads == 1 ? "" : "s");
+    allocatedMap = data;
+    allocatedLength = length;
+    return data;
+}
+
+string Bloom::describeAllocationPolicy(){
+    const char* pages[] = {"small pages", "transparent huge pages", "explicit huge pages"};
+    const char* numa[] = {"first touch placement", "NUMA interleave", "NUMA partition"};
+    return string(pages[allocPages]) + ", " + numa[allocNuma] + ", zeroed by " + std::to_string(allocThreads) + " thread" +
+        (allocThreads == 1 ? "" : "s");
+}
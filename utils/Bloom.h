@@ -18,6 +18,7 @@
 #include <cmath>
 #include <functional>
 #include <algorithm>
+#include <vector>
 
 
 // not using kmer_type from Kmer.h because I don't want this class to depend on Kmer.h
@@ -39,6 +40,68 @@ typedef kmer_type bloom_elem;
 
 #define NSEEDSBLOOM 10
 #define CUSTOMSIZE 1
+#define READ_BATCH_SIZE 10000 // reads handed to a worker thread at a time
+#define BLOOM_LOAD_REGIONS 8 // regions per thread a threaded two filter load resolves its kmers by
+
+//Bit layouts of the filter
+#define BLOOM_CLASSIC 0 // the probes of a key are spread over the whole array
+#define BLOOM_BLOCKED 1 // all the probes of a key fall in one cache line sized block, picked by h0
+#define BLOOM_COUNTING 2 // blocked like BLOOM_BLOCKED, with 2 bit saturating counters instead of bits, see create_counting_filter
+#define BLOOM_FROZEN_PAIRS 3 // no bits: the pairs added to the filter, frozen into an XorFilter, see freezePairs
+#define BLOOM_MINIMIZER 4 // blocked, with the block of a kmer in a partition of the array picked by its minimizer, see Minimizer
+#define BLOOM_EXACT 5 // no bits: an open addressing table of the canonical kmers themselves, see create_exact_set
+#define BLOOM_BLOCK_BITS 512
+#define BLOOM_BLOCK_BYTES 64
+#define BLOOM_BLOCK_COUNTERS 256 // counters in a block of the counting layout
+#define BLOOM_MAX_COUNT 3 // counters saturate here
+#define BLOOM_PARTITION_BLOCKS 64 // blocks in a partition of the minimizer layout, a 4 KB page
+#define BLOOM_MINIMIZER_BITS 0xFFFFFFFF00000000ULL // bits of h0 taken from the minimizer in the minimizer layout
+#define BLOOM_DEFAULT_MINIMIZER 15 // default minimizer length
+#define BLOOM_MINIMIZER_SEED 0x6b43a9b5a1f2c3d7ULL // mixed into the m-mer hashes that pick minimizers
+#define BLOOM_EXACT_MAX_K 31 // a slot of the exact layout holds a 2 bit count above a kmer of at most 31 bases
+#define BLOOM_EXACT_COUNT_SHIFT 62
+#define BLOOM_EXACT_KMER_BITS ((1ULL << BLOOM_EXACT_COUNT_SHIFT) - 1)
+#define BLOOM_EXACT_SLOTS_PER_KMER 2 // the exact layout is sized for half its slots used
+#define BLOOM_EXACT_MAX_LOAD 0.9 // past this fraction of used slots the probes of the exact layout get long, so the load stops
+
+//Dump format: a header of BLOOM_FILE_HEADER_SIZE bytes starting with BLOOM_FILE_MAGIC, which records everything
+//needed to rebuild the filter (see BloomFileHeader in Bloom.cpp), then the bit array.  The header size is a multiple
+//of the page size so the bit array can be mapped straight from the file.  Older dumps are just the bit array.
+#define BLOOM_FILE_MAGIC "FAUCETBF"
+#define BLOOM_FILE_VERSION 1
+#define BLOOM_FILE_HEADER_SIZE 4096
+
+//Page policies for the bit array, see setAllocationPolicy
+#define BLOOM_PAGES_SMALL 0 // regular pages
+#define BLOOM_PAGES_THP 1 // transparent huge pages, asked for with madvise
+#define BLOOM_PAGES_HUGETLB 2 // explicit huge pages from the hugetlb pool, falling back to BLOOM_PAGES_THP when it is empty
+//NUMA placement of the bit array
+#define BLOOM_NUMA_NONE 0 // each page goes to the node of the thread that first touches it
+#define BLOOM_NUMA_INTERLEAVE 1 // pages spread round robin over the nodes
+#define BLOOM_NUMA_PARTITION 2 // the array cut into one contiguous part per node
+#define BLOOM_HUGE_PAGE_BYTES (2ULL*1024*1024)
+
+//Kmer hash functions
+#define BLOOM_HASH_OLD 0 // oldHash of the packed canonical kmer, computed from scratch for every kmer
+#define BLOOM_HASH_ROLLING 1 // canonical ntHash, rolled along a read in O(1) per base, see RollingHash
+
+//Scalable filters, see makeScalable
+#define BLOOM_MAX_SUBFILTERS 32 // most sub-filters a scalable filter grows to
+#define BLOOM_SCALABLE_GROWTH 2 // each sub-filter is sized for this many times the items of the one before
+#define BLOOM_SCALABLE_TIGHTENING 0.5 // and for this fraction of its false positive rate
+
+#define BLOOM_MAX_FOLDS 8 // folds exact size filters are made ready for when folding is asked for, see setFoldable
+
+#define PAIR_KEY_SHARDS 64 // locks the pair keys are spread over while they are collected, see collectPairs
+
+#define ESTIMATE_SAMPLES (1 << 21) // most kmer hashes estimate_kmer_counts keeps, over all its threads
+
+//Bucketed loads, see load_two_filters_bucketed
+#define BLOOM_BUCKET_SLICE (4 << 20) // bytes of each filter per bucket when the number of buckets isn't given
+#define BLOOM_MAX_BUCKETS 512 // bucket files open at once
+
+#define BLOOM_WINDOW 64 // kmers hashed together by the batch calls
+#define BLOOM_PREFETCH_DISTANCE 16 // how many kmers ahead of the one being resolved the batch calls prefetch
 
 static const int bits_per_char = 0x08;    // 8 bits in 1 char(unsigned)
 static const unsigned char bit_mask[bits_per_char] = {
@@ -53,6 +116,32 @@ static const unsigned char bit_mask[bits_per_char] = {
 };
 
 
+//ntHash seeds of the bases, indexed by their NT2int code (A, C, T, G), so the complement of code nt is nt^2
+static const uint64_t nt_hash_seed[4] =
+{
+    0x3c8bfbb395c60474ULL,
+    0x3193c18562a02b4cULL,
+    0x295549f54be24456ULL,
+    0x20323ed082572324ULL
+};
+
+//ntHash state of a kmer: the hash of its forward strand and of its reverse complement.  Their sum is the same for
+//both strands of a kmer, so it hashes the canonical kmer without computing it.
+struct RollingHash{
+    uint64_t forward;
+    uint64_t reverse;
+};
+
+//Minimizer of a kmer: the smallest hash of its canonical m-mers, and the position in the kmer of the first m-mer with
+//that hash.  A kmer and its reverse complement have the same canonical m-mers, so the same minimizer, and the kmers of
+//a read that share a minimizer (a super-kmer) are mostly runs of consecutive kmers, as are the extensions searched by
+//a j-check.  The minimizer layout puts all the kmers with one minimizer in one partition of BLOOM_PARTITION_BLOCKS
+//blocks, so such runs stay within a page instead of touching a page per kmer.
+struct Minimizer{
+    uint64_t hash;
+    int pos;
+};
+
 static const uint64_t rbase[NSEEDSBLOOM] =
 {
     0xAAAAAAAA55555555ULL, 
@@ -68,6 +157,9 @@ static const uint64_t rbase[NSEEDSBLOOM] =
 };
 
 
+class XorFilter;
+struct PairKeys;
+
 class Bloom{
     
 protected:
@@ -99,6 +191,81 @@ protected:
 
     int hashSize;
     uint64_t bloomMask;
+    int layout;
+    uint64_t blockCount; //number of blocks of the blocked layout
+    //Exact size filters have any number of bits, and map full 64 bit hashes onto them with a multiply-shift.
+    //Otherwise the size is rounded up to a power of two and hashes are masked to it, as in older dumps.
+    bool exactSize;
+    int threshold; //count a key needs to be contained, for the counting layout
+    int hashMode; //BLOOM_HASH_OLD or BLOOM_HASH_ROLLING, how kmers are hashed
+    int minimizerSize; //m, for the minimizer layout
+    uint64_t mmerMask;
+
+    //set when the bit array is mapped read-only from a dump, see open_dump
+    unsigned char* mappedFile;
+    uint64_t mappedLength;
+    //set when the bit array is an anonymous mapping made for the allocation policy, rather than from posix_memalign
+    unsigned char* allocatedMap;
+    uint64_t allocatedLength;
+
+    //set once the filter's pairs are frozen, and while they are collected
+    XorFilter* frozenPairs;
+    PairKeys* pairKeys;
+    void releaseBits(); //frees or unmaps the bit array
+
+    //Scalable filters: this filter is the first sub-filter, and the ones added as it fills up are in subFilters
+    bool scalable; //set by makeScalable, new items may add sub-filters
+    uint64_t capacity; //items the filter was sized for, by the create functions
+    float designFpRate; //false positive rate it was sized for at capacity
+    uint64_t itemsAdded; //new items added to this sub-filter, counted in scalable mode
+    Bloom* subFilters[BLOOM_MAX_SUBFILTERS];
+    int subFilterCount; //sub-filters added, read and written atomically so queries can run while another thread grows the filter
+    int scalableAdd(uint64_t h0, uint64_t h1, bool atomic);
+    int scalableContains(uint64_t h0, uint64_t h1);
+    void grow(int seen); //adds a sub-filter, unless another thread already grew past seen sub-filters
+
+    int folds; //times the filter was folded, see fold
+    //Estimated false positive rate of bytes of bits laid out like this filter's: the chance that every probe of a key
+    //that wasn't added hits a set bit, from the weight of the whole array, or of each block in the blocked layout
+    double estimate_fp_rate(const unsigned char* bits, uint64_t bytes);
+
+    static int foldableFolds;
+    static int allocPages;
+    static int allocNuma;
+    static int allocThreads;
+    //Exits unless other can be merged with this filter: same settings, and neither folded, scalable nor frozen
+    void checkMergeable(Bloom* other);
+    //An empty filter with the settings of this one, to merge into
+    Bloom* emptyMergeTarget();
+    //Allocates a zeroed bit array of bytes bytes under the allocation policy, and reports the policy when it isn't the default
+    unsigned char* allocate(uint64_t bytes);
+
+    //The exact layout, see create_exact_set: the slots are the words of the bit array, 0 for an empty one
+    inline uint64_t exactHome(bloom_elem canon){
+        return finalize(canon ^ seed_tab[0]) & (tai/64 - 1);
+    }
+    //Times canon was added to the exact set, up to BLOOM_MAX_COUNT
+    inline int exactCount(bloom_elem canon){
+        const uint64_t* slots = (const uint64_t*)blooma;
+        uint64_t mask = tai/64 - 1;
+        for(uint64_t i = exactHome(canon); ; i = (i + 1) & mask){
+            uint64_t slot = __atomic_load_n(&slots[i], __ATOMIC_RELAXED);
+            if(slot == 0){
+                return 0;
+            }
+            if((slot & BLOOM_EXACT_KMER_BITS) == canon){
+                return (int)(slot >> BLOOM_EXACT_COUNT_SHIFT);
+            }
+        }
+    }
+    inline int exactContains(bloom_elem canon){
+        return exactCount(canon) >= threshold;
+    }
+    inline void exactPrefetch(bloom_elem canon){
+        __builtin_prefetch(&((const uint64_t*)blooma)[exactHome(canon)]);
+    }
+    void exactAdd(bloom_elem canon, bool atomic);
+    void exact_add_read(ReadSpan read, bool atomic);
     std::set<bloom_elem> valid_set;
     std::set<uint64_t> valid_hash0;
     std::set<uint64_t> valid_hash1;
@@ -107,6 +274,21 @@ public:
     int getNumHash();
     int getHashSize();
     uint64_t getBloomMask();
+    int getLayout();
+    bool isExactSize();
+    uint64_t getBlockCount(); //blocks of the blocked layouts
+    uint64_t getBytes(); //bytes of the bit array
+    bool isScalable(); //see makeScalable
+    bool isExact(); //an exact kmer set rather than a filter, see create_exact_set
+    //For the counting layout, contains answers whether a key was added at least threshold times.  1 by default.
+    void setThreshold(int threshold);
+    int getThreshold();
+    //How kmers are hashed, BLOOM_HASH_OLD by default.  Must be set before anything is added.
+    void setHashMode(int mode);
+    int getHashMode();
+    //Length of the minimizers of the minimizer layout, at most k and 32.  Must be set before anything is added.
+    void setMinimizerSize(int m);
+    int getMinimizerSize();
 
     unsigned char * blooma;
 
@@ -115,12 +297,33 @@ public:
     These are the important things that are currently being used.
     ***********************************************************************************/
     
-    float weight(); //returns the proportion of 1's in the filter.  So should be between 0.0 and 1.0
+    float weight(); //returns the proportion of 1's in the filter.  So should be between 0.0 and 1.0, and 0 when frozen
+                    //For the counting layout, the proportion of counters at least the threshold.
+                    //For the exact layout, the proportion of slots holding a kmer counted at least the threshold.
     
 
-    Bloom* create_bloom_filter_2_hash(uint64_t estimated_items, float fpRate); //creates for two hash functions and given fpRate
-
-    Bloom* create_bloom_filter_optimal(uint64_t estimated_items, float fpRate); //creates for smallest size given the fpRate
+    //creates for two hash functions and given fpRate
+    static Bloom* create_bloom_filter_2_hash(uint64_t estimated_items, float fpRate, int layout = BLOOM_CLASSIC, bool exactSize = true);
+
+    //creates for smallest size given the fpRate.  A blocked filter gets more bits per item to make up for the uneven
+    //load of its blocks.
+    static Bloom* create_bloom_filter_optimal(uint64_t estimated_items, float fpRate, int layout = BLOOM_CLASSIC, bool exactSize = true);
+
+    //creates a counting filter whose threshold view has the given fpRate: the smallest one for which a kmer seen fewer
+    //than threshold times is reported with probability fpRate, assuming estimated_items distinct kmers of which
+    //singletons are seen once.  The threshold is set on the filter.
+    static Bloom* create_counting_filter(uint64_t estimated_items, uint64_t singletons, float fpRate, int threshold, bool exactSize = true);
+
+    //creates an exact kmer set in place of a filter, for genomes small enough to afford one: the BLOOM_EXACT layout,
+    //an open addressing table of the canonical 2-bit kmers, each with a 2 bit saturating count in its top bits, probed
+    //linearly from a hash of the kmer.  It has no false positives.  Like the counting layout, a kmer is contained if it
+    //was added at least threshold times, so a single set replaces the bloo1/bloo2 pair and is loaded with
+    //load_counting_filter.  It is sized for estimated_items distinct kmers, and a load that fills it past
+    //BLOOM_EXACT_MAX_LOAD exits.  Only the kmer calls work on it (oldAdd, oldContains, add_read, contains_read,
+    //contains_batch, extensionMask), not the ones taking hashes, and its hash mode stays BLOOM_HASH_OLD.
+    static Bloom* create_exact_set(uint64_t estimated_items, int threshold);
+    //Bytes of the table create_exact_set makes for estimated_items kmers
+    static uint64_t exact_set_bytes(uint64_t estimated_items);
 
     //loads all the kmers in the reads file into the bloom filter.
     //Input is assumed to be a raw string for each read, one per line.
@@ -144,18 +347,155 @@ public:
       return hash &= bloomMask;
     }
 
+    static inline uint64_t rol(uint64_t x, int dist){
+        dist &= 63;
+        return dist ? (x << dist) | (x >> (64 - dist)) : x;
+    }
+
+    //ntHash state of kmer, in O(k)
+    inline RollingHash rollingState(kmer_type kmer){
+        RollingHash state = {0, 0};
+        for(int i = 0; i < k; i++){
+            int nt = (int)(kmer >> (2*(k - 1 - i))) & 3;
+            state.forward = rol(state.forward, 1) ^ nt_hash_seed[nt];
+            state.reverse ^= rol(nt_hash_seed[nt ^ 2], i);
+        }
+        return state;
+    }
+
+    //State of the kmer that drops the base outNt from the front of state's kmer and adds inNt at its end
+    inline RollingHash roll(RollingHash state, int outNt, int inNt){
+        RollingHash next;
+        next.forward = rol(state.forward, 1) ^ rol(nt_hash_seed[outNt], k) ^ nt_hash_seed[inNt];
+        next.reverse = rol(state.reverse, 63) ^ rol(nt_hash_seed[outNt ^ 2], 63) ^ rol(nt_hash_seed[inNt ^ 2], k - 1);
+        return next;
+    }
+
+    //The two filter hashes of a kmer from its state.  The rotations of ntHash leave patterns across nearby kmers, so
+    //the canonical value is mixed with each seed by the murmur finalizer.
+    inline void rollingHashes(RollingHash state, uint64_t& hA, uint64_t& hB){
+        uint64_t canon = state.forward + state.reverse;
+        hA = finalize(canon ^ seed_tab[0]) & bloomMask;
+        hB = finalize(canon ^ seed_tab[1]) & bloomMask;
+    }
+
+    static inline uint64_t finalize(uint64_t hash){
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    //The two filter hashes of a canonical kmer, with the hash function of the filter
+    inline void hashKmer(bloom_elem canon, uint64_t& hA, uint64_t& hB){
+        kmerHashes(canon, hA, hB);
+        if(layout == BLOOM_MINIMIZER){
+            hA = withMinimizer(hA, minimizerOf(canon).hash);
+        }
+    }
+
+    //The same, without the minimizer of the minimizer layout, for callers that keep track of it themselves
+    inline void kmerHashes(bloom_elem canon, uint64_t& hA, uint64_t& hB){
+        if(hashMode == BLOOM_HASH_ROLLING){
+            rollingHashes(rollingState(canon), hA, hB);
+            return;
+        }
+        hA = oldHash(canon, 0);
+        hB = oldHash(canon, 1);
+    }
+
+    //Hash of an m-mer as a minimizer candidate, the same for both its strands
+    inline uint64_t mmerHash(uint64_t mmer){
+        return finalize(std::min(mmer, revcomp(mmer, minimizerSize)) ^ BLOOM_MINIMIZER_SEED);
+    }
+
+    //Minimizer of a kmer in either strand, in O(k)
+    inline Minimizer minimizerOf(kmer_type kmer){
+        Minimizer min = {~0ULL, 0};
+        for(int i = 0; i <= k - minimizerSize; i++){
+            uint64_t hash = mmerHash((uint64_t)(kmer >> (2*(k - minimizerSize - i))) & mmerMask);
+            if(hash < min.hash){
+                min.hash = hash, min.pos = i;
+            }
+        }
+        return min;
+    }
+
+    //Minimizer of next, the kmer that extends the kmer of prev forward by one base.  Only its new last m-mer is hashed,
+    //unless the minimizer of prev was its first m-mer, which next doesn't have.
+    inline Minimizer extendMinimizer(Minimizer prev, kmer_type next){
+        if(prev.pos == 0){
+            return minimizerOf(next);
+        }
+        uint64_t hash = mmerHash((uint64_t)next & mmerMask);
+        if(hash < prev.hash){
+            Minimizer min = {hash, k - minimizerSize};
+            return min;
+        }
+        prev.pos--;
+        return prev;
+    }
+
+    //h0 of a kmer in the minimizer layout: its high bits, which pick the partition, come from the minimizer hash, and
+    //its low bits, which pick the block in the partition and the probes in the block, from the kmer's own h0.
+    //A minimizer hash is the smallest of its kmer's, so it is hashed again to spread the partitions evenly.
+    static inline uint64_t withMinimizer(uint64_t h0, uint64_t minimizerHash){
+        return (finalize(minimizerHash) & BLOOM_MINIMIZER_BITS) | (h0 & ~BLOOM_MINIMIZER_BITS);
+    }
+
+    //Scalable mode, for when the estimate the filter was sized from may be too low: once the filter has taken the items
+    //it was created for, new items go to a sub-filter sized for BLOOM_SCALABLE_GROWTH times as many items at
+    //BLOOM_SCALABLE_TIGHTENING times the false positive rate, and so on, so the rates of all of them add up to at most
+    //twice the first.  Queries check every sub-filter.  A low estimate then costs a few more probes per kmer instead
+    //of a saturated filter.  Only for exact size filters from create_bloom_filter_2_hash or create_bloom_filter_optimal.
+    void makeScalable();
+    int getSubFilterCount(); //sub-filters added as the filter filled up, 0 if it never did
+
+    //Folding gives back the memory of a filter that was sized for more items than it got.  A fold halves the bit array
+    //and ORs together the bits whose keys land on the same bit of the half size filter: the two halves of a power of
+    //two filter, whose hashes are taken modulo its size, and the pairs of neighbouring bits (or blocks, in the blocked
+    //layout) of an exact size filter, whose hashes are mapped on its size by reduce, since reduce(h, n/2) is
+    //reduce(h, n)/2.  Every key in the filter stays in it, and the false positive rate goes up with the weight.
+    //Counting, frozen, mapped and grown scalable filters can't be folded.
+    bool canFold();
+    //Folds the filter once, unless its estimated false positive rate would then be over maxFpRate.  Returns whether it folded.
+    bool fold(double maxFpRate = 1);
+    //Folds the filter as long as its estimated false positive rate stays at most targetFpRate, and returns the number of folds
+    int autoFold(double targetFpRate);
+    int getFolds();
+    //Exact size filters created from now on are rounded up so they can be folded at least folds times; an exact size
+    //filter otherwise only folds while its size in words (or blocks) is even.  0 by default.
+    static void setFoldable(int folds);
+    double estimatedFpRate(); //see estimate_fp_rate, for the bits of the filter and its sub-filters
+
     void addPair(JuncPair pair);
+    void atomic_addPair(JuncPair pair); //thread-safe addPair, see atomic_add
     int containsPair(JuncPair pair);
+
+    //Frozen pair filters: after collectPairs, every pair added is also recorded, and freezePairs then builds an
+    //XorFilter over them and drops the bit array.  The frozen filter answers containsPair in three byte reads at about
+    //9 bits per pair, against a bloom filter whose size had to be guessed before the scan; nothing more can be added.
+    //Both are safe to call only when no pairs are being added.
+    static uint64_t pairKey(JuncPair pair); //the same for a pair and its reverse
+    void collectPairs();
+    void freezePairs();
+    bool isFrozen();
     
     //Add an element using the old hash function
     inline int oldAdd(bloom_elem elem)
     {
+        if(layout == BLOOM_EXACT){
+            exactAdd(elem, false);
+            return 0;
+        }
         uint64_t hA,hB;
 
-        hA = oldHash(elem, 0);
-        hB = oldHash(elem, 1);
+        hashKmer(elem, hA, hB);
 
         add(hA, hB);
+        return 0;
     }
 
     //Check whether an element is contained using the old hash function
@@ -164,14 +504,63 @@ public:
         if(fake){
             return (valid_set.find(elem) != valid_set.end());
         }
+        if(layout == BLOOM_EXACT){
+            return exactContains(elem);
+        }
         uint64_t hA,hB;
 
-        hA = oldHash(elem, 0);
-        hB = oldHash(elem, 1);
+        hashKmer(elem, hA, hB);
 
         return contains(hA, hB);
     }
 
+    //Returns a 4 bit mask of the extensions of kmer in direction dir that are in the filter, using the old hash function:
+    //bit nt is set if kmer.getExtension(nt, dir) is contained.
+    //The four canonical extensions are built from both strands of kmer without any revcomp, all of them are hashed,
+    //and all their probes are prefetched before any is checked, so the cache misses overlap.
+    int extensionMask(DoubleKmer kmer, bool dir);
+
+    //Batch versions of the old hash calls, for the kmers of a whole read at a time.  The kmers are hashed a window at a
+    //time, and each probe is prefetched BLOOM_PREFETCH_DISTANCE kmers before it is resolved, so the cache misses of
+    //several kmers overlap instead of following each other.  Kmers are still resolved in order, so the result is the
+    //same as calling oldAdd/oldContains on each one in turn.
+    void hash_batch(const bloom_elem* elems, int count, uint64_t* hashA, uint64_t* hashB);
+    void hash_batch_kmers(const bloom_elem* elems, int count, uint64_t* hashA, uint64_t* hashB); //without the minimizers
+    void add_batch(const bloom_elem* elems, int count);
+    void atomic_add_batch(const bloom_elem* elems, int count); //thread-safe add_batch, see atomic_add
+    void contains_batch(const bloom_elem* elems, int count, unsigned char* found); //found[i] is oldContains(elems[i])
+
+    //The same on hashes already computed
+    void add_hashes(const uint64_t* hashA, const uint64_t* hashB, int count);
+    void atomic_add_hashes(const uint64_t* hashA, const uint64_t* hashB, int count);
+    void contains_hashes(const uint64_t* hashA, const uint64_t* hashB, int count, unsigned char* found);
+
+    //Hashes every kmer of an unambiguous read, in the order of getCanonKmers, and returns their number.  hashA and hashB
+    //need room for read.length - k + 1 hashes.  With BLOOM_HASH_ROLLING the hash is rolled along the read.
+    int hash_read(ReadSpan read, uint64_t* hashA, uint64_t* hashB);
+    int hash_read_kmers(ReadSpan read, uint64_t* hashA, uint64_t* hashB); //without the minimizers
+    //The batch calls on all the kmers of an unambiguous read.  contains_read resizes found to the number of kmers.
+    void add_read(ReadSpan read);
+    void atomic_add_read(ReadSpan read);
+    int contains_read(ReadSpan read, std::vector<unsigned char>& found);
+
+    //Starts loading the memory that contains(h0, h1) will read
+    inline void prefetch(uint64_t h0, uint64_t h1)
+    {
+        if(layout != BLOOM_CLASSIC){
+            __builtin_prefetch(getBlock(h0));
+            return;
+        }
+        uint64_t h = h0;
+        for(int i=0; i<n_hash_func; i++, h += h1)
+        {
+            if(!exactSize){
+                h %= tai;
+            }
+            __builtin_prefetch(&blooma[(exactSize ? reduce(h, tai) : h) >> 3]);
+        }
+    }
+
 
     /**********************************************************************************
     Most of the below is not currently used.  Much of it is for incremental hashing.
@@ -214,8 +603,120 @@ public:
     }
 
 
+    //Maps a full 64 bit hash onto [0, range) with a multiply-shift, which needs no division
+    static inline uint64_t reduce(uint64_t hash, uint64_t range)
+    {
+        return (uint64_t)(((__uint128_t)hash * range) >> 64);
+    }
+
+    //Block of the blocked layout holding the bits of a key.  Its bits are probed by double hashing, see getBlockBit.
+    //In the minimizer layout the high bits of h0 pick a partition and its low bits a block in it.
+    inline unsigned char* getBlock(uint64_t h0)
+    {
+        if(layout == BLOOM_MINIMIZER){
+            uint64_t partition = reduce(h0 & BLOOM_MINIMIZER_BITS, blockCount / BLOOM_PARTITION_BLOCKS);
+            return blooma + (partition * BLOOM_PARTITION_BLOCKS + (h0 & (BLOOM_PARTITION_BLOCKS - 1))) * BLOOM_BLOCK_BYTES;
+        }
+        if(exactSize){
+            return blooma + reduce(h0, blockCount) * BLOOM_BLOCK_BYTES;
+        }
+        return blooma + ((h0 / BLOOM_BLOCK_BITS) & (blockCount - 1)) * BLOOM_BLOCK_BYTES;
+    }
+
+    //Number of the block of a key in the blocked layouts, counting from the start of the bit array
+    inline uint64_t getBlockIndex(uint64_t h0)
+    {
+        return (getBlock(h0) - blooma) / BLOOM_BLOCK_BYTES;
+    }
+
+    //Bit of the block for one probe.  The double hashed value is mixed by a multiply and its top bits taken, which
+    //keeps the probes apart better than the low bits of h0 + i*h1.
+    static inline int getBlockBit(uint64_t h)
+    {
+        return (h * 0x9E3779B97F4A7C15ULL) >> (64 - 9); // 2^9 = BLOOM_BLOCK_BITS
+    }
+
+    //Counter of the block for one probe of the counting layout, chosen like getBlockBit
+    static inline int getBlockCounter(uint64_t h)
+    {
+        return (h * 0x9E3779B97F4A7C15ULL) >> (64 - 8); // 2^8 = BLOOM_BLOCK_COUNTERS
+    }
+
+    static inline int getCounter(const unsigned char* block, uint64_t counter)
+    {
+        return (block[counter >> 2] >> (2*(counter & 3))) & 3;
+    }
+
+    //Smallest counter of a key in the counting layout.  counters gets the counter of each probe.
+    inline int minCount(unsigned char* block, uint64_t h0, uint64_t h1, int* counters)
+    {
+        int low = BLOOM_MAX_COUNT;
+        uint64_t h = h0;
+        for(int i=0; i<n_hash_func; i++, h += h1)
+        {
+            counters[i] = getBlockCounter(h);
+            low = std::min(low, getCounter(block, counters[i]));
+        }
+        return low;
+    }
+
     inline void add(uint64_t h0, uint64_t h1)
     {
+        if(scalable){
+            scalableAdd(h0, h1, false);
+            return;
+        }
+        addBits(h0, h1);
+    }
+
+    //Thread-safe version of add(h0, h1) for filters shared by several loader threads.
+    //Returns 1 if the key was already contained before this call, see atomicAddBits.
+    inline int atomic_add(uint64_t h0, uint64_t h1)
+    {
+        if(scalable){
+            return scalableAdd(h0, h1, true);
+        }
+        return atomicAddBits(h0, h1);
+    }
+
+    //Sets the bits of a key in this filter alone, not its sub-filters.
+    //In the counting layout a key is counted with a conservative update: only its smallest counters are incremented.
+    inline void addBits(uint64_t h0, uint64_t h1)
+    {
+        if(layout == BLOOM_COUNTING){
+            unsigned char* block = getBlock(h0);
+            int counters[NSEEDSBLOOM];
+            int low = minCount(block, h0, h1, counters);
+            if(low == BLOOM_MAX_COUNT){
+                return;
+            }
+            for(int i=0; i<n_hash_func; i++)
+            {
+                if(getCounter(block, counters[i]) == low){
+                    block[counters[i] >> 2] += 1 << (2*(counters[i] & 3));
+                }
+            }
+            return;
+        }
+        if(layout == BLOOM_BLOCKED || layout == BLOOM_MINIMIZER){
+            unsigned char* block = getBlock(h0);
+            uint64_t h = h0;
+            for(int i=0; i<n_hash_func; i++, h += h1)
+            {
+                int bit = getBlockBit(h);
+                block [bit >> 3] |= bit_mask[bit & 7];
+            }
+            return;
+        }
+        if(exactSize){
+            uint64_t h = h0;
+            for(int i=0; i<n_hash_func; i++, h += h1)
+            {
+                uint64_t p = reduce(h, tai);
+                blooma [p >> 3] |= bit_mask[p & 7];
+            }
+            return;
+        }
         uint64_t h = h0;
         for(int i=0; i<n_hash_func; i++, h += h1)
         {
@@ -226,11 +727,94 @@ public:
     }
 
 
+    //Positions in the bit array of the bits addBits sets for a key, for the bit layouts: classic, blocked and minimizer.
+    //Returns their number, n_hash_func.
+    inline int probeBits(uint64_t h0, uint64_t h1, uint64_t* bits)
+    {
+        if(layout == BLOOM_BLOCKED || layout == BLOOM_MINIMIZER){
+            uint64_t blockStart = getBlockIndex(h0) * BLOOM_BLOCK_BITS;
+            uint64_t h = h0;
+            for(int i=0; i<n_hash_func; i++, h += h1)
+            {
+                bits[i] = blockStart + getBlockBit(h);
+            }
+            return n_hash_func;
+        }
+        uint64_t h = exactSize ? h0 : h0 % tai;
+        for(int i=0; i<n_hash_func; i++)
+        {
+            bits[i] = exactSize ? reduce(h, tai) : h;
+            h = exactSize ? h + h1 : (h + h1) % tai;
+        }
+        return n_hash_func;
+    }
+
+    //Thread-safe version of addBits.  Bits are set with an atomic fetch-or each, and it returns 1 if every one of them
+    //was already set.  The bits are not set together, so two threads adding the same new key at once can each find
+    //one of its bits clear and both return 0.
+    //Counters are incremented with a compare-and-swap, and only while they still hold the smallest count seen,
+    //so a key counted by two threads at once may be counted once.
+    inline int atomicAddBits(uint64_t h0, uint64_t h1)
+    {
+        int contained = 1;
+        if(layout == BLOOM_COUNTING){
+            unsigned char* block = getBlock(h0);
+            int counters[NSEEDSBLOOM];
+            int low = BLOOM_MAX_COUNT;
+            uint64_t h = h0;
+            for(int i=0; i<n_hash_func; i++, h += h1)
+            {
+                counters[i] = getBlockCounter(h);
+                unsigned char byte = __atomic_load_n(&block[counters[i] >> 2], __ATOMIC_RELAXED);
+                low = std::min(low, (byte >> (2*(counters[i] & 3))) & 3);
+            }
+            if(low == BLOOM_MAX_COUNT){
+                return 1;
+            }
+            for(int i=0; i<n_hash_func; i++)
+            {
+                unsigned char* byte = &block[counters[i] >> 2];
+                int shift = 2*(counters[i] & 3);
+                unsigned char old = __atomic_load_n(byte, __ATOMIC_RELAXED);
+                while(((old >> shift) & 3) == low
+                      && !__atomic_compare_exchange_n(byte, &old, (unsigned char)(old + (1 << shift)), true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+                }
+            }
+            return low >= threshold;
+        }
+        if(layout == BLOOM_BLOCKED || layout == BLOOM_MINIMIZER){
+            unsigned char* block = getBlock(h0);
+            uint64_t h = h0;
+            for(int i=0; i<n_hash_func; i++, h += h1)
+            {
+                int bit = getBlockBit(h);
+                unsigned char old = __atomic_fetch_or(&block[bit >> 3], bit_mask[bit & 7], __ATOMIC_RELAXED);
+                if(!(old & bit_mask[bit & 7])){
+                    contained = 0;
+                }
+            }
+            return contained;
+        }
+        uint64_t h = h0;
+        for(int i=0; i<n_hash_func; i++, h += h1)
+        {
+            uint64_t p = exactSize ? reduce(h, tai) : (h %= tai);
+            unsigned char old = __atomic_fetch_or(&blooma[p >> 3], bit_mask[p & 7], __ATOMIC_RELAXED);
+            if(!(old & bit_mask[p & 7])){
+                contained = 0;
+            }
+        }
+        return contained;
+    }
+
     inline int contains(bloom_elem elem)
     {
         if(fake){
             return (valid_set.find(elem) != valid_set.end());
         }
+        if(layout == BLOOM_EXACT){
+            return exactContains(elem);
+        }
         uint64_t hA,hB;
 
         hA = get_rolling_hash(elem, 0);
@@ -245,6 +829,49 @@ public:
         return (valid_hash0.find(h0) != valid_hash0.end()) 
           && (valid_hash1.find(h1) != valid_hash1.end());
       }
+        if(subFilterCount){
+            return scalableContains(h0, h1);
+        }
+        return containsBits(h0, h1);
+    }
+
+    //Checks the bits of a key in this filter alone, not its sub-filters
+    inline int containsBits(uint64_t h0, uint64_t h1)
+    {
+        if(layout == BLOOM_COUNTING){
+            unsigned char* block = getBlock(h0);
+            uint64_t h = h0;
+            for(int i=0; i<n_hash_func; i++, h += h1)
+            {
+                if(getCounter(block, getBlockCounter(h)) < threshold){
+                    return 0;
+                }
+            }
+            return 1;
+        }
+        if(layout == BLOOM_BLOCKED || layout == BLOOM_MINIMIZER){
+            unsigned char* block = getBlock(h0);
+            uint64_t h = h0;
+            for(int i=0; i<n_hash_func; i++, h += h1)
+            {
+                int bit = getBlockBit(h);
+                if ((block[bit >> 3] & bit_mask[bit & 7]) != bit_mask[bit & 7]){
+                    return 0;
+                }
+            }
+            return 1;
+        }
+        if(exactSize){
+            uint64_t h = h0;
+            for(int i=0; i<n_hash_func; i++, h += h1)
+            {
+                uint64_t p = reduce(h, tai);
+                if ((blooma[p >> 3] & bit_mask[p & 7]) != bit_mask[p & 7]){
+                    return 0;
+                }
+            }
+            return 1;
+        }
         uint64_t h = h0 % tai;
         for(int i=0; i<n_hash_func; i++, h = (h+h1)%tai)
         {
@@ -279,10 +906,36 @@ public:
     uint64_t tai;
     uint64_t nb_elem;
     
-    void dump(char * filename);
+    void dump(char * filename); //writes the header and the bit array
+    //Reads a dump into this filter, which must have been created with the same settings.  A dump with a header is checked
+    //against them, and the program exits on a mismatch.  A dump without a header is read as a bare bit array.
     void load(char * filename);
 
-    Bloom(uint64_t tai_bloom, int k);
+    //Opens a dump with a header as a new filter built from the header, with its bit array mapped read-only from the file,
+    //so the filter is ready without reading it and shares the page cache with other processes using the same file.
+    //The filter can be queried but not added to.  Exits if the dump is for another kmer size.
+    //Returns nullptr for a dump without a header, which has to be read with load.
+    static Bloom* open_dump(const char* filename);
+    bool isMapped();
+
+    //Merging lanes that were loaded separately, for faucet-bloom-merge.  All the filters must have the same settings and
+    //not be folded, scalable or frozen, or the program exits.  The merged filters are new, and threads split their bytes.
+    //For the pair of filters, lanes1 and lanes2 hold bloo1 and bloo2 of each lane.  A bit is set in merged1 if it is set
+    //in any bloo1, and in merged2 if it is set in any bloo2 or in the bloo1 of at least two lanes, so a kmer seen once in
+    //each of two lanes ends up solid, as if the lanes had been loaded together.
+    static void merge_two_filters(const std::vector<Bloom*>& lanes1, const std::vector<Bloom*>& lanes2, Bloom*& merged1,
+        Bloom*& merged2, int threads = 1);
+    //For counting filters, the counters of the lanes are added, saturating at BLOOM_MAX_COUNT
+    static Bloom* merge_counting_filters(const std::vector<Bloom*>& lanes, int threads = 1);
+
+    //Sets how the bit arrays of filters created from now on are allocated: pages is one of the BLOOM_PAGES_ policies,
+    //numa one of the BLOOM_NUMA_ placements, and threads how many threads zero the array, which is also what spreads
+    //its pages over the nodes under BLOOM_NUMA_NONE.  The default is small pages, no placement and one thread.
+    static void setAllocationPolicy(int pages, int numa, int threads);
+    static string describeAllocationPolicy();
+
+    //With exactSize false the size is rounded up to a power of two, see exactSize
+    Bloom(uint64_t tai_bloom, int k, int layout = BLOOM_CLASSIC, bool exactSize = false);
     Bloom(int tai_bloom);
     Bloom(uint64_t tai_bloom);
 
@@ -291,8 +944,31 @@ public:
     ~Bloom();
 };
 
-void load_two_filters(Bloom* bloo1, Bloom* bloo2, std::string reads_filename, bool fastq, bool mercy); //if fastq, use fastq. Else use fasta
-void load_single_filter(Bloom* bloo1, string reads_filename, bool fastq);
+//if fastq, use fastq. Else use fasta.  With threads > 1 the reads are hashed on that many worker threads.
+//If spool_filename is given, the unambiguous pieces of every read are also written there as a read spool (see ReadSpool.h),
+//so the read scan can replay them instead of reading the input again.
+void load_two_filters(Bloom* bloo1, Bloom* bloo2, std::string reads_filename, bool fastq, bool mercy, int threads = 1, std::string spool_filename = "");
+//Out of core version of load_two_filters, for filters much bigger than the cache.  The first phase hashes the reads
+//and writes each kmer's two hashes to one of buckets files in bucket_dir, by the region of the filters its block falls
+//in.  The second phase reads the files back one at a time, on up to threads threads, and loads each bucket into its own
+//slice of bloo1 and bloo2, so the random writes of a bucket stay in a slice that fits in the cache.  The files are
+//removed as they are loaded.  Only for the blocked layouts, where all the bits of a kmer are in one block, and without
+//mercy kmers or sub-filters.  buckets 0 gives slices of BLOOM_BUCKET_SLICE bytes.
+void load_two_filters_bucketed(Bloom* bloo1, Bloom* bloo2, std::string reads_filename, bool fastq, std::string bucket_dir,
+    int buckets = 0, int threads = 1, std::string spool_filename = "");
+void load_single_filter(Bloom* bloo1, string reads_filename, bool fastq, int threads = 1);
+//Adds the kmers of a kmer database (see KmerDB.h) counted at least min_count times, instead of loading from the reads.
+//The records are split between threads, which hash them in batches.
+void load_kmer_db(Bloom* bloom, std::string db_filename, uint32_t min_count, int threads = 1);
+//Counts every kmer of the reads in a counting filter (see create_counting_filter) or an exact kmer set (see
+//create_exact_set).  Threads and spool as for load_two_filters.
+void load_counting_filter(Bloom* bloom, std::string reads_filename, bool fastq, int threads = 1, std::string spool_filename = "");
+//Estimates the number of distinct kmers in the reads and how many of them are seen once, for sizing the filters without
+//a separate ntCard run.  Every canonical kmer is hashed, and the kmers whose hash starts with a number of 0 bits are
+//counted exactly; that number starts at 0 and goes up whenever the sample outgrows ESTIMATE_SAMPLES, so memory stays
+//bounded and the counts are scaled up by the sampling rate.  Threads and spool as for load_two_filters, so in single
+//pass mode the estimate reads the input and the load replays the spool.
+void estimate_kmer_counts(std::string reads_filename, bool fastq, uint64_t& distinct, uint64_t& singletons, int threads = 1, std::string spool_filename = "");
 double brents_fun(std::function<double (double)> f, double lower, double upper, double tol, unsigned int max_iter);
 bool isJunction(ReadKmer readKmer, Bloom* bloom, bool dir);
 
@@ -0,0 +1,509 @@
+#include "Decompressor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <algorithm>
+#include <zlib.h>
+#include <bzlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define DECOMPRESS_CHUNK_SIZE (1 << 20) //decompressed bytes per part handed to the reader
+#define DECOMPRESS_JOB_SIZE (4 << 20) //compressed bytes per parallel job
+#define DECOMPRESS_PARTS_AHEAD 4 //parts a job may decompress before the reader gets to them
+#define DECOMPRESS_MAX_INPUT (1 << 30) //zlib and libbz2 count input in 32 bits, so mapped input is fed in pieces
+
+//Where a job reads its compressed input from
+struct Decompressor::JobInput{
+    bool memory; //a piece of the mapped file, otherwise fd
+    size_t pos; //next offset into the mapped file
+    bool prefixDone;
+    std::vector<char> buffer;
+};
+
+//Collects a job's output into parts and queues them in order
+struct Decompressor::JobOutput{
+    Decompressor* owner;
+    uint64_t job, part;
+    size_t start;
+    std::vector<char> data;
+    size_t used;
+    bool stopped;
+
+    //Returns space for more output
+    char* space(size_t& available){
+        if(data.size() != DECOMPRESS_CHUNK_SIZE){
+            data.resize(DECOMPRESS_CHUNK_SIZE);
+        }
+        available = data.size() - used;
+        return data.data() + used;
+    }
+
+    void produced(size_t length){
+        used += length;
+        if(used == data.size()){
+            flush(false, 0, true);
+        }
+    }
+
+    void flush(bool last, size_t end, bool ok){
+        Chunk chunk;
+        data.resize(used);
+        chunk.data.swap(data);
+        chunk.start = start, chunk.end = end, chunk.ok = ok, chunk.last = last;
+        used = 0;
+        if(!owner->post(job, part++, chunk)){
+            stopped = true;
+        }
+    }
+};
+
+int detectCompression(const char* data, size_t length){
+    const unsigned char* d = (const unsigned char*) data;
+    if(length >= 2 && d[0] == 0x1f && d[1] == 0x8b){
+        return COMPRESSION_GZIP;
+    }
+    if(length >= 3 && d[0] == 'B' && d[1] == 'Z' && d[2] == 'h'){
+        return COMPRESSION_BZIP2;
+    }
+    if(length >= 4 && d[0] == 0x28 && d[1] == 0xb5 && d[2] == 0x2f && d[3] == 0xfd){
+        return COMPRESSION_ZSTD;
+    }
+    return COMPRESSION_NONE;
+}
+
+const char* compressionName(int format){
+    switch(format){
+        case COMPRESSION_GZIP: return "gzip";
+        case COMPRESSION_BZIP2: return "bzip2";
+        case COMPRESSION_ZSTD: return "zstd";
+        default: return "none";
+    }
+}
+
+//Returns the total size of the BGZF block at data, or 0 if it isn't one
+static size_t bgzfBlockSize(const char* data, size_t length){
+    const unsigned char* d = (const unsigned char*) data;
+    if(length < 18 || d[0] != 0x1f || d[1] != 0x8b || d[2] != 8 || !(d[3] & 4)){
+        return 0;
+    }
+    size_t extraEnd = 12 + (d[10] | (d[11] << 8));
+    for(size_t pos = 12; pos + 4 <= extraEnd && pos + 4 <= length; ){
+        size_t fieldLength = d[pos+2] | (d[pos+3] << 8);
+        if(d[pos] == 'B' && d[pos+1] == 'C' && fieldLength == 2 && pos + 6 <= length){
+            return (d[pos+4] | (d[pos+5] << 8)) + 1;
+        }
+        pos += 4 + fieldLength;
+    }
+    return 0;
+}
+
+//True if a bzip2 stream starts at data: "BZh", the block size digit, then the block magic (the BCD digits of pi)
+static bool isBzip2StreamStart(const char* data, size_t length){
+    static const unsigned char blockMagic[6] = {0x31, 0x41, 0x59, 0x26, 0x53, 0x59};
+    return length >= 10 && data[0] == 'B' && data[1] == 'Z' && data[2] == 'h' && data[3] >= '1' && data[3] <= '9'
+        && memcmp(data + 4, blockMagic, 6) == 0;
+}
+
+Decompressor::Decompressor(const char* data, size_t length, int compression, int threadCount){
+    format = compression;
+    input = data;
+    inputLength = length;
+    fd = -1;
+    nextJobStart = 0;
+    nextJob = 0, consumeJob = 0, consumePart = 0;
+    maxJobsAhead = 1;
+    runningThreads = 0;
+    stopping = false;
+    currentPos = 0;
+    verifiedEnd = 0;
+    finished = false;
+
+    parallel = format == COMPRESSION_BZIP2 || (format == COMPRESSION_GZIP && bgzfBlockSize(data, length) > 0);
+#ifdef HAVE_ZSTD
+    parallel = parallel || format == COMPRESSION_ZSTD;
+#endif
+    if(parallel){
+        startParallel(std::max(threadCount, 1));
+    }
+    else{
+        startStream(0, 0);
+    }
+}
+
+Decompressor::Decompressor(int file, const char* prefixData, size_t prefixLength, int compression){
+    format = compression;
+    input = nullptr;
+    inputLength = 0;
+    fd = file;
+    prefix.assign(prefixData, prefixData + prefixLength);
+    nextJobStart = 0;
+    nextJob = 0, consumeJob = 0, consumePart = 0;
+    maxJobsAhead = 1;
+    runningThreads = 0;
+    stopping = false;
+    currentPos = 0;
+    verifiedEnd = 0;
+    finished = false;
+    parallel = false;
+    startStream(0, 0);
+}
+
+Decompressor::~Decompressor(){
+    stopThreads();
+}
+
+bool Decompressor::isParallel(){
+    return parallel;
+}
+
+void Decompressor::startStream(uint64_t job, size_t start){
+    nextJob = job + 1;
+    runningThreads = 1;
+    threads.push_back(std::thread([this, job, start](){
+        runJob(job, start, (size_t)-1);
+        std::lock_guard<std::mutex> guard(lock);
+        runningThreads--;
+        changed.notify_all();
+    }));
+}
+
+void Decompressor::startParallel(int count){
+    maxJobsAhead = 2*count;
+    runningThreads = count;
+    for(int i = 0; i < count; i++){
+        threads.push_back(std::thread(&Decompressor::parallelWorker, this));
+    }
+}
+
+void Decompressor::stopThreads(){
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+        changed.notify_all();
+    }
+    for(auto& t : threads){
+        t.join();
+    }
+    threads.clear();
+    chunks.clear();
+    stopping = false;
+}
+
+void Decompressor::parallelWorker(){
+    while(true){
+        uint64_t job;
+        size_t start, end;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [&]{ return stopping || nextJob < consumeJob + maxJobsAhead; });
+            if(stopping || nextJobStart >= inputLength){
+                break;
+            }
+            job = nextJob++;
+            start = nextJobStart;
+            end = findJobEnd(start);
+            nextJobStart = end;
+        }
+        runJob(job, start, end - start);
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    runningThreads--;
+    changed.notify_all();
+}
+
+size_t Decompressor::findJobEnd(size_t start){
+    size_t pos = start;
+    if(format == COMPRESSION_GZIP){
+        while(pos < inputLength && pos - start < DECOMPRESS_JOB_SIZE){
+            size_t blockSize = bgzfBlockSize(input + pos, inputLength - pos);
+            if(blockSize == 0 || blockSize > inputLength - pos){
+                return inputLength; //not BGZF from here on, so the rest is one job
+            }
+            pos += blockSize;
+        }
+        return pos;
+    }
+#ifdef HAVE_ZSTD
+    if(format == COMPRESSION_ZSTD){
+        while(pos < inputLength && pos - start < DECOMPRESS_JOB_SIZE){
+            size_t frameSize = ZSTD_findFrameCompressedSize(input + pos, inputLength - pos);
+            if(ZSTD_isError(frameSize)){
+                return inputLength;
+            }
+            pos += frameSize;
+        }
+        return pos;
+    }
+#endif
+    //bzip2: the next stream start at least a job size on.  A match inside a stream is caught by the reader.
+    pos = start + DECOMPRESS_JOB_SIZE;
+    while(pos < inputLength){
+        const char* found = (const char*) memmem(input + pos, inputLength - pos, "BZh", 3);
+        if(!found){
+            break;
+        }
+        pos = found - input;
+        if(isBzip2StreamStart(found, inputLength - pos)){
+            return pos;
+        }
+        pos++;
+    }
+    return inputLength;
+}
+
+void Decompressor::runJob(uint64_t job, size_t start, size_t stopAfter){
+    JobInput in;
+    in.memory = input != nullptr;
+    in.pos = start;
+    in.prefixDone = false;
+    JobOutput out;
+    out.owner = this;
+    out.job = job, out.part = 0;
+    out.start = start;
+    out.used = 0;
+    out.stopped = false;
+
+    size_t consumed = 0;
+    bool ok;
+    switch(format){
+        case COMPRESSION_GZIP: ok = decodeGzip(in, out, stopAfter, consumed); break;
+        case COMPRESSION_BZIP2: ok = decodeBzip2(in, out, stopAfter, consumed); break;
+        default: ok = decodeZstd(in, out, stopAfter, consumed); break;
+    }
+    if(!out.stopped){
+        out.flush(true, start + consumed, ok);
+    }
+}
+
+bool Decompressor::post(uint64_t job, uint64_t part, Chunk& chunk){
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [&]{
+        return stopping || (job == consumeJob ? part < consumePart + DECOMPRESS_PARTS_AHEAD : part < DECOMPRESS_PARTS_AHEAD);
+    });
+    if(stopping){
+        return false;
+    }
+    chunks[std::make_pair(job, part)] = std::move(chunk);
+    changed.notify_all();
+    return true;
+}
+
+bool Decompressor::nextInput(JobInput& in, const char*& data, size_t& length){
+    if(in.memory){
+        if(in.pos >= inputLength){
+            return false;
+        }
+        data = input + in.pos;
+        length = std::min(inputLength - in.pos, (size_t)DECOMPRESS_MAX_INPUT);
+        in.pos += length;
+        return true;
+    }
+    if(!in.prefixDone){
+        in.prefixDone = true;
+        if(!prefix.empty()){
+            data = prefix.data();
+            length = prefix.size();
+            return true;
+        }
+    }
+    in.buffer.resize(DECOMPRESS_CHUNK_SIZE);
+    ssize_t count;
+    do{
+        count = ::read(fd, in.buffer.data(), in.buffer.size());
+    } while(count < 0 && errno == EINTR);
+    if(count <= 0){
+        return false;
+    }
+    data = in.buffer.data();
+    length = count;
+    return true;
+}
+
+bool Decompressor::decodeGzip(JobInput& in, JobOutput& out, size_t stopAfter, size_t& consumed){
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if(inflateInit2(&z, 15 + 32) != Z_OK){
+        return false;
+    }
+    size_t given = 0;
+    bool inMember = false, ok = true;
+    const char* data;
+    size_t length;
+    while(!out.stopped){
+        if(z.avail_in == 0){
+            if(!nextInput(in, data, length)) break;
+            z.next_in = (Bytef*) data;
+            z.avail_in = length;
+            given += length;
+        }
+        if(!inMember){
+            consumed = given - z.avail_in;
+            if(consumed >= stopAfter || z.next_in[0] != 0x1f){ //done, or padding after the last member
+                break;
+            }
+            inflateReset(&z);
+            inMember = true;
+        }
+        size_t available;
+        z.next_out = (Bytef*) out.space(available);
+        z.avail_out = available;
+        int ret = inflate(&z, Z_NO_FLUSH);
+        out.produced(available - z.avail_out);
+        if(ret == Z_STREAM_END){
+            inMember = false;
+        }
+        else if(ret != Z_OK && ret != Z_BUF_ERROR){
+            ok = false;
+            break;
+        }
+    }
+    consumed = given - z.avail_in;
+    inflateEnd(&z);
+    return ok && !inMember;
+}
+
+bool Decompressor::decodeBzip2(JobInput& in, JobOutput& out, size_t stopAfter, size_t& consumed){
+    bz_stream b;
+    memset(&b, 0, sizeof(b));
+    size_t given = 0;
+    bool inStream = false, ok = true;
+    const char* data;
+    size_t length;
+    while(!out.stopped){
+        if(b.avail_in == 0){
+            if(!nextInput(in, data, length)) break;
+            b.next_in = (char*) data;
+            b.avail_in = length;
+            given += length;
+        }
+        if(!inStream){
+            consumed = given - b.avail_in;
+            if(consumed >= stopAfter || b.next_in[0] != 'B'){ //done, or padding after the last stream
+                break;
+            }
+            char* nextIn = b.next_in;
+            unsigned int availIn = b.avail_in;
+            if(BZ2_bzDecompressInit(&b, 0, 0) != BZ_OK){
+                ok = false;
+                break;
+            }
+            b.next_in = nextIn, b.avail_in = availIn;
+            inStream = true;
+        }
+        size_t available;
+        b.next_out = out.space(available);
+        b.avail_out = available;
+        int ret = BZ2_bzDecompress(&b);
+        out.produced(available - b.avail_out);
+        if(ret == BZ_STREAM_END){
+            BZ2_bzDecompressEnd(&b);
+            inStream = false;
+        }
+        else if(ret != BZ_OK){
+            ok = false;
+            break;
+        }
+    }
+    consumed = given - b.avail_in;
+    if(inStream){
+        BZ2_bzDecompressEnd(&b);
+    }
+    return ok && !inStream;
+}
+
+bool Decompressor::decodeZstd(JobInput& in, JobOutput& out, size_t stopAfter, size_t& consumed){
+#ifdef HAVE_ZSTD
+    ZSTD_DStream* stream = ZSTD_createDStream();
+    ZSTD_initDStream(stream);
+    ZSTD_inBuffer inBuffer = {nullptr, 0, 0};
+    size_t given = 0;
+    bool inFrame = false, ok = true;
+    const char* data;
+    size_t length;
+    while(!out.stopped){
+        if(inBuffer.pos == inBuffer.size){
+            if(!nextInput(in, data, length)) break;
+            inBuffer.src = data, inBuffer.size = length, inBuffer.pos = 0;
+            given += length;
+        }
+        if(!inFrame){
+            consumed = given - (inBuffer.size - inBuffer.pos);
+            if(consumed >= stopAfter){
+                break;
+            }
+            inFrame = true;
+        }
+        size_t available;
+        ZSTD_outBuffer outBuffer = {out.space(available), 0, 0};
+        outBuffer.size = available;
+        size_t ret = ZSTD_decompressStream(stream, &outBuffer, &inBuffer);
+        out.produced(outBuffer.pos);
+        if(ZSTD_isError(ret)){
+            ok = false;
+            break;
+        }
+        if(ret == 0){
+            inFrame = false;
+        }
+    }
+    consumed = given - (inBuffer.size - inBuffer.pos);
+    ZSTD_freeDStream(stream);
+    return ok && !inFrame;
+#else
+    (void)in; (void)out; (void)stopAfter; (void)consumed;
+    fprintf(stderr, "This input is zstd compressed, but faucet was built without zstd support (make ZSTD=1)\n");
+    exit(1);
+#endif
+}
+
+size_t Decompressor::read(char* dest, size_t maxLength){
+    while(currentPos == current.data.size()){
+        if(finished){
+            return 0;
+        }
+        bool fallBack = false;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            auto key = std::make_pair(consumeJob, consumePart);
+            changed.wait(guard, [&]{ return chunks.count(key) || runningThreads == 0; });
+            if(!chunks.count(key)){
+                finished = true;
+                return 0;
+            }
+            current = std::move(chunks[key]);
+            chunks.erase(key);
+            currentPos = 0;
+            if(parallel && consumePart == 0 && current.start != verifiedEnd){
+                fallBack = true; //the previous job ran past this split, so it wasn't a real stream start
+            }
+            else{
+                consumePart++;
+                if(current.last){
+                    consumeJob++, consumePart = 0;
+                    verifiedEnd = current.end;
+                }
+                changed.notify_all();
+            }
+        }
+        if(fallBack){
+            fprintf(stderr, "Split inside a %s stream at byte %zu, decompressing the rest on one thread\n", compressionName(format), current.start);
+            stopThreads();
+            parallel = false;
+            current.data.clear();
+            startStream(consumeJob, verifiedEnd);
+            continue;
+        }
+        if(!current.ok){
+            fprintf(stderr, "Corrupt or truncated %s input near byte %zu\n", compressionName(format), current.end);
+            exit(1);
+        }
+    }
+    size_t length = std::min(maxLength, current.data.size() - currentPos);
+    memcpy(dest, current.data.data() + currentPos, length);
+    currentPos += length;
+    return length;
+}
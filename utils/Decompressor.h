@@ -0,0 +1,100 @@
+#ifndef DECOMPRESSOR
+#define DECOMPRESSOR
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#define COMPRESSION_NONE 0
+#define COMPRESSION_GZIP 1
+#define COMPRESSION_BZIP2 2
+#define COMPRESSION_ZSTD 3 //only decompressed when built with HAVE_ZSTD
+
+//Returns the compression format of a file from its first bytes
+int detectCompression(const char* data, size_t length);
+const char* compressionName(int format);
+
+//Decompresses gzip, bzip2 or zstd input on background threads, which feed a bounded queue of decompressed chunks.
+//
+//A stream (a pipe, or a file that couldn't be mapped) is decompressed by one thread.  Multi-member gzip and
+//multi-stream bzip2 are followed from one member to the next.
+//A mapped file is cut into jobs that workers decompress in parallel when its format has independent pieces that can be
+//found without decompressing: BGZF blocks, whose headers give their sizes, and bzip2 streams, which start on a
+//byte boundary with a magic number.  A bzip2 split is only trusted once the previous job's last stream ends exactly
+//there; otherwise the rest of the file is decompressed by a single thread from the last stream end.
+//Anything else is decompressed by one thread, as for a stream.
+class Decompressor{
+public:
+    //Decompresses a mapped file with up to threads workers
+    Decompressor(const char* data, size_t length, int format, int threads);
+    //Decompresses the stream read from fd.  prefix holds bytes already read from fd.
+    Decompressor(int fd, const char* prefix, size_t prefixLength, int format);
+    ~Decompressor();
+
+    //Copies up to maxLength decompressed bytes to dest, waiting until some are ready.  Returns 0 at the end of the data.
+    size_t read(char* dest, size_t maxLength);
+
+    bool isParallel(); //true if the file is being decompressed in parallel jobs
+
+private:
+    //A piece of the output.  Jobs are numbered in file order and each job's output comes in numbered parts.
+    //start is where the job's compressed input starts, and end where it stopped, set on its last part.
+    struct Chunk{
+        std::vector<char> data;
+        size_t start, end;
+        bool ok; //false if the input couldn't be decompressed
+        bool last; //last part of its job
+    };
+    struct JobInput;
+    struct JobOutput;
+
+    int format;
+    bool parallel;
+
+    //input: a mapped file, or a stream read from fd after prefix
+    const char* input;
+    size_t inputLength;
+    int fd;
+    std::vector<char> prefix;
+
+    //shared with the worker threads, guarded by lock
+    std::mutex lock;
+    std::condition_variable changed;
+    std::map<std::pair<uint64_t, uint64_t>, Chunk> chunks; //finished parts by (job, part)
+    size_t nextJobStart;
+    uint64_t nextJob; //next job to hand out
+    uint64_t consumeJob, consumePart; //next part the reader wants
+    uint64_t maxJobsAhead;
+    int runningThreads;
+    bool stopping;
+    std::vector<std::thread> threads;
+
+    //reader side
+    Chunk current;
+    size_t currentPos;
+    size_t verifiedEnd; //compressed offset where the last fully read job ended
+    bool finished;
+
+    void startStream(uint64_t job, size_t start);
+    void startParallel(int count);
+    void stopThreads();
+    void parallelWorker();
+    void runJob(uint64_t job, size_t start, size_t stopAfter);
+    //Waits until the reader is close enough to this part, then queues it.  Returns false when the threads are stopping.
+    bool post(uint64_t job, uint64_t part, Chunk& chunk);
+
+    size_t findJobEnd(size_t start); //end of the job starting at start, on a block or stream boundary
+
+    bool nextInput(JobInput& in, const char*& data, size_t& length);
+    //Each decodes members/streams/frames from in until the input runs out or one ends at or after stopAfter bytes.
+    //consumed is set to the compressed bytes used.  Returns false on corrupt or truncated input.
+    bool decodeGzip(JobInput& in, JobOutput& out, size_t stopAfter, size_t& consumed);
+    bool decodeBzip2(JobInput& in, JobOutput& out, size_t stopAfter, size_t& consumed);
+    bool decodeZstd(JobInput& in, JobOutput& out, size_t stopAfter, size_t& consumed);
+};
+
+#endif
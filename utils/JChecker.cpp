@@ -9,6 +9,15 @@ bool JChecker::jcheck(char* kmerSeq, uint64_t nextH0, uint64_t nextH1){
   if(j == 0){
     return true;
   }
+  if(engine == JCHECK_DFS){
+    JCheckNode root;
+    root.hash0 = nextH0;
+    root.hash1 = nextH1;
+    incrementalSeq = kmerSeq;
+    bool found = depthFirst(root);
+    incrementalSeq = nullptr;
+    return found;
+  }
   uint64_t workingHash0, workingHash1;
   int lastCount, nextCount;
   lastCount = 1;
@@ -44,16 +53,33 @@ bool JChecker::jcheck(char* kmerSeq, uint64_t nextH0, uint64_t nextH1){
     lastHashes = nextHashes;
     nextHashes = tempor;
   }
+  return true;
 }
     
 //Normal version of jchecking, without rolling hash.  
 //Old hash! use only for old hash!  For kpomerscanner
 bool JChecker::jcheck(kmer_type kmer){
+  if(engine == JCHECK_DFS){
+    JCheckNode root;
+    root.kmer = kmer;
+    if(bloom->getHashMode() == BLOOM_HASH_ROLLING) root.state = bloom->rollingState(kmer);
+    if(bloom->getLayout() == BLOOM_MINIMIZER) root.min = bloom->minimizerOf(kmer);
+    return depthFirst(root);
+  }
+  if(bloom->getHashMode() == BLOOM_HASH_ROLLING){
+    return jcheckRolling(kmer);
+  }
   kmer_type this_kmer, nextKmer;
   int lastCount, nextCount;
+  //in the minimizer layout each kmer's minimizer is kept next to it, and extended to its extensions
+  bool minimizers = bloom->getLayout() == BLOOM_MINIMIZER;
+  Minimizer nextMin;
+  uint64_t hashA, hashB;
+  Minimizer* tempMins;
 
   lastCount = 1;
   lastKmers[0] = kmer;
+  if(minimizers) lastMins[0] = bloom->minimizerOf(kmer);
 
   for(int i = 0; i < j; i++){ //for up to j levels
     nextCount = 0;
@@ -61,8 +87,18 @@ bool JChecker::jcheck(kmer_type kmer){
       this_kmer = lastKmers[k];
       for(int nt = 0; nt < 4; nt++){ //for every possible extension
         nextKmer = next_kmer(this_kmer, nt, FORWARD);
-        if(bloom->oldContains(get_canon(nextKmer))){//add any positive extensions to the next level
+        bool found;
+        if(minimizers){
+          nextMin = bloom->extendMinimizer(lastMins[k], nextKmer);
+          bloom->kmerHashes(get_canon(nextKmer), hashA, hashB);
+          found = bloom->contains(Bloom::withMinimizer(hashA, nextMin.hash), hashB);
+        }
+        else{
+          found = bloom->oldContains(get_canon(nextKmer));
+        }
+        if(found){//add any positive extensions to the next level
           nextKmers[nextCount] = nextKmer;
+          if(minimizers) nextMins[nextCount] = nextMin;
           nextCount++;
         }
       }
@@ -75,13 +111,277 @@ bool JChecker::jcheck(kmer_type kmer){
     temp = lastKmers;
     lastKmers = nextKmers;
     nextKmers = temp;
+    tempMins = lastMins;
+    lastMins = nextMins;
+    nextMins = tempMins;
+  }
+  return true;
+}
+
+//Same search as jcheck, with each kmer's hash state kept next to it so the hashes of its extensions are rolled
+//from it instead of computed from scratch
+bool JChecker::jcheckRolling(kmer_type kmer){
+  int lastCount, nextCount;
+  uint64_t hashA, hashB;
+  RollingHash* tempStates;
+  bool minimizers = bloom->getLayout() == BLOOM_MINIMIZER;
+  Minimizer nextMin;
+  Minimizer* tempMins;
+
+  lastCount = 1;
+  lastKmers[0] = kmer;
+  lastStates[0] = bloom->rollingState(kmer);
+  if(minimizers) lastMins[0] = bloom->minimizerOf(kmer);
+
+  for(int i = 0; i < j; i++){
+    nextCount = 0;
+    for(int k = 0; k < lastCount; k++){
+      int outNt = (int)(lastKmers[k] >> (2*sizeKmer - 2)) & 3;
+      for(int nt = 0; nt < 4; nt++){
+        RollingHash state = bloom->roll(lastStates[k], outNt, nt);
+        kmer_type nextKmer = next_kmer(lastKmers[k], nt, FORWARD);
+        bloom->rollingHashes(state, hashA, hashB);
+        if(minimizers){
+          nextMin = bloom->extendMinimizer(lastMins[k], nextKmer);
+          hashA = Bloom::withMinimizer(hashA, nextMin.hash);
+        }
+        if(bloom->contains(hashA, hashB)){
+          nextKmers[nextCount] = nextKmer;
+          nextStates[nextCount] = state;
+          if(minimizers) nextMins[nextCount] = nextMin;
+          nextCount++;
+        }
+      }
+    }
+    if(nextCount == 0){
+      return false;
+    }
+    lastCount = nextCount;
+    temp = lastKmers;
+    lastKmers = nextKmers;
+    nextKmers = temp;
+    tempStates = lastStates;
+    lastStates = nextStates;
+    nextStates = tempStates;
+    tempMins = lastMins;
+    lastMins = nextMins;
+    nextMins = tempMins;
   }
   return true;
 }
 
+//Depth first search from root for a path of j extensions in the filter.  Each kmer on the path keeps the extensions
+//it has left to try, so the search backs up to the deepest kmer with one left when a branch dies out.
+bool JChecker::depthFirst(JCheckNode root){
+  if(j == 0){
+    return true;
+  }
+  path.clear();
+  root.pending = probeExtensions(root, 0);
+  path.push_back(root);
+  while(!path.empty()){
+    int depth = path.size() - 1;
+    JCheckNode& node = path.back();
+    if(node.pending == 0){
+      path.pop_back();
+      continue;
+    }
+    if(depth + 1 == j){
+      return true; //an extension of the last kmer of the path is the j-th
+    }
+    int nt = __builtin_ctz(node.pending);
+    node.pending &= node.pending - 1;
+    JCheckNode next = extend(node, nt, depth);
+    next.pending = probeExtensions(next, depth + 1);
+    path.push_back(next);
+  }
+  return false;
+}
+
+JCheckNode JChecker::extend(const JCheckNode& node, int nt, int depth){
+  JCheckNode next;
+  if(incrementalSeq){
+    next.hash0 = bloom->roll_hash(node.hash0, NT2int(incrementalSeq[depth]), nt, 0);
+    next.hash1 = bloom->roll_hash(node.hash1, NT2int(incrementalSeq[depth]), nt, 1);
+    return next;
+  }
+  next.kmer = next_kmer(node.kmer, nt, FORWARD);
+  if(bloom->getHashMode() == BLOOM_HASH_ROLLING){
+    next.state = bloom->roll(node.state, (int)(node.kmer >> (2*sizeKmer - 2)) & 3, nt);
+  }
+  if(bloom->getLayout() == BLOOM_MINIMIZER){
+    next.min = bloom->extendMinimizer(node.min, next.kmer);
+  }
+  return next;
+}
+
+int JChecker::probeExtensions(const JCheckNode& node, int depth){
+  uint64_t hashA[4], hashB[4];
+  if(incrementalSeq){
+    for(int nt = 0; nt < 4; nt++){
+      hashA[nt] = bloom->roll_hash(node.hash0, NT2int(incrementalSeq[depth]), nt, 0);
+      hashB[nt] = bloom->roll_hash(node.hash1, NT2int(incrementalSeq[depth]), nt, 1);
+    }
+  }
+  else if(bloom->getHashMode() == BLOOM_HASH_ROLLING){
+    int outNt = (int)(node.kmer >> (2*sizeKmer - 2)) & 3;
+    for(int nt = 0; nt < 4; nt++){
+      bloom->rollingHashes(bloom->roll(node.state, outNt, nt), hashA[nt], hashB[nt]);
+    }
+  }
+  else if(bloom->getLayout() == BLOOM_MINIMIZER){
+    for(int nt = 0; nt < 4; nt++){
+      bloom->kmerHashes(get_canon(next_kmer(node.kmer, nt, FORWARD)), hashA[nt], hashB[nt]);
+    }
+  }
+  else{
+    //the old hash of the canonical extensions, or the kmers themselves for exact and fake filters
+    return bloom->extensionMask(DoubleKmer(node.kmer), FORWARD);
+  }
+  if(!incrementalSeq && bloom->getLayout() == BLOOM_MINIMIZER){
+    for(int nt = 0; nt < 4; nt++){
+      hashA[nt] = Bloom::withMinimizer(hashA[nt], bloom->extendMinimizer(node.min, next_kmer(node.kmer, nt, FORWARD)).hash);
+    }
+  }
+  for(int nt = 0; nt < 4; nt++){
+    bloom->prefetch(hashA[nt], hashB[nt]);
+  }
+  int mask = 0;
+  for(int nt = 0; nt < 4; nt++){
+    if(bloom->contains(hashA[nt], hashB[nt])){
+      mask |= 1 << nt;
+    }
+  }
+  return mask;
+}
+
+void JChecker::setEngine(int engineVal){
+    engine = engineVal;
+}
+
+int JChecker::getEngine(){
+    return engine;
+}
+
+bool JChecker::jcheckExtension(kmer_type kmer, int nt){
+  if(!cache){
+    return jcheck(next_kmer(kmer, nt, FORWARD));
+  }
+  int cached = cache->lookup(kmer, nt);
+  if(cached >= 0){
+    cacheHits++;
+    return cached;
+  }
+  cacheMisses++;
+  bool passed = jcheck(next_kmer(kmer, nt, FORWARD));
+  cache->record(kmer, nt, passed);
+  return passed;
+}
+
+void JChecker::setCache(JCheckCache* jcheckCache){
+    cache = jcheckCache;
+}
+
+JCheckCache* JChecker::getCache(){
+    return cache;
+}
+
+void JChecker::printCacheSummary(const char* stage){
+    if(!cache){
+        return;
+    }
+    uint64_t lookups = cacheHits + cacheMisses;
+    printf("J-check cache during the %s: %llu hits, %llu misses, hit rate %f\n", stage, (unsigned long long)cacheHits,
+        (unsigned long long)cacheMisses, lookups ? (double)cacheHits/lookups : 0.0);
+    cacheHits = cacheMisses = 0;
+}
+
+JCheckCache::JCheckCache(uint64_t bytes){
+    uint64_t sets = 1;
+    while(2*sets*JCHECK_CACHE_WAYS*sizeof(JCheckCacheEntry) <= bytes){
+        sets <<= 1;
+    }
+    setMask = sets - 1;
+    //known == 0 marks an empty entry
+    entries = new JCheckCacheEntry[sets*JCHECK_CACHE_WAYS]();
+    locks = new std::mutex[1 << JCHECK_CACHE_LOCK_BITS];
+    concurrent = false;
+}
+
+JCheckCache::~JCheckCache(){
+    delete[] entries;
+    delete[] locks;
+}
+
+uint64_t JCheckCache::getEntries(){
+    return (setMask + 1)*JCHECK_CACHE_WAYS;
+}
+
+void JCheckCache::startConcurrent(){
+    concurrent = true;
+}
+
+void JCheckCache::finishConcurrent(){
+    concurrent = false;
+}
+
+uint64_t JCheckCache::getSet(kmer_type canon){
+    return Bloom::finalize(canon) & setMask;
+}
+
+JCheckCacheEntry* JCheckCache::find(JCheckCacheEntry* set, kmer_type canon){
+    for(int way = 0; way < JCHECK_CACHE_WAYS; way++){
+        if(set[way].known && set[way].canon == canon){
+            return &set[way];
+        }
+    }
+    return nullptr;
+}
+
+int JCheckCache::lookup(kmer_type kmer, int nt){
+    kmer_type canon = get_canon(kmer);
+    int bit = 1 << (nt + (canon == kmer ? 0 : 4));
+    uint64_t set = getSet(canon);
+    std::unique_lock<std::mutex> guard;
+    if(concurrent) guard = std::unique_lock<std::mutex>(locks[set & ((1 << JCHECK_CACHE_LOCK_BITS) - 1)]);
+    JCheckCacheEntry* entry = find(&entries[set*JCHECK_CACHE_WAYS], canon);
+    if(!entry || !(entry->known & bit)){
+        return -1;
+    }
+    return (entry->passed & bit) ? 1 : 0;
+}
+
+void JCheckCache::record(kmer_type kmer, int nt, bool passed){
+    kmer_type canon = get_canon(kmer);
+    int bit = 1 << (nt + (canon == kmer ? 0 : 4));
+    uint64_t setIndex = getSet(canon);
+    std::unique_lock<std::mutex> guard;
+    if(concurrent) guard = std::unique_lock<std::mutex>(locks[setIndex & ((1 << JCHECK_CACHE_LOCK_BITS) - 1)]);
+    JCheckCacheEntry* set = &entries[setIndex*JCHECK_CACHE_WAYS];
+    JCheckCacheEntry* entry = find(set, canon);
+    if(!entry){
+        for(int way = 0; way < JCHECK_CACHE_WAYS && !entry; way++){
+            if(!set[way].known) entry = &set[way];
+        }
+        if(!entry){
+            entry = &set[(Bloom::finalize(canon) >> 32) % JCHECK_CACHE_WAYS];
+        }
+        entry->canon = canon;
+        entry->known = 0;
+        entry->passed = 0;
+    }
+    entry->known |= bit;
+    if(passed) entry->passed |= bit;
+}
+
 JChecker::JChecker(int jVal, Bloom* bloo){
     j = jVal;
     bloom = bloo;
+    engine = JCHECK_BFS;
+    incrementalSeq = nullptr;
+    cache = nullptr;
+    cacheHits = 0;
+    cacheMisses = 0;
 
     //all this is for rolling hash function.. not relevant now
     lastHashes = new uint64_t*[20000];
@@ -92,4 +392,23 @@ JChecker::JChecker(int jVal, Bloom* bloo){
     }
     lastKmers = new kmer_type[1000];
     nextKmers = new kmer_type[1000];
+    lastStates = new RollingHash[1000];
+    nextStates = new RollingHash[1000];
+    lastMins = new Minimizer[1000];
+    nextMins = new Minimizer[1000];
+}
+
+JChecker::~JChecker(){
+    for(int i = 0; i < 20000; i++){
+        delete[] lastHashes[i];
+        delete[] nextHashes[i];
+    }
+    delete[] lastHashes;
+    delete[] nextHashes;
+    delete[] lastKmers;
+    delete[] nextKmers;
+    delete[] lastStates;
+    delete[] nextStates;
+    delete[] lastMins;
+    delete[] nextMins;
 }
\ No newline at end of file
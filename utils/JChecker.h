@@ -1,9 +1,63 @@
 #ifndef JCHECKER 
 #define JCHECKER
 
+#include <mutex>
+#include <vector>
 #include "Bloom.h"
 #include "Kmer.h"
 
+//J-check engines, see JChecker::setEngine
+#define JCHECK_BFS 0 // level by level: every extension of a level is found before the next level is searched
+#define JCHECK_DFS 1 // depth first, answering as soon as one path is j extensions long
+
+#define JCHECK_CACHE_WAYS 4 // entries of a set of the j-check cache
+#define JCHECK_CACHE_LOCK_BITS 10 // the sets are locked in 2^JCHECK_CACHE_LOCK_BITS stripes while threads share the cache
+
+//One cached kmer: for each strand of the canonical kmer, which forward extensions were j-checked (known), and which of
+//those passed (passed), one bit per nucleotide.  The forward strand is in the low nibble, the reverse complement in the high one.
+struct JCheckCacheEntry{
+    kmer_type canon;
+    unsigned char known;
+    unsigned char passed;
+};
+
+//A bounded set associative cache of j-check results, keyed by canonical kmer, so the contig walks of the graph build
+//and the read scan don't redo the j-check BFS of a branch they already followed.  A full set drops an entry picked by
+//the hash of the new kmer.  Shared by the JCheckers of all scan threads; it locks only between startConcurrent and
+//finishConcurrent.
+class JCheckCache{
+    public:
+        JCheckCache(uint64_t bytes); //at least one set
+        ~JCheckCache();
+
+        //Whether extension nt of kmer, as oriented, passed the j-check: 1 or 0, or -1 if it isn't cached
+        int lookup(kmer_type kmer, int nt);
+        void record(kmer_type kmer, int nt, bool passed);
+
+        void startConcurrent();
+        void finishConcurrent();
+        uint64_t getEntries();
+
+    private:
+        JCheckCacheEntry* entries;
+        uint64_t setMask;
+        bool concurrent;
+        std::mutex* locks;
+
+        uint64_t getSet(kmer_type canon);
+        //the entry of canon in its set, or nullptr
+        JCheckCacheEntry* find(JCheckCacheEntry* set, kmer_type canon);
+};
+
+//A kmer on the current path of the depth first j-check
+struct JCheckNode{
+    kmer_type kmer;
+    RollingHash state; //with BLOOM_HASH_ROLLING
+    Minimizer min; //with BLOOM_MINIMIZER
+    uint64_t hash0, hash1; //the roll_hash hashes, for the incremental version
+    int pending; //extensions in the filter that haven't been searched yet, one bit per nucleotide
+};
+
 class JChecker 
 {
     private:
@@ -19,11 +73,42 @@ class JChecker
         kmer_type* lastKmers;
         kmer_type* nextKmers;
         kmer_type* temp;
+        //their rolling hash states, when the filter uses BLOOM_HASH_ROLLING
+        RollingHash* lastStates;
+        RollingHash* nextStates;
+        //and their minimizers, when the filter uses BLOOM_MINIMIZER
+        Minimizer* lastMins;
+        Minimizer* nextMins;
+
+        bool jcheckRolling(kmer_type kmer);
+
+        //the depth first engine: the path from the kmer being j-checked to the kmer being extended, grown as needed
+        int engine;
+        std::vector<JCheckNode> path;
+        const char* incrementalSeq; //the kmer of the incremental version, nullptr for the normal one
+        bool depthFirst(JCheckNode root);
+        //The extensions of node at the given depth that are in the filter.  The hashes of the four are computed first,
+        //then all their probes are prefetched, then checked.
+        int probeExtensions(const JCheckNode& node, int depth);
+        JCheckNode extend(const JCheckNode& node, int nt, int depth);
+
+        JCheckCache* cache;
 
     public:
         int j; //value of j!
+        uint64_t cacheHits, cacheMisses; //lookups of jcheckExtension answered by the cache, and not
+
         bool jcheck(char* kmerSeq, uint64_t nextH0, uint64_t nextH1);//incremental version
-        bool jcheck(kmer_type kmer);//normal version
+        bool jcheck(kmer_type kmer);//normal version, rolls the hash from each kmer to its extensions with BLOOM_HASH_ROLLING
+        //Whether extension nt of kmer jchecks: jcheck(next_kmer(kmer, nt, FORWARD)), through the cache when there is one
+        bool jcheckExtension(kmer_type kmer, int nt);
+        void setCache(JCheckCache* cache); //not owned, may be shared with other JCheckers
+        JCheckCache* getCache();
+        //JCHECK_BFS by default.  Both engines give the same answers.
+        void setEngine(int engine);
+        int getEngine();
+        void printCacheSummary(const char* stage); //hit rate since the last call, then starts counting again
         JChecker(int jVal, Bloom* bloo);
+        ~JChecker();
 };
 #endif
\ No newline at end of file
@@ -70,6 +70,25 @@ void Junction::update(int nucExt, unsigned char lengthFor){
       dist[nucExt] = max(dist[nucExt], lengthFor);
 }
 
+void Junction::addCoverageAtomic(int nucExt){
+  unsigned char old = __atomic_load_n(&cov[nucExt], __ATOMIC_RELAXED);
+  //saturate at UCHAR_MAX instead of wrapping, like addCoverage
+  while(old != UCHAR_MAX && !__atomic_compare_exchange_n(&cov[nucExt], &old, (unsigned char)(old + 1), true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){}
+}
+
+void Junction::updateAtomic(int nucExt, unsigned char lengthFor){
+  unsigned char old = __atomic_load_n(&dist[nucExt], __ATOMIC_RELAXED);
+  while(old < lengthFor && !__atomic_compare_exchange_n(&dist[nucExt], &old, lengthFor, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){}
+}
+
+void Junction::linkAtomic(int nucExt){
+  __atomic_store_n(&linked[nucExt], true, __ATOMIC_RELAXED);
+}
+
+unsigned char Junction::getDistAtomic(int nucExt){
+  return __atomic_load_n(&dist[nucExt], __ATOMIC_RELAXED);
+}
+
 //"dist dist dist dist dist  cov cov cov cov cov  linked linked linked linked linked " for each of A,C,T,G,Back, in order.
 string Junction::toString(){
   stringstream stream;
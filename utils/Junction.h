@@ -45,6 +45,12 @@ public:
     //Sets linked to true along the given extension.
     void link(int nucExt);
 
+    //Thread-safe versions of the above, used while several threads scan reads into the same junction.
+    void addCoverageAtomic(int nucExt);
+    void updateAtomic(int nucExt, unsigned char length);
+    void linkAtomic(int nucExt);
+    unsigned char getDistAtomic(int nucExt);
+
     //Initializes with 0 coverage, 0 distance, and linked false.
     Junction();
 
@@ -26,6 +26,7 @@ ContigGraph* JunctionMap::buildContigGraph(){
     contigGraph->checkGraph();
     // assert(false);
     fprintf(stderr, "Done building contig graph.\n");
+    jchecker->printCacheSummary("graph build");
     return contigGraph;
 }
 
@@ -472,12 +473,11 @@ void JunctionMap::printDistAndExtension(int dist, int maxDist, int index, kmer_t
 //Returns -1 if there is no valid extension
 //Returns -2 if there are multiple
 int JunctionMap::getValidJExtension(DoubleKmer kmer){
-    kmer_type nextKmer;
     int answer = -1;
+    int mask = bloom->extensionMask(kmer, FORWARD);
     for(int i = 0; i < 4; i++){
-        nextKmer = kmer.getExtension(i, FORWARD);
-        if(bloom->oldContains(get_canon(nextKmer))){
-            if(jchecker->jcheck(nextKmer)){
+        if(mask & (1 << i)){
+            if(jchecker->jcheckExtension(kmer.kmer, i)){
                 if(answer != -1){
                     //Found multiple valid extensions!
                     return -2;
@@ -489,14 +489,13 @@ int JunctionMap::getValidJExtension(DoubleKmer kmer){
     return answer;
 }
 
-//Returns true if multiple extensions of the given kmer jcheck
+//Returns true if multiple extensions of the given kmer are in the BF and jcheck
 //Assumes the given kmer is in the BF
 bool JunctionMap::isBloomJunction(kmer_type kmer){
-    kmer_type ext;
     int pathCount = 0;
+    int mask = bloom->extensionMask(DoubleKmer(kmer), FORWARD);
     for(int i = 0; i < 4; i++){
-        ext = next_kmer(kmer, i, FORWARD);
-        if(jchecker->jcheck(ext)){
+        if((mask & (1 << i)) && jchecker->jcheckExtension(kmer, i)){
             pathCount++;
         }
     }
@@ -531,6 +530,15 @@ int JunctionMap::getSkipDist(ReadKmer* readKmer, bool direction){
 
 //returns the junction if it exists or a null pointer otherwise
 Junction* JunctionMap::getJunction(kmer_type kmer){
+  if(concurrent){
+    JunctionShard* shard = getShard(kmer);
+    std::lock_guard<std::mutex> guard(shard->lock);
+    auto juncIt = shard->junctions.find(kmer);
+    if(juncIt == shard->junctions.end()){
+      return nullptr;
+    }
+    return &(juncIt->second);
+  }
   auto juncIt = junctionMap.find(kmer);
   if(juncIt == junctionMap.end()){
     return nullptr;
@@ -554,6 +562,13 @@ void JunctionMap::directLinkJunctions(ReadKmer* kmer1, ReadKmer* kmer2, Junction
     
     int dist = kmer2->getTotalPos() - kmer1->getTotalPos();
 
+    if(concurrent){
+        junc1->updateAtomic(ext1, dist);
+        junc2->updateAtomic(ext2, dist);
+        junc1->linkAtomic(ext1);
+        junc2->linkAtomic(ext2);
+        return;
+    }
     junc1->update(ext1, dist);
     junc2->update(ext2, dist);
     junc1->link(ext1);
@@ -566,6 +581,12 @@ void JunctionMap::createJunction(ReadKmer* readKmer){
 
 void JunctionMap::createJunction(kmer_type kmer){  
   Junction newJunc;
+  if(concurrent){
+    JunctionShard* shard = getShard(kmer);
+    std::lock_guard<std::mutex> guard(shard->lock);
+    shard->junctions.insert(std::pair<kmer_type, Junction>(kmer, newJunc));
+    return;
+  }
   junctionMap.insert(std::pair<kmer_type, Junction>(kmer, newJunc));
 }
 
@@ -596,19 +617,66 @@ void JunctionMap::writeToFile(string filename){
 }
 
 int JunctionMap::getNumJunctions(){
+    if(concurrent){
+        uint64_t count = 0;
+        for(int i = 0; i < (1 << JUNCTION_SHARD_BITS); i++){
+            std::lock_guard<std::mutex> guard(shards[i].lock);
+            count += shards[i].junctions.size();
+        }
+        return count;
+    }
     return junctionMap.size();
 }
 
+JunctionShard* JunctionMap::getShard(kmer_type kmer){
+    uint64_t h = (uint64_t)kmer * 0x9E3779B97F4A7C15ULL; //spread neighbouring kmers over the shards
+    return &shards[h >> (64 - JUNCTION_SHARD_BITS)];
+}
+
+bool JunctionMap::isConcurrent(){
+    return concurrent;
+}
+
+void JunctionMap::startConcurrentScan(){
+    shards = new JunctionShard[1 << JUNCTION_SHARD_BITS];
+    for(auto it = junctionMap.begin(); it != junctionMap.end(); it++){
+        getShard(it->first)->junctions.insert(*it);
+    }
+    junctionMap.clear();
+    concurrent = true;
+}
+
+//Moves the junctions back into junctionMap one shard at a time, freeing each shard as it goes
+void JunctionMap::finishConcurrentScan(){
+    concurrent = false;
+    uint64_t total = 0;
+    for(int i = 0; i < (1 << JUNCTION_SHARD_BITS); i++){
+        total += shards[i].junctions.size();
+    }
+    junctionMap.reserve(total);
+    for(int i = 0; i < (1 << JUNCTION_SHARD_BITS); i++){
+        junctionMap.insert(shards[i].junctions.begin(), shards[i].junctions.end());
+        std::unordered_map<kmer_type,Junction>().swap(shards[i].junctions);
+    }
+    delete[] shards;
+    shards = nullptr;
+}
+
 bool JunctionMap::isJunction(ReadKmer* readKmer){
   return isJunction(readKmer->getKmer());
 }
 
 bool JunctionMap::isJunction(kmer_type kmer){
+    if(concurrent){
+        return getJunction(kmer) != nullptr;
+    }
     return junctionMap.find(kmer) != junctionMap.end();
 }
 
 JunctionMap::JunctionMap(Bloom* bloo1, JChecker* jcheck, int read_length){
   junctionMap = {};
+  shards = nullptr;
+  concurrent = false;
   bloom = bloo1;
   jchecker = jcheck;
   maxReadLength = read_length;
@@ -4,6 +4,7 @@
 // #include <unordered_map>
 #include <unordered_set>
 #include <string>
+#include <mutex>
 #include "Kmer.h"
 #include "Junction.h"
 #include "Cap.h"
@@ -26,6 +27,14 @@ using std::unordered_set;
 // using spp::sparse_hash_map;
 
 
+#define JUNCTION_SHARD_BITS 8 //the junction table is split into 2^JUNCTION_SHARD_BITS shards during a multithreaded scan
+
+//One independently locked piece of the junction table, used while several threads scan reads
+struct JunctionShard{
+    std::mutex lock;
+    std::unordered_map<kmer_type,Junction> junctions;
+};
+
 class JunctionMap{
 
 private: 
@@ -33,6 +42,12 @@ private:
     JChecker* jchecker; 
     int maxReadLength; //needed for finding sinks properly- tells you when to stop scanning   
 
+    //Between startConcurrentScan and finishConcurrentScan junctions live in these shards instead of junctionMap,
+    //so that createJunction, getJunction and isJunction can be called from several threads.
+    JunctionShard* shards;
+    bool concurrent;
+    JunctionShard* getShard(kmer_type kmer);
+
     
 public:
     void printDistAndExtension(int dist, int maxDist, int index, kmer_type kmer);
@@ -97,6 +112,12 @@ public:
     Junction* getJunction(kmer_type kmer); //same as above
     void killJunction(kmer_type kmer); //removes the junction at the specified kmer, if there is one
 
+    //Switches to the sharded, thread-safe junction table for a multithreaded read scan, and back.
+    //Junction pointers handed out in between stay valid, but their fields must be changed with the Atomic Junction methods.
+    void startConcurrentScan();
+    void finishConcurrentScan();
+    bool isConcurrent();
+
     JunctionMap(Bloom* bloo, JChecker* jchecker, int maxReadLength);
 };
 #endif
\ No newline at end of file
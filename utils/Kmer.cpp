@@ -79,6 +79,24 @@ std::list<std::string> getUnambiguousReads(string read){
     return resultList;
 }
 
+//Fills pieces with spans of the read for the valid nucleotide sequences of length at least k.
+//Like getUnambiguousReads, the last piece on the read comes first.
+void getUnambiguousSpans(ReadSpan read, std::vector<ReadSpan>& pieces){
+    pieces.clear();
+    int index = 0;
+    while(index < read.length){
+        while(index < read.length && !isValidNuc(read.seq[index])){
+            index++;
+        }
+        int start = index;
+        while(index < read.length && isValidNuc(read.seq[index])){
+            index++;
+        }
+        if(index - start >= sizeKmer) pieces.push_back({read.seq + start, index - start});
+    }
+    std::reverse(pieces.begin(), pieces.end());
+}
+
 int NT2int(char nt)
 {
     int i;
@@ -425,8 +443,22 @@ void shift_kmer(kmer_type* graine, int added_nt, bool direction){
 }
 
 
+//Rolls the kmer and its reverse complement along the read together, so no revcomp is needed per kmer
+void getCanonKmers(ReadSpan read, std::vector<kmer_type>& kmers){
+    kmers.clear();
+    kmer_type kmer(0), revcompKmer(0);
+    for(int i = 0; i < read.length; i++){
+        int nt = NT2int(read.seq[i]);
+        shift_kmer(&kmer, nt, FORWARD);
+        shift_kmer(&revcompKmer, revcomp_int(nt), BACKWARD);
+        if(i >= sizeKmer - 1){
+            kmers.push_back(std::min(kmer, revcompKmer));
+        }
+    }
+}
+
 //Tested!
-void getFirstKmerFromRead(kmer_type *kmer, char* read){
+void getFirstKmerFromRead(kmer_type *kmer, const char* read){
       for(int i = 0; i < sizeKmer; i++){
         shift_kmer(kmer, NT2int(read[i]), FORWARD);
       }
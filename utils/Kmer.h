@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <string>
 #include <list>
+#include <vector>
 
 #ifdef _largeint
 #include "LargeInt.h"
@@ -26,8 +27,16 @@ extern const bool FORWARD;
 extern const bool BACKWARD;
 extern uint64_t nsolids;
 
+//A read, or a piece of one, pointing into memory owned by someone else (a mapped file or a SeqBatch, see SeqReader.h)
+struct ReadSpan{
+    const char* seq;
+    int length;
+};
+
 bool isHomoPolymer(std::string str);
 std::list<std::string> getUnambiguousReads(std::string read);//returns every string of valid nuc characters in the read- throws out all other characters 
+void getUnambiguousSpans(ReadSpan read, std::vector<ReadSpan>& pieces);//same as getUnambiguousReads, in the same order, but without copying
+void getCanonKmers(ReadSpan read, std::vector<kmer_type>& kmers);//canonical kmers of an unambiguous read, in read order
 void setSizeKmer(int k);
 char getNucChar(int nucIndex);
 bool isValidNuc(char nt);
@@ -77,7 +86,7 @@ kmer_type maskKmer(kmer_type kmer);
 kmer_type next_kmer(kmer_type graine, int added_nt, bool strand);//returns shifted in a new place
 kmer_type next_kmer(kmer_type graine, int added_nt, int* strand);
 void shift_kmer(kmer_type *graine, int added_nt, int strand); //shifts in place
-void getFirstKmerFromRead(kmer_type* kmer, char* read);
+void getFirstKmerFromRead(kmer_type* kmer, const char* read);
 kmer_type getKmerFromRead(std::string read, int index);//returns kmer starting at position index
 kmer_type next_kmer_in_read(kmer_type kmer, int index_in_read, char* read, bool direction);
 kmer_type advance_kmer(char* read, kmer_type* kmer,  int startPos, int endPos);
@@ -0,0 +1,137 @@
+#include "KmerDB.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static void putLittleEndian(unsigned char* dest, uint64_t value, int bytes){
+    for(int i = 0; i < bytes; i++){
+        dest[i] = (unsigned char)(value >> (8*i));
+    }
+}
+
+static uint64_t getLittleEndian(const unsigned char* src, int bytes){
+    uint64_t value = 0;
+    for(int i = bytes - 1; i >= 0; i--){
+        value = (value << 8) | src[i];
+    }
+    return value;
+}
+
+KmerDBWriter::KmerDBWriter(string filenameVal, int kVal){
+    filename = filenameVal;
+    k = kVal;
+    kmerBytes = (k + 3)/4;
+    count = 0;
+    file = fopen(filename.c_str(), "wb");
+    if(!file){
+        fprintf(stderr, "Could not open kmer database %s: %s\n", filename.c_str(), strerror(errno));
+        return;
+    }
+    writeHeader();
+}
+
+void KmerDBWriter::writeHeader(){
+    unsigned char header[KMER_DB_HEADER_SIZE];
+    memcpy(header, KMER_DB_MAGIC, KMER_DB_MAGIC_LENGTH);
+    putLittleEndian(header + 8, k, 4);
+    putLittleEndian(header + 12, kmerBytes + 4, 4);
+    putLittleEndian(header + 16, count, 8);
+    if(fwrite(header, 1, KMER_DB_HEADER_SIZE, file) != KMER_DB_HEADER_SIZE){
+        fprintf(stderr, "Could not write to kmer database %s: %s\n", filename.c_str(), strerror(errno));
+        exit(1);
+    }
+}
+
+KmerDBWriter::~KmerDBWriter(){
+    if(!file){
+        return;
+    }
+    fseek(file, 0, SEEK_SET);
+    writeHeader();
+    if(fclose(file) != 0){
+        fprintf(stderr, "Could not write to kmer database %s: %s\n", filename.c_str(), strerror(errno));
+        exit(1);
+    }
+}
+
+bool KmerDBWriter::isOpen(){
+    return file != nullptr;
+}
+
+uint64_t KmerDBWriter::getCount(){
+    return count;
+}
+
+void KmerDBWriter::write(kmer_type canon, uint32_t kmerCount){
+    unsigned char record[sizeof(kmer_type) + 4];
+    putLittleEndian(record, canon, kmerBytes);
+    putLittleEndian(record + kmerBytes, kmerCount, 4);
+    if(fwrite(record, 1, kmerBytes + 4, file) != (size_t)(kmerBytes + 4)){
+        fprintf(stderr, "Could not write to kmer database %s: %s\n", filename.c_str(), strerror(errno));
+        exit(1);
+    }
+    count++;
+}
+
+KmerDB::KmerDB(string filename){
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat info;
+    if(fd < 0 || fstat(fd, &info) != 0){
+        fprintf(stderr, "Could not open kmer database %s: %s\n", filename.c_str(), strerror(errno));
+        exit(1);
+    }
+    mapLength = info.st_size;
+    if(mapLength < KMER_DB_HEADER_SIZE){
+        fprintf(stderr, "%s is not a kmer database\n", filename.c_str());
+        exit(1);
+    }
+    void* mapped = mmap(NULL, mapLength, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED){
+        fprintf(stderr, "Could not map kmer database %s: %s\n", filename.c_str(), strerror(errno));
+        exit(1);
+    }
+    map = (const unsigned char*)mapped;
+    madvise(mapped, mapLength, MADV_SEQUENTIAL);
+    if(memcmp(map, KMER_DB_MAGIC, KMER_DB_MAGIC_LENGTH) != 0){
+        fprintf(stderr, "%s is not a kmer database\n", filename.c_str());
+        exit(1);
+    }
+    k = (int)getLittleEndian(map + 8, 4);
+    recordBytes = (int)getLittleEndian(map + 12, 4);
+    recordCount = getLittleEndian(map + 16, 8);
+    kmerBytes = (k + 3)/4;
+    records = map + KMER_DB_HEADER_SIZE;
+    if(k < 1 || 4*sizeof(kmer_type) < (size_t)k || recordBytes != kmerBytes + 4){
+        fprintf(stderr, "Kmer database %s has records for k = %d that can't be read\n", filename.c_str(), k);
+        exit(1);
+    }
+    if((mapLength - KMER_DB_HEADER_SIZE)/recordBytes < recordCount){
+        fprintf(stderr, "Kmer database %s is truncated\n", filename.c_str());
+        exit(1);
+    }
+}
+
+KmerDB::~KmerDB(){
+    munmap((void*)map, mapLength);
+}
+
+int KmerDB::getK(){
+    return k;
+}
+
+uint64_t KmerDB::size(){
+    return recordCount;
+}
+
+uint64_t KmerDB::countSolid(uint32_t minCount){
+    uint64_t solid = 0;
+    for(uint64_t i = 0; i < recordCount; i++){
+        solid += count(i) >= minCount;
+    }
+    return solid;
+}
@@ -0,0 +1,81 @@
+#ifndef KMER_DB
+#define KMER_DB
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+
+#include "Kmer.h"
+
+using std::string;
+
+//A kmer database holds counted kmers, as written by a kmer counter, so the bloom filter can be built from the solid
+//kmers without a pass over the reads.  faucet-kmer-db converts the text dumps of kmer counters to it.
+//
+//Format, all integers little endian:
+//  KMER_DB_MAGIC (8 bytes), k (uint32), bytes per record (uint32), number of records (uint64),
+//  then one record per kmer: the canonical kmer 2-bit packed with the nucleotide codes of NT2int, first base in the
+//  high bits, in the (k+3)/4 low bytes of its integer value, then its count (uint32).
+//A kmer appears at most once, in no particular order.
+#define KMER_DB_MAGIC "FKMERDB1"
+#define KMER_DB_MAGIC_LENGTH 8
+#define KMER_DB_HEADER_SIZE 24
+
+//Writes a kmer database record by record
+class KmerDBWriter{
+public:
+    KmerDBWriter(string filename, int k);
+    ~KmerDBWriter(); //writes the number of records into the header and closes the file
+
+    bool isOpen();
+    void write(kmer_type canon, uint32_t count);
+    uint64_t getCount();
+
+private:
+    FILE* file;
+    string filename;
+    int k;
+    int kmerBytes;
+    uint64_t count;
+
+    void writeHeader();
+};
+
+//A kmer database mapped read-only
+class KmerDB{
+public:
+    //Exits if the file isn't a kmer database
+    KmerDB(string filename);
+    ~KmerDB();
+
+    int getK();
+    uint64_t size(); //number of records
+
+    inline kmer_type kmer(uint64_t i){
+        const unsigned char* record = records + i*recordBytes;
+        kmer_type kmer = 0;
+        for(int b = kmerBytes - 1; b >= 0; b--){
+            kmer = (kmer << 8) | record[b];
+        }
+        return kmer;
+    }
+
+    inline uint32_t count(uint64_t i){
+        const unsigned char* record = records + i*recordBytes + kmerBytes;
+        return record[0] | (record[1] << 8) | (record[2] << 16) | ((uint32_t)record[3] << 24);
+    }
+
+    //Number of records counted at least minCount times
+    uint64_t countSolid(uint32_t minCount);
+
+private:
+    const unsigned char* map;
+    size_t mapLength;
+    const unsigned char* records;
+    int k;
+    int kmerBytes;
+    int recordBytes;
+    uint64_t recordCount;
+};
+
+#endif
@@ -26,7 +26,7 @@ int ReadKmer::getMaxGuaranteedJ(bool dir){
 
 //Returns number of forward operations needed to move to the last kmer on the read
 int ReadKmer::getDistToEnd(){
- return read->length()*2- getTotalPos() - 2*sizeKmer+1;
+ return readLength*2- getTotalPos() - 2*sizeKmer+1;
 }
 
 //Returns the number of forward operations needed to go from the beginning of the read to this ReadKmer
@@ -75,8 +75,8 @@ void ReadKmer::forward(){
         return; //switching from facing backward to forward doesn't entail a shift
     }
     int newNuc = 0;
-    if(pos + sizeKmer <  read->length()){
-        newNuc = NT2int((*read)[pos + sizeKmer]);   
+    if(pos + sizeKmer <  readLength){
+        newNuc = NT2int(read[pos + sizeKmer]);   
     }
     doubleKmer.forward(newNuc);
     pos++;
@@ -106,10 +106,10 @@ kmer_type ReadKmer::getExtension(int newNuc){
 //can be used as an index for the junction
 int ReadKmer::getRealExtensionNuc(){
     if(direction == FORWARD){
-        return NT2int((*read)[sizeKmer + pos]);  
+        return NT2int(read[sizeKmer + pos]);  
     } 
     else{
-        return revcomp_int(NT2int((*read)[pos-1]));
+        return revcomp_int(NT2int(read[pos-1]));
     }
 }
 
@@ -118,20 +118,21 @@ kmer_type ReadKmer::getRealExtension(){
 }
 
 //Starts all the way at the front- facing off the read
-ReadKmer::ReadKmer(string* theRead): doubleKmer(0){
-    read = theRead;
-    kmer_type kmer = 0;
-    getFirstKmerFromRead(&kmer,&((*read)[0]));
-    doubleKmer = DoubleKmer(kmer);
-    pos = 0;
-    direction = BACKWARD;
+ReadKmer::ReadKmer(string* theRead): ReadKmer(ReadSpan{theRead->c_str(), (int)theRead->length()}){
 }
 
 //Creates a double kmer corresponding to the given read, the index into the read, and the direction
-ReadKmer::ReadKmer(string* theRead, int index, bool dir): doubleKmer(0){
-    read = theRead;
-    kmer_type kmer;
-    getFirstKmerFromRead(&kmer,&((*read)[index]));
+ReadKmer::ReadKmer(string* theRead, int index, bool dir): ReadKmer(ReadSpan{theRead->c_str(), (int)theRead->length()}, index, dir){
+}
+
+ReadKmer::ReadKmer(ReadSpan theRead): ReadKmer(theRead, 0, BACKWARD){
+}
+
+ReadKmer::ReadKmer(ReadSpan theRead, int index, bool dir): doubleKmer(0){
+    read = theRead.seq;
+    readLength = theRead.length;
+    kmer_type kmer = 0;
+    getFirstKmerFromRead(&kmer, read + index);
     doubleKmer = DoubleKmer(kmer);
     pos = index;
     direction = dir;
@@ -139,6 +140,7 @@ ReadKmer::ReadKmer(string* theRead, int index, bool dir): doubleKmer(0){
 
 ReadKmer::ReadKmer(ReadKmer* toCopy): doubleKmer(toCopy->doubleKmer){
     read = toCopy->read;
+    readLength = toCopy->readLength;
     doubleKmer = toCopy->doubleKmer;
     pos = toCopy->pos;
     direction = toCopy->direction;
@@ -10,10 +10,12 @@ using std::string;
 
 //Used to represent a kmer with relation to a read.
 //Stores the read, the kmer and revcomp as a DoubleKmer and the position on the read (left end of the kmer). 
+//The read is not copied, so it must outlive the ReadKmer.
 class ReadKmer{
 public:
     //basic fields
-    string* read;
+    const char* read;
+    int readLength;
     DoubleKmer doubleKmer;
     int pos;
     bool direction;
@@ -49,6 +51,8 @@ public:
 
     ReadKmer(string* theRead); //initializes the DoubleKmer to refer to the first kmer in the read
     ReadKmer(string* theRead, int index, bool dir);//Creates a double kmer corresponding to the given read, the index into the read, and the direction
+    ReadKmer(ReadSpan theRead); //same as above, for a read that isn't held in a string
+    ReadKmer(ReadSpan theRead, int index, bool dir);
     ReadKmer(ReadKmer* toCopy); //copy construct
 
 };
@@ -0,0 +1,107 @@
+#include "ReadSpool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+static void appendVarint(uint64_t value, string& block){
+    while(value >= 0x80){
+        block.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    block.push_back((char)value);
+}
+
+void encodeSpoolRecord(std::vector<ReadSpan>& pieces, string& block){
+    appendVarint(pieces.size(), block);
+    for(auto piece = pieces.rbegin(); piece != pieces.rend(); piece++){
+        appendVarint(piece->length, block);
+        unsigned char packed = 0;
+        for(int i = 0; i < piece->length; i++){
+            packed = (packed << 2) | NT2int(piece->seq[i]);
+            if(i % 4 == 3){
+                block.push_back((char)packed);
+                packed = 0;
+            }
+        }
+        if(piece->length % 4 != 0){
+            block.push_back((char)(packed << 2*(4 - piece->length % 4)));
+        }
+    }
+}
+
+//Nucleotide characters for each packed byte
+struct SpoolDecodeTable{
+    char bases[256][4];
+    SpoolDecodeTable(){
+        for(int byte = 0; byte < 256; byte++){
+            for(int i = 0; i < 4; i++){
+                bases[byte][i] = getNucChar((byte >> (6 - 2*i)) & 3);
+            }
+        }
+    }
+};
+
+void decodeSpoolBases(const unsigned char* packed, int length, char* dest){
+    static SpoolDecodeTable table;
+    int i = 0;
+    for(; i + 4 <= length; i += 4){
+        memcpy(dest + i, table.bases[packed[i/4]], 4);
+    }
+    for(; i < length; i++){
+        dest[i] = table.bases[packed[i/4]][i % 4];
+    }
+}
+
+int readSpoolVarint(const unsigned char* data, const unsigned char* end, uint64_t& value){
+    value = 0;
+    for(int i = 0; data + i < end && i < 10; i++){
+        value |= (uint64_t)(data[i] & 0x7f) << (7*i);
+        if(!(data[i] & 0x80)){
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+SpoolWriter::SpoolWriter(string filename){
+    nextIndex = 0;
+    bytesWritten = 0;
+    file = fopen(filename.c_str(), "wb");
+    if(!file){
+        fprintf(stderr, "Could not open spool file %s: %s\n", filename.c_str(), strerror(errno));
+        return;
+    }
+    fwrite(SPOOL_MAGIC, 1, SPOOL_MAGIC_LENGTH, file);
+    bytesWritten = SPOOL_MAGIC_LENGTH;
+}
+
+SpoolWriter::~SpoolWriter(){
+    if(file){
+        fclose(file);
+    }
+}
+
+bool SpoolWriter::isOpen(){
+    return file != nullptr;
+}
+
+uint64_t SpoolWriter::getBytesWritten(){
+    return bytesWritten;
+}
+
+void SpoolWriter::write(uint64_t index, string& block){
+    std::unique_lock<std::mutex> guard(lock);
+    written.wait(guard, [&]{ return index < nextIndex + SPOOL_MAX_PENDING; });
+    pending[index].swap(block);
+    while(!pending.empty() && pending.begin()->first == nextIndex){
+        string& next = pending.begin()->second;
+        if(file && fwrite(next.data(), 1, next.size(), file) != next.size()){
+            fprintf(stderr, "Could not write to the spool file: %s\n", strerror(errno));
+            exit(1);
+        }
+        bytesWritten += next.size();
+        pending.erase(pending.begin());
+        nextIndex++;
+    }
+    written.notify_all();
+}
@@ -0,0 +1,57 @@
+#ifndef READ_SPOOL
+#define READ_SPOOL
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+
+#include "Kmer.h"
+
+using std::string;
+
+//A read spool holds the unambiguous pieces of every read of an input file, 2-bit packed, so a later pass can read them
+//back without the original file.  SeqReader recognizes a spool from its magic number and reads it like any read file.
+//
+//Format: SPOOL_MAGIC, then one record per input read, in file order (so mates of a pair stay adjacent):
+//  number of pieces (varint), then for each piece in read order its length (varint) and its bases packed 4 per byte,
+//  first base in the high bits, with the nucleotide codes of NT2int.
+//Pieces are the runs of valid nucleotides of length at least k, as given by getUnambiguousSpans.
+#define SPOOL_MAGIC "FAUCETSPOOL1\n"
+#define SPOOL_MAGIC_LENGTH 13
+#define SPOOL_MAX_PENDING 64 //batches the writer holds while an earlier batch is still being worked on
+
+//Appends the spool record of one read to block.  pieces are in the order of getUnambiguousSpans (last piece first).
+void encodeSpoolRecord(std::vector<ReadSpan>& pieces, string& block);
+
+//Decodes length packed bases to nucleotide characters
+void decodeSpoolBases(const unsigned char* packed, int length, char* dest);
+
+//Reads a varint at data, returning the number of bytes used, or 0 if it runs past end
+int readSpoolVarint(const unsigned char* data, const unsigned char* end, uint64_t& value);
+
+//Writes a spool from several threads.  Each thread encodes a numbered batch of records, and batches are written in
+//number order, so the spool keeps the order of the input file.
+class SpoolWriter{
+public:
+    SpoolWriter(string filename);
+    ~SpoolWriter(); //closes the file
+
+    bool isOpen();
+    //Writes the records of batch number index once every earlier batch is written.  Waits if it is too far ahead.
+    void write(uint64_t index, string& block);
+    uint64_t getBytesWritten();
+
+private:
+    FILE* file;
+    std::mutex lock;
+    std::condition_variable written;
+    std::map<uint64_t, string> pending;
+    uint64_t nextIndex;
+    uint64_t bytesWritten;
+};
+
+#endif
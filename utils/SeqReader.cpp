@@ -0,0 +1,358 @@
+#include "SeqReader.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+
+#define SEQ_READER_BUFFER_SIZE (1 << 20) //initial size of the buffer for files that can't be mapped
+
+int SeqBatch::size(){
+    return reads.size();
+}
+
+ReadSpan& SeqBatch::operator[](int index){
+    return reads[index];
+}
+
+void SeqBatch::clear(){
+    reads.clear();
+    storage.clear();
+    copied.clear();
+}
+
+void SeqBatch::addSpan(const char* seq, size_t length){
+    reads.push_back({seq, (int)length});
+}
+
+void SeqBatch::startCopy(){
+    copied.push_back(std::make_pair((int)reads.size(), storage.size()));
+    reads.push_back({nullptr, 0});
+}
+
+void SeqBatch::appendCopy(const char* seq, size_t length){
+    storage.append(seq, length);
+    reads.back().length += length;
+}
+
+void SeqBatch::appendPacked(const unsigned char* packed, int length){
+    size_t end = storage.size();
+    storage.resize(end + length);
+    decodeSpoolBases(packed, length, &storage[end]);
+    reads.back().length += length;
+}
+
+int SeqBatch::maskLast(const string& qualities, char lowest){
+    ReadSpan& read = reads.back();
+    int masked = 0;
+    size_t start = 0;
+    for(int i = 0; i < read.length && i < (int)qualities.size(); i++){
+        if(qualities[i] >= lowest) continue;
+        if(masked == 0){
+            if(copied.empty() || copied.back().first != (int)reads.size() - 1){
+                ReadSpan span = read;
+                reads.pop_back();
+                startCopy();
+                appendCopy(span.seq, span.length);
+            }
+            start = copied.back().second;
+        }
+        storage[start + i] = 'N';
+        masked++;
+    }
+    return masked;
+}
+
+void SeqBatch::finish(){
+    for(auto& copy : copied){
+        reads[copy.first].seq = storage.data() + copy.second;
+    }
+}
+
+char SeqReader::lowestQuality = 0;
+
+void SeqReader::setQualityMask(int minQual, int offset){
+    lowestQuality = minQual > 0 ? (char)(offset + minQual) : 0;
+}
+
+uint64_t SeqReader::getMaskedBases(){
+    return maskedBases;
+}
+
+SeqReader::SeqReader(string filename, bool isFastq, int threads){
+    fastq = isFastq;
+    lowest = lowestQuality;
+    maskedBases = 0;
+    fileMap = nullptr;
+    fileMapLength = 0;
+    map = nullptr;
+    mapLength = 0;
+    offset = 0;
+    compression = COMPRESSION_NONE;
+    decompressor = nullptr;
+    spool = false;
+    batchesRead = 0;
+    bufStart = 0;
+    bufEnd = 0;
+    eof = false;
+
+    fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0){
+        fprintf(stderr, "Could not open %s: %s\n", filename.c_str(), strerror(errno));
+        return;
+    }
+    struct stat info;
+    if(fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0){
+        void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapped != MAP_FAILED){
+            fileMap = (const char*) mapped;
+            fileMapLength = info.st_size;
+            madvise(mapped, fileMapLength, MADV_SEQUENTIAL);
+        }
+    }
+    if(fileMap && fileMapLength >= SPOOL_MAGIC_LENGTH && memcmp(fileMap, SPOOL_MAGIC, SPOOL_MAGIC_LENGTH) == 0){
+        spool = true;
+        map = fileMap;
+        mapLength = fileMapLength;
+        offset = SPOOL_MAGIC_LENGTH;
+        return;
+    }
+    if(fileMap){
+        compression = detectCompression(fileMap, fileMapLength);
+        if(compression == COMPRESSION_NONE){
+            map = fileMap;
+            mapLength = fileMapLength;
+            return;
+        }
+        decompressor = new Decompressor(fileMap, fileMapLength, compression, threads);
+        buffer.resize(SEQ_READER_BUFFER_SIZE);
+    }
+    else{
+        buffer.resize(SEQ_READER_BUFFER_SIZE);
+        //look at the start of the stream for a compression magic number
+        while(bufEnd < SPOOL_MAGIC_LENGTH && fill());
+        if(bufEnd >= SPOOL_MAGIC_LENGTH && memcmp(buffer.data(), SPOOL_MAGIC, SPOOL_MAGIC_LENGTH) == 0){
+            fprintf(stderr, "Read spool %s must be a regular file\n", filename.c_str());
+            exit(1);
+        }
+        compression = detectCompression(buffer.data(), bufEnd);
+        if(compression != COMPRESSION_NONE){
+            decompressor = new Decompressor(fd, buffer.data(), bufEnd, compression);
+            bufEnd = 0;
+            eof = false;
+        }
+    }
+    if(decompressor){
+        printf("Reading %s compressed %s%s\n", compressionName(compression), filename.c_str(), decompressor->isParallel() ? ", decompressing in parallel" : "");
+    }
+}
+
+SeqReader::~SeqReader(){
+    delete decompressor;
+    if(fileMap){
+        munmap((void*)fileMap, fileMapLength);
+    }
+    if(fd >= 0){
+        close(fd);
+    }
+}
+
+bool SeqReader::isOpen(){
+    return fd >= 0;
+}
+
+bool SeqReader::isMapped(){
+    return fileMap != nullptr;
+}
+
+int SeqReader::getCompression(){
+    return compression;
+}
+
+bool SeqReader::isSpool(){
+    return spool;
+}
+
+bool SeqReader::fill(){
+    if(eof || fd < 0){
+        return false;
+    }
+    //keep the unread part of the buffer, moving it to the front and growing the buffer if it is all unread
+    if(bufStart > 0){
+        memmove(buffer.data(), buffer.data() + bufStart, bufEnd - bufStart);
+        bufEnd -= bufStart;
+        bufStart = 0;
+    }
+    if(bufEnd == buffer.size()){
+        buffer.resize(2*buffer.size());
+    }
+    ssize_t count;
+    if(decompressor){
+        count = decompressor->read(buffer.data() + bufEnd, buffer.size() - bufEnd);
+    }
+    else do{
+        count = read(fd, buffer.data() + bufEnd, buffer.size() - bufEnd);
+    } while(count < 0 && errno == EINTR);
+    if(count <= 0){
+        eof = true;
+        return false;
+    }
+    bufEnd += count;
+    return true;
+}
+
+int SeqReader::peek(){
+    if(map){
+        return offset < mapLength ? map[offset] : -1;
+    }
+    if(bufStart == bufEnd && !fill()){
+        return -1;
+    }
+    return buffer[bufStart];
+}
+
+bool SeqReader::nextLine(const char*& line, size_t& length){
+    if(map){
+        if(offset >= mapLength){
+            return false;
+        }
+        line = map + offset;
+        const char* newline = (const char*) memchr(line, '\n', mapLength - offset);
+        length = newline ? newline - line : mapLength - offset;
+        offset += length + (newline ? 1 : 0);
+    }
+    else{
+        size_t searched = 0; //bytes past bufStart without a newline; fill may move bufStart
+        const char* newline;
+        while(!(newline = (const char*) memchr(buffer.data() + bufStart + searched, '\n', bufEnd - bufStart - searched))){
+            searched = bufEnd - bufStart;
+            if(!fill()){
+                break;
+            }
+        }
+        if(bufStart == bufEnd){
+            return false;
+        }
+        line = buffer.data() + bufStart;
+        length = newline ? newline - line : bufEnd - bufStart;
+        bufStart += length + (newline ? 1 : 0);
+    }
+    if(length > 0 && line[length-1] == '\r'){
+        length--;
+    }
+    return true;
+}
+
+//Adds the next spool record to the batch, with its pieces joined by an N
+bool SeqReader::nextSpoolRecord(SeqBatch& batch){
+    const unsigned char* data = (const unsigned char*) map + offset;
+    const unsigned char* end = (const unsigned char*) map + mapLength;
+    if(data == end){
+        return false;
+    }
+    uint64_t pieces, length;
+    int used = readSpoolVarint(data, end, pieces);
+    data += used;
+    batch.startCopy();
+    for(uint64_t i = 0; used && i < pieces; i++){
+        used = readSpoolVarint(data, end, length);
+        data += used;
+        if(!used || (uint64_t)(end - data) < (length + 3)/4){
+            used = 0;
+            break;
+        }
+        if(i > 0) batch.appendCopy("N", 1);
+        batch.appendPacked(data, length);
+        data += (length + 3)/4;
+    }
+    if(!used){
+        fprintf(stderr, "Truncated read spool at byte %zu\n", offset);
+        exit(1);
+    }
+    offset = data - (const unsigned char*) map;
+    return true;
+}
+
+//Adds the next record's sequence to the batch.  A sequence that sits on a single line of a mapped file is not copied.
+bool SeqReader::nextRecord(SeqBatch& batch){
+    if(spool){
+        return nextSpoolRecord(batch);
+    }
+    const char* line;
+    size_t length;
+    do{ //header line
+        if(!nextLine(line, length)) return false;
+    } while(length == 0);
+
+    bool copy = !map;
+    if(!fastq && line[0] != '>'){ //a file of bare sequences, one per line
+        if(copy){
+            batch.startCopy();
+            batch.appendCopy(line, length);
+        }
+        else{
+            batch.addSpan(line, length);
+        }
+        return true;
+    }
+    const char* firstLine = nullptr;
+    size_t firstLength = 0;
+    int lines = 0;
+    size_t seqLength = 0;
+    char sequenceEnd = fastq ? '+' : '>';
+    int next;
+    while((next = peek()) != -1 && next != sequenceEnd){
+        nextLine(line, length);
+        if(length == 0) continue;
+        if(copy){
+            if(lines == 0) batch.startCopy();
+            batch.appendCopy(line, length);
+        }
+        else if(lines == 0){
+            firstLine = line, firstLength = length;
+        }
+        else{
+            if(lines == 1){
+                batch.startCopy();
+                batch.appendCopy(firstLine, firstLength);
+            }
+            batch.appendCopy(line, length);
+        }
+        lines++;
+        seqLength += length;
+    }
+    if(lines == 0){
+        batch.addSpan("", 0);
+    }
+    else if(lines == 1 && !copy){
+        batch.addSpan(firstLine, firstLength);
+    }
+
+    if(fastq){
+        nextLine(line, length); //'+' line
+        //quality lines may start with '@' or '+', so they are counted off by length rather than recognized
+        size_t qualLength = 0;
+        if(lowest) qualities.clear();
+        while(qualLength < seqLength && nextLine(line, length)){
+            qualLength += length;
+            if(lowest) qualities.append(line, length);
+        }
+        if(lowest) maskedBases += batch.maskLast(qualities, lowest);
+    }
+    return true;
+}
+
+int SeqReader::nextBatch(SeqBatch& batch, int maxReads){
+    std::lock_guard<std::mutex> guard(lock);
+    batch.clear();
+    batch.index = batchesRead++;
+    int count = 0;
+    while(count < maxReads && nextRecord(batch)){
+        count++;
+    }
+    batch.finish();
+    return count;
+}
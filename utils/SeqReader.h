@@ -0,0 +1,111 @@
+#ifndef SEQ_READER
+#define SEQ_READER
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include "Kmer.h"
+#include "Decompressor.h"
+#include "ReadSpool.h"
+
+using std::string;
+
+//A batch of consecutive records from a SeqReader.  The sequences are ReadSpans that stay valid until the batch is
+//refilled: they point straight into the mapped file when the record sits on one line of it, and into the batch's own
+//storage otherwise (multi-line fasta, or any record read from a pipe).
+class SeqBatch{
+public:
+    std::vector<ReadSpan> reads; //sequences in file order
+    uint64_t index; //number of this batch in the file, counting from 0
+
+    int size();
+    ReadSpan& operator[](int index);
+
+private:
+    friend class SeqReader;
+    string storage; //copied sequences
+    std::vector<std::pair<int, size_t> > copied; //(index into reads, offset into storage) for each copied sequence
+
+    void clear();
+    void addSpan(const char* seq, size_t length); //adds a read pointing into the mapped file
+    void startCopy(); //adds a read that will be built up in storage with appendCopy
+    void appendCopy(const char* seq, size_t length);
+    void appendPacked(const unsigned char* packed, int length); //appends 2-bit packed bases, see ReadSpool.h
+    //Replaces the bases of the last read whose quality character is below lowest with N, copying the read first if it
+    //points into the file.  Returns the number of bases replaced.
+    int maskLast(const string& qualities, char lowest);
+    void finish(); //points the copied reads into storage, once it won't grow any more
+};
+
+//Reads fasta or fastq records without going through a std::string per line.
+//Regular files are memory mapped; pipes and anything else that can't be mapped fall back to buffered read() calls.
+//gzip, bzip2 and zstd input is recognized from its first bytes and decompressed on background threads (see Decompressor.h).
+//A read spool (see ReadSpool.h) is also recognized, and its records come back with their pieces joined by an N.
+//Fasta records may span several lines, and a fasta file may also hold bare sequences, one per line.
+//Fastq records are header, sequence, '+' line and qualities, and the sequence and qualities may also be wrapped.
+//Blank lines between records are skipped.
+//
+//nextBatch is thread-safe: consumers on several threads each take the next chunk of whole records, and only the
+//line splitting happens under the lock.  With an even batch size the two mates of an interleaved pair always share a batch.
+class SeqReader{
+public:
+    //threads is the most threads used to decompress a compressed file
+    SeqReader(string filename, bool fastq, int threads = 1);
+    ~SeqReader();
+
+    bool isOpen(); //false if the file couldn't be opened
+    bool isMapped(); //true if the file is memory mapped
+    int getCompression(); //COMPRESSION_NONE unless the file is compressed
+    bool isSpool(); //true if the file is a read spool
+
+    //Replaces the contents of batch with up to maxReads records.  Returns the number of records read, 0 at the end of the file.
+    int nextBatch(SeqBatch& batch, int maxReads);
+
+    //Bases of fastq records with a Phred quality below minQual, with qualities encoded as the quality character minus
+    //offset, are read as N, so the kmers overlapping them are neither loaded nor scanned.  Applies to every reader made
+    //afterwards.  0, the default, keeps every base.
+    static void setQualityMask(int minQual, int offset = 33);
+    uint64_t getMaskedBases(); //bases masked so far
+
+private:
+    int fd;
+    bool fastq;
+    std::mutex lock;
+
+    //mapped file
+    const char* fileMap;
+    size_t fileMapLength;
+    const char* map; //the mapped file when it is read in place, nullptr when reads go through buffer
+    size_t mapLength;
+    size_t offset;
+
+    bool spool;
+    uint64_t batchesRead;
+
+    //quality masking, see setQualityMask
+    static char lowestQuality; //quality characters below this mask their base, 0 when nothing is masked
+    char lowest;
+    string qualities; //of the current record
+    uint64_t maskedBases;
+
+    //compressed files are read through the decompressor
+    int compression;
+    Decompressor* decompressor;
+
+    //buffered reads, when the file isn't mapped or is compressed
+    std::vector<char> buffer;
+    size_t bufStart, bufEnd;
+    bool eof;
+
+    //Sets line and length to the next line, without its line ending.  Returns false at the end of the file.
+    //When reading from a buffer the line is only valid until the next call.
+    bool nextLine(const char*& line, size_t& length);
+    int peek(); //next character in the file, or -1 at the end of the file
+    bool fill(); //reads more of the file into the buffer, returns false if there was nothing left
+    bool nextRecord(SeqBatch& batch);
+    bool nextSpoolRecord(SeqBatch& batch);
+};
+
+#endif
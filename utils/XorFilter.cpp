@@ -0,0 +1,143 @@
+#include "XorFilter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#define XOR_MAX_ATTEMPTS 100
+
+static uint64_t splitmix64(uint64_t& state){
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void XorFilter::setSegments(uint32_t length, uint32_t count){
+    segmentLength = length;
+    segmentLengthMask = length - 1;
+    segmentCount = count;
+    segmentCountLength = count * length;
+    arrayLength = (count + 2) * length;
+}
+
+//Segments small enough that the three slots of a key stay close, and enough of them for the keys to peel
+void XorFilter::setSize(uint64_t keys){
+    uint32_t length = keys == 0 ? 4 : (uint32_t)1 << (int)floor(log((double)keys) / log(3.33) + 2.25);
+    length = std::min(length, (uint32_t)262144);
+    double sizeFactor = keys <= 1 ? 0 : std::max(1.125, 0.875 + 0.25 * log(1000000.0) / log((double)keys));
+    uint64_t capacity = keys <= 1 ? 0 : (uint64_t)round(keys * sizeFactor);
+    int64_t count = (int64_t)((capacity + length - 1) / length) - 2;
+    count = std::max(count, (int64_t)1);
+    if((uint64_t)count * length + 2*(uint64_t)length > 0xFFFFFFFFULL){
+        fprintf(stderr, "Too many keys for a frozen filter: %llu\n", (unsigned long long)keys);
+        exit(1);
+    }
+    setSegments(length, (uint32_t)count);
+}
+
+XorFilter::XorFilter(const unsigned char* prints, uint64_t seedVal, uint32_t length, uint32_t count, uint64_t keys){
+    seed = seedVal;
+    keyCount = keys;
+    setSegments(length, count);
+    fingerprints = (unsigned char*)prints;
+    owned = false;
+}
+
+XorFilter::XorFilter(const std::vector<uint64_t>& keys){
+    keyCount = keys.size();
+    setSize(keyCount);
+    fingerprints = (unsigned char*)calloc(arrayLength, 1);
+    owned = true;
+    if(!fingerprints){
+        fprintf(stderr, "Could not allocate %u bytes for a frozen filter\n", arrayLength);
+        exit(1);
+    }
+    uint32_t size = (uint32_t)keyCount;
+
+    //Each slot counts its keys times 4 in t2count, with the xor of the key's segment index (0, 1 or 2) in the low
+    //2 bits, and the xor of their hashes in t2hash, so a slot with one key left gives that key and where it sits.
+    std::vector<uint8_t> t2count(arrayLength);
+    std::vector<uint64_t> t2hash(arrayLength);
+    std::vector<uint32_t> alone(arrayLength);
+    std::vector<uint64_t> order(size); //peeled keys, in peeling order
+    std::vector<uint8_t> orderSlot(size); //segment index of the slot each peeled key was alone in
+    uint64_t rng = 0x726b2b9d438b9d4dULL;
+
+    for(int attempt = 0; ; attempt++){
+        if(attempt == XOR_MAX_ATTEMPTS){
+            fprintf(stderr, "Could not build a frozen filter over %u keys; are they distinct?\n", size);
+            exit(1);
+        }
+        seed = splitmix64(rng);
+        std::fill(t2count.begin(), t2count.end(), 0);
+        std::fill(t2hash.begin(), t2hash.end(), 0);
+        bool overflow = false;
+        for(uint32_t i = 0; i < size; i++){
+            uint64_t hash = mix(keys[i] + seed);
+            uint32_t h[3];
+            slots(hash, h[0], h[1], h[2]);
+            for(int j = 0; j < 3; j++){
+                t2count[h[j]] += 4;
+                t2count[h[j]] ^= j;
+                t2hash[h[j]] ^= hash;
+                overflow |= t2count[h[j]] < 4;
+            }
+        }
+        if(overflow){
+            continue;
+        }
+
+        uint32_t queued = 0;
+        for(uint32_t i = 0; i < arrayLength; i++){
+            alone[queued] = i;
+            queued += (t2count[i] >> 2) == 1;
+        }
+        uint32_t peeled = 0;
+        while(queued > 0){
+            uint32_t index = alone[--queued];
+            if((t2count[index] >> 2) != 1){
+                continue;
+            }
+            uint64_t hash = t2hash[index];
+            uint32_t h[3];
+            slots(hash, h[0], h[1], h[2]);
+            int found = t2count[index] & 3;
+            order[peeled] = hash;
+            orderSlot[peeled] = found;
+            peeled++;
+            for(int j = 0; j < 3; j++){
+                if(j == found){
+                    continue;
+                }
+                uint32_t other = h[j];
+                alone[queued] = other;
+                queued += (t2count[other] >> 2) == 2;
+                t2count[other] -= 4;
+                t2count[other] ^= j;
+                t2hash[other] ^= hash;
+            }
+            t2count[index] = 0;
+            t2hash[index] = 0;
+        }
+        if(peeled == size){
+            break;
+        }
+    }
+
+    //assign in reverse peeling order, so each key's own slot is set after the other two are final
+    for(uint32_t i = size; i-- > 0; ){
+        uint64_t hash = order[i];
+        uint32_t h[3];
+        slots(hash, h[0], h[1], h[2]);
+        int found = orderSlot[i];
+        fingerprints[h[found]] = fingerprint(hash) ^ fingerprints[h[(found + 1) % 3]] ^ fingerprints[h[(found + 2) % 3]];
+    }
+}
+
+XorFilter::~XorFilter(){
+    if(owned){
+        free(fingerprints);
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef XOR_FILTER
+#define XOR_FILTER
+
+#include <stdint.h>
+#include <vector>
+
+//A static filter over a set of 64 bit keys, built once they are all known: a binary fuse filter, the variant of the xor
+//filter whose three slots for a key fall in three consecutive segments of the array.  Each slot holds an 8 bit
+//fingerprint, and a key is contained if the fingerprints of its three slots xor to its own, so a query reads three
+//bytes within a few segments of each other and has a false positive rate of 1/256, at about 9 bits per key.
+//
+//Construction follows Graf and Lemire, "Binary Fuse Filters: Fast and Smaller Than Xor Filters" (2022).
+class XorFilter{
+public:
+    //Builds the filter from distinct keys
+    XorFilter(const std::vector<uint64_t>& keys);
+    //A filter over fingerprints that live elsewhere, e.g. in a mapped dump, as described by the other arguments
+    XorFilter(const unsigned char* fingerprints, uint64_t seed, uint32_t segmentLength, uint32_t segmentCount, uint64_t keyCount);
+    ~XorFilter();
+
+    inline bool contains(uint64_t key) const{
+        uint64_t hash = mix(key + seed);
+        uint8_t f = fingerprint(hash);
+        uint32_t h0, h1, h2;
+        slots(hash, h0, h1, h2);
+        return (f ^ fingerprints[h0] ^ fingerprints[h1] ^ fingerprints[h2]) == 0;
+    }
+
+    const unsigned char* getFingerprints() const { return fingerprints; }
+    uint32_t getArrayLength() const { return arrayLength; } //bytes of fingerprints
+    uint64_t getSeed() const { return seed; }
+    uint32_t getSegmentLength() const { return segmentLength; }
+    uint32_t getSegmentCount() const { return segmentCount; }
+    uint64_t getKeyCount() const { return keyCount; }
+    double bitsPerKey() const { return keyCount ? 8.0*arrayLength/keyCount : 0; }
+
+private:
+    uint64_t seed;
+    uint32_t segmentLength;
+    uint32_t segmentLengthMask;
+    uint32_t segmentCount;
+    uint32_t segmentCountLength;
+    uint32_t arrayLength;
+    uint64_t keyCount;
+    unsigned char* fingerprints;
+    bool owned; //fingerprints were allocated by this filter
+
+    void setSize(uint64_t keys);
+    void setSegments(uint32_t segmentLength, uint32_t segmentCount);
+
+    static inline uint64_t mix(uint64_t hash){
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+    static inline uint8_t fingerprint(uint64_t hash){
+        return (uint8_t)(hash ^ (hash >> 32));
+    }
+    //The slots of the key in the three consecutive segments of its window
+    inline void slots(uint64_t hash, uint32_t& h0, uint32_t& h1, uint32_t& h2) const{
+        h0 = (uint32_t)(((__uint128_t)hash * segmentCountLength) >> 64);
+        h1 = h0 + segmentLength;
+        h2 = h1 + segmentLength;
+        h1 ^= (uint32_t)(hash >> 18) & segmentLengthMask;
+        h2 ^= (uint32_t)hash & segmentLengthMask;
+    }
+};
+
+#endif
@@ -20,10 +20,10 @@ kmer_type get_random_kmer(){
     return rand_kmer;
 }
 
-void test_false_positive_rate(uint64_t bloomSize, int sampleSize, float fpRate){
+void test_false_positive_rate(uint64_t bloomSize, int sampleSize, float fpRate, int layout = BLOOM_CLASSIC){
     
     setSizeKmer(25);
-    bloom = bloom->create_bloom_filter_optimal(bloomSize, fpRate);
+    bloom = bloom->create_bloom_filter_optimal(bloomSize, fpRate, layout);
     for(int i = 0; i < bloomSize; i++){
         bloom->add(get_random_kmer());
     }
@@ -33,8 +33,8 @@ void test_false_positive_rate(uint64_t bloomSize, int sampleSize, float fpRate){
             fpCount += 1;
         }
     }
-    printf("Size %lli, desired rate %f: %f \n", 
-        bloomSize, fpRate, (float)fpCount/(float)sampleSize);
+    printf("Size %lli, layout %d, desired rate %f: %f \n", 
+        bloomSize, layout, fpRate, (float)fpCount/(float)sampleSize);
 }
 
 void test_speed_raw(uint64_t bloomSize, int sampleSize, float fpRate){
@@ -138,6 +138,8 @@ void runBloomTests(){
     test_false_positive_rate(100000, 100000, .001);
     test_false_positive_rate(100000, 100000, .01);
     test_false_positive_rate(100000, 100000, .1);
+    test_false_positive_rate(100000, 100000, .01, BLOOM_BLOCKED);
+    test_false_positive_rate(100000, 100000, .1, BLOOM_BLOCKED);
     test_speed_raw(100000, 2000000, .01);
     test_speed_incremental(100000, 20000000, .1);
     test_speed_readscan(100000, 20000000, .1);
@@ -212,7 +212,6 @@ void advance_hash_test_checkSame(){
 
 }
 
-
 void runRollingHashTests(){
     setSizeKmer(kVal);
 